@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <time.h>
+#include "bitstream.h"
+
+#define NUMBER_OF_FRAMES 100000
+#define NUMBER_OF_RUNS 20
+
+/* A classic frame with mixed byte orders, as in a typical DBC. */
+static const struct bitstream_can_signal_t classic_signals[] = {
+    { 0, 4, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+    { 4, 12, BITSTREAM_CAN_INTEL, 1, 0.5, -10.0 },
+    { 23, 16, BITSTREAM_CAN_MOTOROLA, 0, 0.25, 0.0 },
+    { 33, 2, BITSTREAM_CAN_MOTOROLA, 0, 1.0, 0.0 },
+    { 35, 5, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+    { 47, 6, BITSTREAM_CAN_MOTOROLA, 1, 1.0, 0.0 },
+    { 41, 1, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+    { 48, 8, BITSTREAM_CAN_INTEL, 1, 1.0, -40.0 },
+    { 63, 3, BITSTREAM_CAN_MOTOROLA, 0, 1.0, 0.0 },
+    { 56, 5, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 }
+};
+
+#define NUMBER_OF_CLASSIC_SIGNALS                                       \
+    (int)(sizeof(classic_signals) / sizeof(classic_signals[0]))
+
+#define NUMBER_OF_FD_SIGNALS 48
+
+static struct bitstream_can_signal_t fd_signals[NUMBER_OF_FD_SIGNALS];
+static uint8_t frames[NUMBER_OF_FRAMES * 64];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/* Bit offset of the first bit of given signal in its reader. */
+static int first_bit(const struct bitstream_can_signal_t *signal_p)
+{
+    if (signal_p->byte_order == BITSTREAM_CAN_INTEL) {
+        return (signal_p->start);
+    } else {
+        return ((signal_p->start & ~7) + 7 - (signal_p->start & 7));
+    }
+}
+
+/* One reader seek and read per signal. Motorola signals with the MSB
+   first reader and Intel signals with the LSB first reader. */
+static uint64_t unpack_signals(const struct bitstream_can_signal_t *signals_p,
+                               int number_of_signals,
+                               int frame_size)
+{
+    struct bitstream_reader_t reader;
+    struct bitstream_lsb_reader_t lsb_reader;
+    uint64_t values[NUMBER_OF_FD_SIGNALS];
+    uint64_t sum;
+    uint64_t sign;
+    const uint8_t *frame_p;
+    int i;
+    int j;
+
+    sum = 0;
+
+    for (i = 0; i < NUMBER_OF_FRAMES; i++) {
+        frame_p = &frames[i * frame_size];
+        bitstream_reader_init(&reader, frame_p);
+        bitstream_lsb_reader_init(&lsb_reader, frame_p, frame_size);
+
+        for (j = 0; j < number_of_signals; j++) {
+            if (signals_p[j].byte_order == BITSTREAM_CAN_INTEL) {
+                bitstream_lsb_reader_seek_to(&lsb_reader,
+                                             first_bit(&signals_p[j]));
+                values[j] = bitstream_lsb_reader_read_u64_bits(
+                    &lsb_reader,
+                    signals_p[j].length);
+            } else {
+                bitstream_reader_seek_to(&reader, first_bit(&signals_p[j]));
+                values[j] = bitstream_reader_read_u64_bits(
+                    &reader,
+                    signals_p[j].length);
+            }
+
+            if (signals_p[j].is_signed) {
+                sign = (1ull << (signals_p[j].length - 1));
+                values[j] = ((values[j] ^ sign) - sign);
+            }
+        }
+
+        sum += values[i % number_of_signals];
+    }
+
+    return (sum);
+}
+
+static uint64_t unpack_codec(struct bitstream_can_codec_t *codec_p)
+{
+    uint64_t values[NUMBER_OF_FD_SIGNALS];
+    uint64_t sum;
+    int i;
+
+    sum = 0;
+
+    for (i = 0; i < NUMBER_OF_FRAMES; i++) {
+        bitstream_can_codec_unpack_raw(codec_p,
+                                       &frames[i * codec_p->frame_size],
+                                       &values[0]);
+        sum += values[i % codec_p->number_of_signals];
+    }
+
+    return (sum);
+}
+
+static uint64_t pack_codec(struct bitstream_can_codec_t *codec_p)
+{
+    uint64_t values[NUMBER_OF_FD_SIGNALS];
+    int i;
+    int j;
+
+    for (i = 0; i < NUMBER_OF_FRAMES; i++) {
+        for (j = 0; j < codec_p->number_of_signals; j++) {
+            values[j] = (uint64_t)(i + j);
+        }
+
+        bitstream_can_codec_pack_raw(codec_p,
+                                     &frames[i * codec_p->frame_size],
+                                     &values[0]);
+    }
+
+    return (frames[0]);
+}
+
+/* 48 signals of 10 bits, alternating byte order. */
+static void init_fd_signals(void)
+{
+    int i;
+    int first;
+
+    for (i = 0; i < NUMBER_OF_FD_SIGNALS; i++) {
+        first = (10 * i);
+        fd_signals[i].length = 10;
+        fd_signals[i].is_signed = (i % 3 == 0);
+        fd_signals[i].scale = 1.0;
+        fd_signals[i].offset = 0.0;
+
+        if (i % 2 == 0) {
+            fd_signals[i].byte_order = BITSTREAM_CAN_INTEL;
+            fd_signals[i].start = first;
+        } else {
+            fd_signals[i].byte_order = BITSTREAM_CAN_MOTOROLA;
+            fd_signals[i].start = ((first & ~7) + 7 - (first & 7));
+        }
+    }
+}
+
+static double measure(int kind,
+                      struct bitstream_can_codec_t *codec_p,
+                      const struct bitstream_can_signal_t *signals_p,
+                      uint64_t *sum_p)
+{
+    double best;
+    double start;
+    double elapsed;
+    int run;
+
+    best = 1e18;
+
+    for (run = 0; run < NUMBER_OF_RUNS; run++) {
+        start = now();
+
+        switch (kind) {
+
+        case 0:
+            *sum_p += pack_codec(codec_p);
+            break;
+
+        case 1:
+            *sum_p += unpack_signals(signals_p,
+                                     codec_p->number_of_signals,
+                                     codec_p->frame_size);
+            break;
+
+        default:
+            *sum_p += unpack_codec(codec_p);
+            break;
+        }
+
+        elapsed = (now() - start);
+
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return (best / NUMBER_OF_FRAMES);
+}
+
+static void run(const char *name_p,
+                struct bitstream_can_codec_t *codec_p,
+                const struct bitstream_can_signal_t *signals_p,
+                uint64_t *sum_p)
+{
+    double pack_ns;
+    double signals_ns;
+    double codec_ns;
+
+    pack_ns = measure(0, codec_p, signals_p, sum_p);
+    signals_ns = measure(1, codec_p, signals_p, sum_p);
+    codec_ns = measure(2, codec_p, signals_p, sum_p);
+
+    printf("%s, %d signals: pack %.1f ns/frame, unpack %.1f ns/frame per "
+           "signal, %.1f ns/frame with codec, %.2fx\n",
+           name_p,
+           codec_p->number_of_signals,
+           pack_ns,
+           signals_ns,
+           codec_ns,
+           signals_ns / codec_ns);
+}
+
+int main()
+{
+    struct bitstream_can_codec_t codec;
+    uint64_t sum;
+
+    sum = 0;
+    init_fd_signals();
+
+    if (bitstream_can_codec_init(&codec,
+                                 &classic_signals[0],
+                                 NUMBER_OF_CLASSIC_SIGNALS,
+                                 8) != 0) {
+        return (1);
+    }
+
+    run("classic", &codec, &classic_signals[0], &sum);
+
+    if (bitstream_can_codec_init(&codec,
+                                 &fd_signals[0],
+                                 NUMBER_OF_FD_SIGNALS,
+                                 64) != 0) {
+        return (1);
+    }
+
+    run("fd", &codec, &fd_signals[0], &sum);
+
+    return (sum == 0);
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <time.h>
+#include "bitstream.h"
+
+/* Messages of 3, 1, 12, 5 and 7 bits fields. */
+#define NUMBER_OF_MESSAGES 100000
+#define NUMBER_OF_FIELDS 5
+#define NUMBER_OF_RUNS 20
+
+static uint8_t buf[NUMBER_OF_MESSAGES * 4 + 8];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static uint64_t writer_fields(void)
+{
+    struct bitstream_writer_t writer;
+    int i;
+
+    bitstream_writer_init(&writer, &buf[0]);
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        bitstream_writer_write_u64_bits(&writer, i & 0x7, 3);
+        bitstream_writer_write_bit(&writer, i & 1);
+        bitstream_writer_write_u64_bits(&writer, i & 0xfff, 12);
+        bitstream_writer_write_u64_bits(&writer, i & 0x1f, 5);
+        bitstream_writer_write_u64_bits(&writer, i & 0x7f, 7);
+    }
+
+    return (bitstream_writer_size_in_bits(&writer));
+}
+
+static uint64_t reader_fields(void)
+{
+    struct bitstream_reader_t reader;
+    uint64_t sum;
+    int i;
+
+    sum = 0;
+    bitstream_reader_init(&reader, &buf[0]);
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        sum += bitstream_reader_read_u64_bits(&reader, 3);
+        sum += bitstream_reader_read_bit(&reader);
+        sum += bitstream_reader_read_u64_bits(&reader, 12);
+        sum += bitstream_reader_read_u64_bits(&reader, 5);
+        sum += bitstream_reader_read_u64_bits(&reader, 7);
+    }
+
+    return (sum);
+}
+
+static uint64_t fast_writer_fields(void)
+{
+    struct bitstream_fast_writer_t writer;
+    int i;
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        bitstream_fast_writer_write_u64_bits(&writer, i & 0x7, 3);
+        bitstream_fast_writer_write_bit(&writer, i & 1);
+        bitstream_fast_writer_write_u64_bits(&writer, i & 0xfff, 12);
+        bitstream_fast_writer_write_u64_bits(&writer, i & 0x1f, 5);
+        bitstream_fast_writer_write_u64_bits(&writer, i & 0x7f, 7);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+
+    return (bitstream_fast_writer_size_in_bits(&writer));
+}
+
+static uint64_t fast_reader_fields(void)
+{
+    struct bitstream_fast_reader_t reader;
+    uint64_t sum;
+    int i;
+
+    sum = 0;
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        sum += bitstream_fast_reader_read_u64_bits(&reader, 3);
+        sum += bitstream_fast_reader_read_bit(&reader);
+        sum += bitstream_fast_reader_read_u64_bits(&reader, 12);
+        sum += bitstream_fast_reader_read_u64_bits(&reader, 5);
+        sum += bitstream_fast_reader_read_u64_bits(&reader, 7);
+    }
+
+    return (sum);
+}
+
+static const struct {
+    const char *name_p;
+    uint64_t (*run)(void);
+} cases[] = {
+    { "writer", writer_fields },
+    { "reader", reader_fields },
+    { "fast writer", fast_writer_fields },
+    { "fast reader", fast_reader_fields }
+};
+
+int main()
+{
+    double best;
+    double start;
+    double elapsed;
+    uint64_t sum;
+    int run;
+    int i;
+
+    sum = 0;
+
+#if defined(BITSTREAM_INLINE)
+    printf("Inline functions:\n");
+#else
+    printf("Library functions:\n");
+#endif
+
+    for (i = 0; i < 4; i++) {
+        best = 1e18;
+
+        for (run = 0; run < NUMBER_OF_RUNS; run++) {
+            start = now();
+            sum += cases[i].run();
+            elapsed = (now() - start);
+
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+
+        printf("  %-12s %.2f ns/field\n",
+               cases[i].name_p,
+               best / (NUMBER_OF_MESSAGES * NUMBER_OF_FIELDS));
+    }
+
+    return (sum == 0);
+}
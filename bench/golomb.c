@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <time.h>
+#include "bitstream.h"
+
+#define NUMBER_OF_VALUES 1000000
+#define NUMBER_OF_RUNS 10
+#define RICE_PARAMETER 4
+
+static uint32_t values[NUMBER_OF_VALUES];
+static uint32_t decoded[NUMBER_OF_VALUES];
+static uint8_t ue_buf[8 * NUMBER_OF_VALUES];
+static uint8_t rice_buf[8 * NUMBER_OF_VALUES];
+static uint8_t delta_buf[8 * NUMBER_OF_VALUES];
+static size_t ue_size;
+static size_t rice_size;
+static size_t delta_size;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/* Mostly small values, as syntax elements and residuals. */
+static void init(void)
+{
+    struct bitstream_fast_writer_t writer;
+    uint32_t state;
+    int i;
+
+    state = 1;
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        state = (state * 1103515245u + 12345u);
+        values[i] = ((state >> 16) >> ((state >> 8) % 14));
+    }
+
+    bitstream_fast_writer_init(&writer, &ue_buf[0], sizeof(ue_buf));
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        bitstream_fast_writer_write_ue(&writer, values[i]);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    ue_size = bitstream_fast_writer_size_in_bytes(&writer);
+    bitstream_fast_writer_init(&writer, &rice_buf[0], sizeof(rice_buf));
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        bitstream_fast_writer_write_rice(&writer,
+                                         values[i] >> 6,
+                                         RICE_PARAMETER);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    rice_size = bitstream_fast_writer_size_in_bytes(&writer);
+    bitstream_fast_writer_init(&writer, &delta_buf[0], sizeof(delta_buf));
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        bitstream_fast_writer_write_delta(&writer, values[i] + 1);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    delta_size = bitstream_fast_writer_size_in_bytes(&writer);
+}
+
+/* As before this library had Exp-Golomb codes. */
+static uint32_t read_ue_bit_by_bit(struct bitstream_reader_t *reader_p)
+{
+    int zeros;
+
+    zeros = 0;
+
+    while (bitstream_reader_read_bit(reader_p) == 0) {
+        zeros++;
+    }
+
+    return ((uint32_t)(((1ull << zeros)
+                        | bitstream_reader_read_u64_bits(reader_p, zeros))
+                       - 1));
+}
+
+static uint32_t read_rice_bit_by_bit(struct bitstream_reader_t *reader_p)
+{
+    uint32_t quotient;
+
+    quotient = 0;
+
+    while (bitstream_reader_read_bit(reader_p) == 0) {
+        quotient++;
+    }
+
+    return ((quotient << RICE_PARAMETER)
+            | (uint32_t)bitstream_reader_read_u64_bits(reader_p,
+                                                       RICE_PARAMETER));
+}
+
+static uint32_t read_delta_bit_by_bit(struct bitstream_reader_t *reader_p)
+{
+    int length;
+
+    length = (int)(read_ue_bit_by_bit(reader_p) + 1);
+
+    return ((uint32_t)((1ull << (length - 1))
+                       | bitstream_reader_read_u64_bits(reader_p,
+                                                        length - 1)));
+}
+
+static void ue_bit_by_bit(void)
+{
+    struct bitstream_reader_t reader;
+    int i;
+
+    bitstream_reader_init(&reader, &ue_buf[0]);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = read_ue_bit_by_bit(&reader);
+    }
+}
+
+static void ue_reader(void)
+{
+    struct bitstream_reader_t reader;
+    int i;
+
+    bitstream_reader_init(&reader, &ue_buf[0]);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = bitstream_reader_read_ue(&reader);
+    }
+}
+
+static void ue_fast_reader(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &ue_buf[0], ue_size);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = bitstream_fast_reader_read_ue(&reader);
+    }
+}
+
+static void ue_fast_reader_array(void)
+{
+    struct bitstream_fast_reader_t reader;
+
+    bitstream_fast_reader_init(&reader, &ue_buf[0], ue_size);
+    bitstream_fast_reader_read_ue_array(&reader,
+                                        &decoded[0],
+                                        NUMBER_OF_VALUES);
+}
+
+static void rice_bit_by_bit(void)
+{
+    struct bitstream_reader_t reader;
+    int i;
+
+    bitstream_reader_init(&reader, &rice_buf[0]);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = read_rice_bit_by_bit(&reader);
+    }
+}
+
+static void rice_reader(void)
+{
+    struct bitstream_reader_t reader;
+    int i;
+
+    bitstream_reader_init(&reader, &rice_buf[0]);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = bitstream_reader_read_rice(&reader, RICE_PARAMETER);
+    }
+}
+
+static void rice_fast_reader(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &rice_buf[0], rice_size);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = bitstream_fast_reader_read_rice(&reader, RICE_PARAMETER);
+    }
+}
+
+static void rice_fast_reader_array(void)
+{
+    struct bitstream_fast_reader_t reader;
+
+    bitstream_fast_reader_init(&reader, &rice_buf[0], rice_size);
+    bitstream_fast_reader_read_rice_array(&reader,
+                                          &decoded[0],
+                                          NUMBER_OF_VALUES,
+                                          RICE_PARAMETER);
+}
+
+/* Gamma codes are the ue codes of the values plus one. */
+static void gamma_fast_reader(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &ue_buf[0], ue_size);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = (bitstream_fast_reader_read_gamma(&reader) - 1);
+    }
+}
+
+static void gamma_fast_reader_array(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &ue_buf[0], ue_size);
+    bitstream_fast_reader_read_gamma_array(&reader,
+                                           &decoded[0],
+                                           NUMBER_OF_VALUES);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i]--;
+    }
+}
+
+static void delta_bit_by_bit(void)
+{
+    struct bitstream_reader_t reader;
+    int i;
+
+    bitstream_reader_init(&reader, &delta_buf[0]);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = (read_delta_bit_by_bit(&reader) - 1);
+    }
+}
+
+static void delta_fast_reader(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &delta_buf[0], delta_size);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = (bitstream_fast_reader_read_delta(&reader) - 1);
+    }
+}
+
+static void delta_fast_reader_array(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &delta_buf[0], delta_size);
+    bitstream_fast_reader_read_delta_array(&reader,
+                                           &decoded[0],
+                                           NUMBER_OF_VALUES);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i]--;
+    }
+}
+
+static double measure(void (*function)(void), int shift)
+{
+    double best;
+    double start;
+    double elapsed;
+    int run;
+    int i;
+
+    best = 1e18;
+
+    for (run = 0; run < NUMBER_OF_RUNS; run++) {
+        start = now();
+        function();
+        elapsed = (now() - start);
+
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        if (decoded[i] != (values[i] >> shift)) {
+            printf("Decoding failed.\n");
+
+            return (0.0);
+        }
+
+        decoded[i] = 0xffffffff;
+    }
+
+    return (best / NUMBER_OF_VALUES);
+}
+
+int main()
+{
+    init();
+    printf("%d values, ue %.2f bits/value, rice(%d) %.2f bits/value, "
+           "delta %.2f bits/value\n",
+           NUMBER_OF_VALUES,
+           8.0 * (double)ue_size / NUMBER_OF_VALUES,
+           RICE_PARAMETER,
+           8.0 * (double)rice_size / NUMBER_OF_VALUES,
+           8.0 * (double)delta_size / NUMBER_OF_VALUES);
+    printf("ue    bit by bit        %5.2f ns/value\n",
+           measure(ue_bit_by_bit, 0));
+    printf("ue    reader            %5.2f ns/value\n",
+           measure(ue_reader, 0));
+    printf("ue    fast reader       %5.2f ns/value\n",
+           measure(ue_fast_reader, 0));
+    printf("ue    fast reader array %5.2f ns/value\n",
+           measure(ue_fast_reader_array, 0));
+    printf("rice  bit by bit        %5.2f ns/value\n",
+           measure(rice_bit_by_bit, 6));
+    printf("rice  reader            %5.2f ns/value\n",
+           measure(rice_reader, 6));
+    printf("rice  fast reader       %5.2f ns/value\n",
+           measure(rice_fast_reader, 6));
+    printf("rice  fast reader array %5.2f ns/value\n",
+           measure(rice_fast_reader_array, 6));
+    printf("gamma fast reader       %5.2f ns/value\n",
+           measure(gamma_fast_reader, 0));
+    printf("gamma fast reader array %5.2f ns/value\n",
+           measure(gamma_fast_reader_array, 0));
+    printf("delta bit by bit        %5.2f ns/value\n",
+           measure(delta_bit_by_bit, 0));
+    printf("delta fast reader       %5.2f ns/value\n",
+           measure(delta_fast_reader, 0));
+    printf("delta fast reader array %5.2f ns/value\n",
+           measure(delta_fast_reader_array, 0));
+
+    return (0);
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <time.h>
+#include "bitstream.h"
+
+#define NUMBER_OF_SYMBOLS 1000000
+#define ALPHABET_SIZE 256
+#define NUMBER_OF_RUNS 10
+
+static struct bitstream_huffman_t huffman;
+static uint16_t symbols[NUMBER_OF_SYMBOLS];
+static uint16_t decoded[NUMBER_OF_SYMBOLS];
+static uint8_t buf[2 * NUMBER_OF_SYMBOLS];
+static size_t size;
+
+/* Canonical decoding state for the bit by bit decoder, as in zlib's
+   puff. */
+static int counts[BITSTREAM_HUFFMAN_MAX_LENGTH + 1];
+static uint16_t sorted[ALPHABET_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/* Roughly text like, the symbol frequencies falls of as 1 / rank. */
+static void init_symbols(uint8_t *lengths_p)
+{
+    uint32_t frequencies[ALPHABET_SIZE];
+    uint32_t thresholds[ALPHABET_SIZE];
+    uint32_t total;
+    uint32_t state;
+    uint32_t value;
+    int i;
+    int j;
+
+    total = 0;
+
+    for (i = 0; i < ALPHABET_SIZE; i++) {
+        frequencies[i] = (100000 / (i + 1));
+        total += frequencies[i];
+        thresholds[i] = total;
+    }
+
+    state = 1;
+
+    for (i = 0; i < NUMBER_OF_SYMBOLS; i++) {
+        state = (state * 1103515245u + 12345u);
+        value = ((state >> 8) % total);
+
+        for (j = 0; thresholds[j] <= value; j++);
+
+        symbols[i] = (uint16_t)j;
+    }
+
+    bitstream_huffman_lengths(lengths_p,
+                              &frequencies[0],
+                              ALPHABET_SIZE,
+                              BITSTREAM_HUFFMAN_MAX_LENGTH);
+}
+
+static void init_bit_by_bit(const uint8_t *lengths_p)
+{
+    int offsets[BITSTREAM_HUFFMAN_MAX_LENGTH + 1];
+    int i;
+
+    for (i = 0; i < ALPHABET_SIZE; i++) {
+        counts[lengths_p[i]]++;
+    }
+
+    offsets[1] = 0;
+
+    for (i = 1; i < BITSTREAM_HUFFMAN_MAX_LENGTH; i++) {
+        offsets[i + 1] = (offsets[i] + counts[i]);
+    }
+
+    for (i = 0; i < ALPHABET_SIZE; i++) {
+        if (lengths_p[i] != 0) {
+            sorted[offsets[lengths_p[i]]++] = (uint16_t)i;
+        }
+    }
+}
+
+static int read_symbol_bit_by_bit(struct bitstream_fast_reader_t *reader_p)
+{
+    int code;
+    int first;
+    int index;
+    int length;
+
+    code = 0;
+    first = 0;
+    index = 0;
+
+    for (length = 1; length <= BITSTREAM_HUFFMAN_MAX_LENGTH; length++) {
+        code |= bitstream_fast_reader_read_bit(reader_p);
+
+        if (code - counts[length] < first) {
+            return (sorted[index + (code - first)]);
+        }
+
+        index += counts[length];
+        first += counts[length];
+        first <<= 1;
+        code <<= 1;
+    }
+
+    return (-1);
+}
+
+static void encode(void)
+{
+    struct bitstream_fast_writer_t writer;
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_huffman_encode(&huffman, &writer, &symbols[0], NUMBER_OF_SYMBOLS);
+    bitstream_fast_writer_flush(&writer);
+    size = bitstream_fast_writer_size_in_bytes(&writer);
+}
+
+static void decode_table(void)
+{
+    struct bitstream_fast_reader_t reader;
+
+    bitstream_fast_reader_init(&reader, &buf[0], size);
+    bitstream_huffman_decode(&huffman,
+                             &reader,
+                             &decoded[0],
+                             NUMBER_OF_SYMBOLS);
+}
+
+static void decode_bit_by_bit(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &buf[0], size);
+
+    for (i = 0; i < NUMBER_OF_SYMBOLS; i++) {
+        decoded[i] = (uint16_t)read_symbol_bit_by_bit(&reader);
+    }
+}
+
+static double measure(void (*function)(void))
+{
+    double best;
+    double start;
+    double elapsed;
+    int run;
+
+    best = 1e18;
+
+    for (run = 0; run < NUMBER_OF_RUNS; run++) {
+        start = now();
+        function();
+        elapsed = (now() - start);
+
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    return (best / NUMBER_OF_SYMBOLS);
+}
+
+static int check(void)
+{
+    int i;
+
+    for (i = 0; i < NUMBER_OF_SYMBOLS; i++) {
+        if (decoded[i] != symbols[i]) {
+            return (1);
+        }
+    }
+
+    decoded[0] = 0xffff;
+
+    return (0);
+}
+
+static void print(const char *name_p, double ns)
+{
+    printf("%-12s %5.2f ns/symbol, %7.1f MB/s\n", name_p, ns, 1e3 / ns);
+}
+
+int main()
+{
+    uint8_t lengths[ALPHABET_SIZE];
+    double encode_ns;
+    double table_ns;
+    double bit_by_bit_ns;
+
+    init_symbols(&lengths[0]);
+
+    if (bitstream_huffman_init(&huffman, &lengths[0], ALPHABET_SIZE) != 0) {
+        return (1);
+    }
+
+    init_bit_by_bit(&lengths[0]);
+    encode_ns = measure(encode);
+    table_ns = measure(decode_table);
+
+    if (check() != 0) {
+        return (1);
+    }
+
+    bit_by_bit_ns = measure(decode_bit_by_bit);
+
+    if (check() != 0) {
+        return (1);
+    }
+
+    printf("%d symbols, %.2f bits/symbol\n",
+           NUMBER_OF_SYMBOLS,
+           8.0 * (double)size / NUMBER_OF_SYMBOLS);
+    print("encode", encode_ns);
+    print("table", table_ns);
+    print("bit by bit", bit_by_bit_ns);
+    printf("table decoding is %.2fx faster\n", bit_by_bit_ns / table_ns);
+
+    return (0);
+}
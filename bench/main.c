@@ -0,0 +1,641 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bitstream.h"
+
+/* Operations per timed sample. */
+#define NUMBER_OF_OPERATIONS 1024
+
+struct case_t {
+    const char *name_p;
+    void (*run)(int offset, int width);
+    /* Bits per operation, zero terminated. */
+    const int *widths_p;
+};
+
+struct result_t {
+    double median;
+    double p99;
+};
+
+static uint8_t buf[NUMBER_OF_OPERATIONS * 64 + 64];
+static uint8_t data[64];
+static volatile uint64_t sink;
+
+static const int bit_widths[] = { 1, 0 };
+static const int u8_widths[] = { 8, 0 };
+static const int u16_widths[] = { 16, 0 };
+static const int u32_widths[] = { 32, 0 };
+static const int u64_widths[] = { 64, 0 };
+static const int bits_widths[] = { 1, 3, 7, 12, 17, 31, 48, 64, 0 };
+static const int bytes_widths[] = { 8, 64, 512, 0 };
+static const int seek_widths[] = { 7, 0 };
+static const int copy_widths[] = { 13, 64, 100, 509, 0 };
+
+/* Code lengths of a table driven decoder peeking 12 bits. */
+static const int code_widths[] = { 2, 5, 9, 12, 0 };
+
+#define WRITER_CASE(name, statement)                            \
+    static void writer_ ## name(int offset, int width)          \
+    {                                                           \
+        struct bitstream_writer_t writer;                       \
+        struct bitstream_writer_bounds_t bounds;                \
+        int i;                                                  \
+                                                                \
+        (void)bounds;                                           \
+        bitstream_writer_init(&writer, &buf[0]);                \
+        bitstream_writer_seek(&writer, offset);                 \
+                                                                \
+        for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {            \
+            statement;                                          \
+        }                                                       \
+                                                                \
+        sink = (uint64_t)bitstream_writer_size_in_bits(&writer); \
+    }
+
+#define READER_CASE(name, statement)                            \
+    static void reader_ ## name(int offset, int width)          \
+    {                                                           \
+        struct bitstream_reader_t reader;                       \
+        uint64_t sum;                                           \
+        int i;                                                  \
+                                                                \
+        sum = 0;                                                \
+        bitstream_reader_init(&reader, &buf[0]);                \
+        bitstream_reader_seek(&reader, offset);                 \
+                                                                \
+        for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {            \
+            statement;                                          \
+        }                                                       \
+                                                                \
+        sink = sum;                                             \
+    }
+
+#define FAST_WRITER_CASE(name, statement)                       \
+    static void fast_writer_ ## name(int offset, int width)     \
+    {                                                           \
+        struct bitstream_fast_writer_t writer;                  \
+        int i;                                                  \
+                                                                \
+        bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf)); \
+        bitstream_fast_writer_seek(&writer, offset);            \
+                                                                \
+        for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {            \
+            statement;                                          \
+        }                                                       \
+                                                                \
+        bitstream_fast_writer_flush(&writer);                   \
+        sink = bitstream_fast_writer_size_in_bits(&writer);     \
+    }
+
+#define FAST_READER_CASE(name, statement)                       \
+    static void fast_reader_ ## name(int offset, int width)     \
+    {                                                           \
+        struct bitstream_fast_reader_t reader;                  \
+        uint64_t sum;                                           \
+        int i;                                                  \
+                                                                \
+        sum = 0;                                                \
+        bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf)); \
+        bitstream_fast_reader_seek(&reader, offset);            \
+                                                                \
+        for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {            \
+            statement;                                          \
+        }                                                       \
+                                                                \
+        sink = sum;                                             \
+    }
+
+#define LSB_WRITER_CASE(name, statement)                        \
+    static void lsb_writer_ ## name(int offset, int width)      \
+    {                                                           \
+        struct bitstream_lsb_writer_t writer;                   \
+        int i;                                                  \
+                                                                \
+        bitstream_lsb_writer_init(&writer, &buf[0], sizeof(buf)); \
+        bitstream_lsb_writer_seek(&writer, offset);             \
+                                                                \
+        for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {            \
+            statement;                                          \
+        }                                                       \
+                                                                \
+        bitstream_lsb_writer_flush(&writer);                    \
+        sink = bitstream_lsb_writer_size_in_bits(&writer);      \
+    }
+
+#define LSB_READER_CASE(name, statement)                        \
+    static void lsb_reader_ ## name(int offset, int width)      \
+    {                                                           \
+        struct bitstream_lsb_reader_t reader;                   \
+        uint64_t sum;                                           \
+        int i;                                                  \
+                                                                \
+        sum = 0;                                                \
+        bitstream_lsb_reader_init(&reader, &buf[0], sizeof(buf)); \
+        bitstream_lsb_reader_seek(&reader, offset);             \
+                                                                \
+        for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {            \
+            statement;                                          \
+        }                                                       \
+                                                                \
+        sink = sum;                                             \
+    }
+
+#define VALUE(width) (((uint64_t)i * 0x9e3779b97f4a7c15ull)     \
+                      >> (63 - ((width) - 1)))
+
+WRITER_CASE(write_bit, bitstream_writer_write_bit(&writer, i & 1))
+WRITER_CASE(write_bytes,
+            bitstream_writer_write_bytes(&writer, &data[0], width / 8))
+WRITER_CASE(write_bits,
+            bitstream_writer_write_bits(&writer, &data[0], width))
+WRITER_CASE(write_u8, bitstream_writer_write_u8(&writer, (uint8_t)i))
+WRITER_CASE(write_u16, bitstream_writer_write_u16(&writer, (uint16_t)i))
+WRITER_CASE(write_u32, bitstream_writer_write_u32(&writer, (uint32_t)i))
+WRITER_CASE(write_u64, bitstream_writer_write_u64(&writer, VALUE(64)))
+WRITER_CASE(write_u64_bits,
+            bitstream_writer_write_u64_bits(&writer, VALUE(width), width))
+WRITER_CASE(write_repeated_bit,
+            bitstream_writer_write_repeated_bit(&writer, i & 1, width))
+WRITER_CASE(write_repeated_u8,
+            bitstream_writer_write_repeated_u8(&writer,
+                                               (uint8_t)i,
+                                               width / 8))
+WRITER_CASE(insert_bit, bitstream_writer_insert_bit(&writer, i & 1))
+WRITER_CASE(insert_bytes,
+            bitstream_writer_insert_bytes(&writer, &data[0], width / 8))
+WRITER_CASE(insert_u8, bitstream_writer_insert_u8(&writer, (uint8_t)i))
+WRITER_CASE(insert_u16, bitstream_writer_insert_u16(&writer, (uint16_t)i))
+WRITER_CASE(insert_u32, bitstream_writer_insert_u32(&writer, (uint32_t)i))
+WRITER_CASE(insert_u64, bitstream_writer_insert_u64(&writer, VALUE(64)))
+WRITER_CASE(insert_u64_bits,
+            bitstream_writer_insert_u64_bits(&writer, VALUE(width), width))
+WRITER_CASE(seek, bitstream_writer_seek(&writer, width))
+WRITER_CASE(bounds_save_restore,
+            bitstream_writer_bounds_save(
+                &bounds,
+                &writer,
+                bitstream_writer_size_in_bits(&writer),
+                width);
+            bitstream_writer_bounds_restore(&bounds);
+            bitstream_writer_seek(&writer, width))
+
+/* Insert and delete bits at given offset in a 1024 bytes stream. */
+static void writer_insert_zero_bits_delete_bits(int offset, int width)
+{
+    struct bitstream_writer_t writer;
+    int i;
+
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_writer_seek(&writer, 8 * 1024);
+
+    for (i = 0; i < NUMBER_OF_OPERATIONS; i++) {
+        bitstream_writer_insert_zero_bits(&writer, offset, width);
+        bitstream_writer_delete_bits(&writer, offset, width);
+    }
+
+    sink = (uint64_t)bitstream_writer_size_in_bits(&writer);
+}
+
+READER_CASE(read_bit, sum += (uint64_t)bitstream_reader_read_bit(&reader))
+READER_CASE(read_bytes,
+            bitstream_reader_read_bytes(&reader, &data[0], width / 8);
+            sum += data[0])
+READER_CASE(read_u8, sum += bitstream_reader_read_u8(&reader))
+READER_CASE(read_u16, sum += bitstream_reader_read_u16(&reader))
+READER_CASE(read_u32, sum += bitstream_reader_read_u32(&reader))
+READER_CASE(read_u64, sum += bitstream_reader_read_u64(&reader))
+READER_CASE(read_u64_bits,
+            sum += bitstream_reader_read_u64_bits(&reader, width))
+READER_CASE(seek, bitstream_reader_seek(&reader, width))
+READER_CASE(tell, sum += (uint64_t)bitstream_reader_tell(&reader))
+READER_CASE(read_u64_bits_seek,
+            sum += bitstream_reader_read_u64_bits(&reader, 12);
+            bitstream_reader_seek(&reader, width - 12))
+READER_CASE(peek_u64_bits_skip_bits,
+            sum += bitstream_reader_peek_u64_bits(&reader, 12);
+            bitstream_reader_skip_bits(&reader, width))
+
+FAST_WRITER_CASE(write_bit, bitstream_fast_writer_write_bit(&writer, i & 1))
+FAST_WRITER_CASE(write_bytes,
+                 bitstream_fast_writer_write_bytes(&writer,
+                                                   &data[0],
+                                                   width / 8))
+FAST_WRITER_CASE(write_u8,
+                 bitstream_fast_writer_write_u8(&writer, (uint8_t)i))
+FAST_WRITER_CASE(write_u16,
+                 bitstream_fast_writer_write_u16(&writer, (uint16_t)i))
+FAST_WRITER_CASE(write_u32,
+                 bitstream_fast_writer_write_u32(&writer, (uint32_t)i))
+FAST_WRITER_CASE(write_u64,
+                 bitstream_fast_writer_write_u64(&writer, VALUE(64)))
+FAST_WRITER_CASE(write_u64_bits,
+                 bitstream_fast_writer_write_u64_bits(&writer,
+                                                      VALUE(width),
+                                                      width))
+FAST_WRITER_CASE(seek, bitstream_fast_writer_seek(&writer, width))
+
+FAST_READER_CASE(read_bit,
+                 sum += (uint64_t)bitstream_fast_reader_read_bit(&reader))
+FAST_READER_CASE(read_bytes,
+                 bitstream_fast_reader_read_bytes(&reader,
+                                                  &data[0],
+                                                  width / 8);
+                 sum += data[0])
+FAST_READER_CASE(read_u8, sum += bitstream_fast_reader_read_u8(&reader))
+FAST_READER_CASE(read_u16, sum += bitstream_fast_reader_read_u16(&reader))
+FAST_READER_CASE(read_u32, sum += bitstream_fast_reader_read_u32(&reader))
+FAST_READER_CASE(read_u64, sum += bitstream_fast_reader_read_u64(&reader))
+FAST_READER_CASE(read_u64_bits,
+                 sum += bitstream_fast_reader_read_u64_bits(&reader, width))
+FAST_READER_CASE(seek, bitstream_fast_reader_seek(&reader, width))
+FAST_READER_CASE(tell, sum += bitstream_fast_reader_tell(&reader))
+FAST_READER_CASE(peek_u64_bits_skip_bits,
+                 sum += bitstream_fast_reader_peek_u64_bits(&reader, 12);
+                 bitstream_fast_reader_skip_bits(&reader, width))
+
+LSB_WRITER_CASE(write_bit, bitstream_lsb_writer_write_bit(&writer, i & 1))
+LSB_WRITER_CASE(write_bytes,
+                bitstream_lsb_writer_write_bytes(&writer,
+                                                 &data[0],
+                                                 width / 8))
+LSB_WRITER_CASE(write_u8, bitstream_lsb_writer_write_u8(&writer, (uint8_t)i))
+LSB_WRITER_CASE(write_u16,
+                bitstream_lsb_writer_write_u16(&writer, (uint16_t)i))
+LSB_WRITER_CASE(write_u32,
+                bitstream_lsb_writer_write_u32(&writer, (uint32_t)i))
+LSB_WRITER_CASE(write_u64,
+                bitstream_lsb_writer_write_u64(&writer, VALUE(64)))
+LSB_WRITER_CASE(write_u64_bits,
+                bitstream_lsb_writer_write_u64_bits(&writer,
+                                                    VALUE(width),
+                                                    width))
+LSB_WRITER_CASE(seek, bitstream_lsb_writer_seek(&writer, width))
+
+LSB_READER_CASE(read_bit,
+                sum += (uint64_t)bitstream_lsb_reader_read_bit(&reader))
+LSB_READER_CASE(read_bytes,
+                bitstream_lsb_reader_read_bytes(&reader,
+                                                &data[0],
+                                                width / 8);
+                sum += data[0])
+LSB_READER_CASE(read_u8, sum += bitstream_lsb_reader_read_u8(&reader))
+LSB_READER_CASE(read_u16, sum += bitstream_lsb_reader_read_u16(&reader))
+LSB_READER_CASE(read_u32, sum += bitstream_lsb_reader_read_u32(&reader))
+LSB_READER_CASE(read_u64, sum += bitstream_lsb_reader_read_u64(&reader))
+LSB_READER_CASE(read_u64_bits,
+                sum += bitstream_lsb_reader_read_u64_bits(&reader, width))
+LSB_READER_CASE(seek, bitstream_lsb_reader_seek(&reader, width))
+LSB_READER_CASE(tell, sum += bitstream_lsb_reader_tell(&reader))
+LSB_READER_CASE(peek_u64_bits_skip_bits,
+                sum += bitstream_lsb_reader_peek_u64_bits(&reader, 12);
+                bitstream_lsb_reader_skip_bits(&reader, width))
+
+static const struct case_t cases[] = {
+    { "bitstream_writer_write_bit", writer_write_bit, bit_widths },
+    { "bitstream_writer_write_bytes", writer_write_bytes, bytes_widths },
+    { "bitstream_writer_write_bits", writer_write_bits, copy_widths },
+    { "bitstream_writer_write_u8", writer_write_u8, u8_widths },
+    { "bitstream_writer_write_u16", writer_write_u16, u16_widths },
+    { "bitstream_writer_write_u32", writer_write_u32, u32_widths },
+    { "bitstream_writer_write_u64", writer_write_u64, u64_widths },
+    { "bitstream_writer_write_u64_bits", writer_write_u64_bits, bits_widths },
+    {
+        "bitstream_writer_write_repeated_bit",
+        writer_write_repeated_bit,
+        bytes_widths
+    },
+    {
+        "bitstream_writer_write_repeated_u8",
+        writer_write_repeated_u8,
+        bytes_widths
+    },
+    { "bitstream_writer_insert_bit", writer_insert_bit, bit_widths },
+    { "bitstream_writer_insert_bytes", writer_insert_bytes, bytes_widths },
+    { "bitstream_writer_insert_u8", writer_insert_u8, u8_widths },
+    { "bitstream_writer_insert_u16", writer_insert_u16, u16_widths },
+    { "bitstream_writer_insert_u32", writer_insert_u32, u32_widths },
+    { "bitstream_writer_insert_u64", writer_insert_u64, u64_widths },
+    {
+        "bitstream_writer_insert_u64_bits",
+        writer_insert_u64_bits,
+        bits_widths
+    },
+    { "bitstream_writer_seek", writer_seek, seek_widths },
+    {
+        "bitstream_writer_insert_zero_bits_delete_bits",
+        writer_insert_zero_bits_delete_bits,
+        bits_widths
+    },
+    {
+        "bitstream_writer_bounds_save_restore",
+        writer_bounds_save_restore,
+        bits_widths
+    },
+    { "bitstream_reader_read_bit", reader_read_bit, bit_widths },
+    { "bitstream_reader_read_bytes", reader_read_bytes, bytes_widths },
+    { "bitstream_reader_read_u8", reader_read_u8, u8_widths },
+    { "bitstream_reader_read_u16", reader_read_u16, u16_widths },
+    { "bitstream_reader_read_u32", reader_read_u32, u32_widths },
+    { "bitstream_reader_read_u64", reader_read_u64, u64_widths },
+    { "bitstream_reader_read_u64_bits", reader_read_u64_bits, bits_widths },
+    { "bitstream_reader_seek", reader_seek, seek_widths },
+    { "bitstream_reader_tell", reader_tell, bit_widths },
+    {
+        "bitstream_reader_read_u64_bits_seek",
+        reader_read_u64_bits_seek,
+        code_widths
+    },
+    {
+        "bitstream_reader_peek_u64_bits_skip_bits",
+        reader_peek_u64_bits_skip_bits,
+        code_widths
+    },
+    { "bitstream_fast_writer_write_bit", fast_writer_write_bit, bit_widths },
+    {
+        "bitstream_fast_writer_write_bytes",
+        fast_writer_write_bytes,
+        bytes_widths
+    },
+    { "bitstream_fast_writer_write_u8", fast_writer_write_u8, u8_widths },
+    { "bitstream_fast_writer_write_u16", fast_writer_write_u16, u16_widths },
+    { "bitstream_fast_writer_write_u32", fast_writer_write_u32, u32_widths },
+    { "bitstream_fast_writer_write_u64", fast_writer_write_u64, u64_widths },
+    {
+        "bitstream_fast_writer_write_u64_bits",
+        fast_writer_write_u64_bits,
+        bits_widths
+    },
+    { "bitstream_fast_writer_seek", fast_writer_seek, seek_widths },
+    { "bitstream_fast_reader_read_bit", fast_reader_read_bit, bit_widths },
+    {
+        "bitstream_fast_reader_read_bytes",
+        fast_reader_read_bytes,
+        bytes_widths
+    },
+    { "bitstream_fast_reader_read_u8", fast_reader_read_u8, u8_widths },
+    { "bitstream_fast_reader_read_u16", fast_reader_read_u16, u16_widths },
+    { "bitstream_fast_reader_read_u32", fast_reader_read_u32, u32_widths },
+    { "bitstream_fast_reader_read_u64", fast_reader_read_u64, u64_widths },
+    {
+        "bitstream_fast_reader_read_u64_bits",
+        fast_reader_read_u64_bits,
+        bits_widths
+    },
+    { "bitstream_fast_reader_seek", fast_reader_seek, seek_widths },
+    { "bitstream_fast_reader_tell", fast_reader_tell, bit_widths },
+    {
+        "bitstream_fast_reader_peek_u64_bits_skip_bits",
+        fast_reader_peek_u64_bits_skip_bits,
+        code_widths
+    },
+    { "bitstream_lsb_writer_write_bit", lsb_writer_write_bit, bit_widths },
+    {
+        "bitstream_lsb_writer_write_bytes",
+        lsb_writer_write_bytes,
+        bytes_widths
+    },
+    { "bitstream_lsb_writer_write_u8", lsb_writer_write_u8, u8_widths },
+    { "bitstream_lsb_writer_write_u16", lsb_writer_write_u16, u16_widths },
+    { "bitstream_lsb_writer_write_u32", lsb_writer_write_u32, u32_widths },
+    { "bitstream_lsb_writer_write_u64", lsb_writer_write_u64, u64_widths },
+    {
+        "bitstream_lsb_writer_write_u64_bits",
+        lsb_writer_write_u64_bits,
+        bits_widths
+    },
+    { "bitstream_lsb_writer_seek", lsb_writer_seek, seek_widths },
+    { "bitstream_lsb_reader_read_bit", lsb_reader_read_bit, bit_widths },
+    {
+        "bitstream_lsb_reader_read_bytes",
+        lsb_reader_read_bytes,
+        bytes_widths
+    },
+    { "bitstream_lsb_reader_read_u8", lsb_reader_read_u8, u8_widths },
+    { "bitstream_lsb_reader_read_u16", lsb_reader_read_u16, u16_widths },
+    { "bitstream_lsb_reader_read_u32", lsb_reader_read_u32, u32_widths },
+    { "bitstream_lsb_reader_read_u64", lsb_reader_read_u64, u64_widths },
+    {
+        "bitstream_lsb_reader_read_u64_bits",
+        lsb_reader_read_u64_bits,
+        bits_widths
+    },
+    { "bitstream_lsb_reader_seek", lsb_reader_seek, seek_widths },
+    { "bitstream_lsb_reader_tell", lsb_reader_tell, bit_widths },
+    {
+        "bitstream_lsb_reader_peek_u64_bits_skip_bits",
+        lsb_reader_peek_u64_bits_skip_bits,
+        code_widths
+    }
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static int compare_doubles(const void *left_p, const void *right_p)
+{
+    double left;
+    double right;
+
+    left = *(const double *)left_p;
+    right = *(const double *)right_p;
+
+    return ((left > right) - (left < right));
+}
+
+/* Time given number of samples after warmup, in ns per operation. */
+static void measure(const struct case_t *case_p,
+                    int offset,
+                    int width,
+                    int warmup,
+                    int repetitions,
+                    double *samples_p,
+                    struct result_t *result_p)
+{
+    double start;
+    int i;
+
+    for (i = 0; i < warmup; i++) {
+        case_p->run(offset, width);
+    }
+
+    for (i = 0; i < repetitions; i++) {
+        start = now();
+        case_p->run(offset, width);
+        samples_p[i] = ((now() - start) / NUMBER_OF_OPERATIONS);
+    }
+
+    qsort(samples_p, repetitions, sizeof(samples_p[0]), compare_doubles);
+    result_p->median = samples_p[repetitions / 2];
+    result_p->p99 = samples_p[(99 * repetitions + 99) / 100 - 1];
+}
+
+static void usage(const char *name_p)
+{
+    fprintf(stderr,
+            "Usage: %s [-w <warmup>] [-r <repetitions>] [-f <filter>] "
+            "[-j <json file>]\n",
+            name_p);
+}
+
+int main(int argc, char *argv[])
+{
+    const struct case_t *case_p;
+    struct result_t result;
+    const char *filter_p;
+    const char *json_path_p;
+    FILE *json_p;
+    double *samples_p;
+    int warmup;
+    int repetitions;
+    int offset;
+    int number_of_results;
+    const int *width_p;
+    int i;
+    int opt;
+
+    warmup = 5;
+    repetitions = 101;
+    filter_p = NULL;
+    json_path_p = NULL;
+    json_p = NULL;
+
+    while ((opt = getopt(argc, argv, "w:r:f:j:")) != -1) {
+        switch (opt) {
+
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+
+        case 'r':
+            repetitions = atoi(optarg);
+            break;
+
+        case 'f':
+            filter_p = optarg;
+            break;
+
+        case 'j':
+            json_path_p = optarg;
+            break;
+
+        default:
+            usage(argv[0]);
+
+            return (1);
+        }
+    }
+
+    if ((warmup < 0) || (repetitions < 1)) {
+        usage(argv[0]);
+
+        return (1);
+    }
+
+    samples_p = malloc(sizeof(samples_p[0]) * repetitions);
+
+    if (samples_p == NULL) {
+        return (1);
+    }
+
+    if (json_path_p != NULL) {
+        json_p = fopen(json_path_p, "w");
+
+        if (json_p == NULL) {
+            perror(json_path_p);
+            free(samples_p);
+
+            return (1);
+        }
+
+        fprintf(json_p,
+                "{\n"
+                "  \"operations_per_sample\": %d,\n"
+                "  \"warmup\": %d,\n"
+                "  \"repetitions\": %d,\n"
+                "  \"results\": [",
+                NUMBER_OF_OPERATIONS,
+                warmup,
+                repetitions);
+    }
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (uint8_t)(17 * i + 5);
+    }
+
+    memset(&buf[0], 0xa5, sizeof(buf));
+    printf("%-46s %6s %5s %12s %12s %12s\n",
+           "FUNCTION",
+           "OFFSET",
+           "WIDTH",
+           "MEDIAN ns/op",
+           "P99 ns/op",
+           "MB/s");
+    number_of_results = 0;
+
+    for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        case_p = &cases[i];
+
+        if ((filter_p != NULL) && (strstr(case_p->name_p, filter_p) == NULL)) {
+            continue;
+        }
+
+        for (width_p = case_p->widths_p; *width_p != 0; width_p++) {
+            for (offset = 0; offset < 8; offset++) {
+                measure(case_p,
+                        offset,
+                        *width_p,
+                        warmup,
+                        repetitions,
+                        samples_p,
+                        &result);
+                printf("%-46s %6d %5d %12.2f %12.2f %12.1f\n",
+                       case_p->name_p,
+                       offset,
+                       *width_p,
+                       result.median,
+                       result.p99,
+                       (*width_p / 8.0) / result.median * 1e3);
+
+                if (json_p != NULL) {
+                    fprintf(json_p,
+                            "%s\n"
+                            "    {\n"
+                            "      \"function\": \"%s\",\n"
+                            "      \"bit_offset\": %d,\n"
+                            "      \"width\": %d,\n"
+                            "      \"median_ns_per_op\": %.3f,\n"
+                            "      \"p99_ns_per_op\": %.3f,\n"
+                            "      \"bytes_per_second\": %.0f\n"
+                            "    }",
+                            number_of_results > 0 ? "," : "",
+                            case_p->name_p,
+                            offset,
+                            *width_p,
+                            result.median,
+                            result.p99,
+                            (*width_p / 8.0) / result.median * 1e9);
+                }
+
+                number_of_results++;
+            }
+        }
+    }
+
+    if (json_p != NULL) {
+        fprintf(json_p, "\n  ]\n}\n");
+        fclose(json_p);
+    }
+
+    free(samples_p);
+
+    return (0);
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <time.h>
+#include "bitstream.h"
+
+#define NUMBER_OF_MESSAGES 100000
+#define MESSAGE_SIZE 8
+#define NUMBER_OF_RUNS 20
+
+/* A CAN frame like layout with a few unused bits. */
+static const int widths[] = { 3, 1, 9, 5, 7, 2, 8, 4, 6, 9, 1, 5 };
+static const int offsets[] = { 0, 3, 4, 16, 21, 28, 30, 38, 42, 48, 57, 58 };
+
+#define NUMBER_OF_FIELDS (int)(sizeof(widths) / sizeof(widths[0]))
+
+static uint8_t buf[NUMBER_OF_MESSAGES * MESSAGE_SIZE];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static uint64_t decode_fields(void)
+{
+    struct bitstream_fast_reader_t reader;
+    uint64_t values[NUMBER_OF_FIELDS];
+    uint64_t sum;
+    int position;
+    int i;
+    int j;
+
+    sum = 0;
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        position = 0;
+
+        for (j = 0; j < NUMBER_OF_FIELDS; j++) {
+            if (offsets[j] != position) {
+                bitstream_fast_reader_seek(&reader, offsets[j] - position);
+            }
+
+            values[j] = bitstream_fast_reader_read_u64_bits(&reader,
+                                                            widths[j]);
+            position = (offsets[j] + widths[j]);
+        }
+
+        bitstream_fast_reader_seek(&reader, 8 * MESSAGE_SIZE - position);
+        sum += values[i % NUMBER_OF_FIELDS];
+    }
+
+    return (sum);
+}
+
+static uint64_t decode_plan(struct bitstream_plan_t *plan_p)
+{
+    struct bitstream_fast_reader_t reader;
+    uint64_t values[NUMBER_OF_FIELDS];
+    uint64_t sum;
+    int i;
+
+    sum = 0;
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        bitstream_plan_decode(plan_p, &reader, &values[0]);
+        bitstream_fast_reader_seek(&reader,
+                                   8 * MESSAGE_SIZE
+                                   - bitstream_plan_size_in_bits(plan_p));
+        sum += values[i % NUMBER_OF_FIELDS];
+    }
+
+    return (sum);
+}
+
+static uint64_t encode_fields(void)
+{
+    struct bitstream_fast_writer_t writer;
+    uint64_t values[NUMBER_OF_FIELDS];
+    int position;
+    int i;
+    int j;
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        position = 0;
+
+        for (j = 0; j < NUMBER_OF_FIELDS; j++) {
+            values[j] = (uint64_t)(i + j);
+        }
+
+        for (j = 0; j < NUMBER_OF_FIELDS; j++) {
+            if (offsets[j] != position) {
+                bitstream_fast_writer_write_u64_bits(&writer,
+                                                     0,
+                                                     offsets[j] - position);
+            }
+
+            bitstream_fast_writer_write_u64_bits(
+                &writer,
+                values[j] & ((1ull << widths[j]) - 1),
+                widths[j]);
+            position = (offsets[j] + widths[j]);
+        }
+
+        bitstream_fast_writer_write_u64_bits(&writer,
+                                             0,
+                                             8 * MESSAGE_SIZE - position);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+
+    return (bitstream_fast_writer_size_in_bits(&writer));
+}
+
+static uint64_t encode_plan(struct bitstream_plan_t *plan_p)
+{
+    struct bitstream_fast_writer_t writer;
+    uint64_t values[NUMBER_OF_FIELDS];
+    int i;
+    int j;
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        for (j = 0; j < NUMBER_OF_FIELDS; j++) {
+            values[j] = (uint64_t)(i + j);
+        }
+
+        bitstream_plan_encode(plan_p, &writer, &values[0]);
+        bitstream_fast_writer_write_u64_bits(
+            &writer,
+            0,
+            8 * MESSAGE_SIZE - bitstream_plan_size_in_bits(plan_p));
+    }
+
+    bitstream_fast_writer_flush(&writer);
+
+    return (bitstream_fast_writer_size_in_bits(&writer));
+}
+
+static void report(const char *name_p, double fields_ns, double plan_ns)
+{
+    printf("%s: %.1f ns/message per field, %.1f ns/message with plan, "
+           "%.2fx\n",
+           name_p,
+           fields_ns / NUMBER_OF_MESSAGES,
+           plan_ns / NUMBER_OF_MESSAGES,
+           fields_ns / plan_ns);
+}
+
+int main()
+{
+    struct bitstream_plan_t plan;
+    double best[4];
+    double start;
+    double elapsed;
+    uint64_t sum;
+    int run;
+    int i;
+
+    if (bitstream_plan_init(&plan,
+                            &widths[0],
+                            &offsets[0],
+                            NUMBER_OF_FIELDS) != 0) {
+        return (1);
+    }
+
+    for (i = 0; i < 4; i++) {
+        best[i] = 1e18;
+    }
+
+    sum = 0;
+
+    for (run = 0; run < NUMBER_OF_RUNS; run++) {
+        for (i = 0; i < 4; i++) {
+            start = now();
+
+            switch (i) {
+
+            case 0:
+                sum += encode_fields();
+                break;
+
+            case 1:
+                sum += encode_plan(&plan);
+                break;
+
+            case 2:
+                sum += decode_fields();
+                break;
+
+            default:
+                sum += decode_plan(&plan);
+                break;
+            }
+
+            elapsed = (now() - start);
+
+            if (elapsed < best[i]) {
+                best[i] = elapsed;
+            }
+        }
+    }
+
+    report("encode", best[0], best[1]);
+    report("decode", best[2], best[3]);
+
+    return (sum == 0);
+}
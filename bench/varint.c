@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <time.h>
+#include "bitstream.h"
+
+#define NUMBER_OF_VALUES 1000000
+#define NUMBER_OF_RUNS 10
+
+static uint64_t values[NUMBER_OF_VALUES];
+static uint64_t decoded[NUMBER_OF_VALUES];
+static uint8_t buf[10 * NUMBER_OF_VALUES];
+static size_t size;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/* Mostly small values, as protobuf fields and lengths. */
+static void init(void)
+{
+    struct bitstream_fast_writer_t writer;
+    uint64_t state;
+    int i;
+
+    state = 1;
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        state = (state * 6364136223846793005ull + 1442695040888963407ull);
+        values[i] = ((state >> 32) >> ((state >> 8) % 30));
+    }
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        bitstream_fast_writer_write_varint(&writer, values[i]);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    size = bitstream_fast_writer_size_in_bytes(&writer);
+}
+
+/* The usual byte loop on aligned bytes, as a reference. */
+static void byte_loop(void)
+{
+    const uint8_t *buf_p;
+    uint64_t value;
+    int shift;
+    int i;
+
+    buf_p = &buf[0];
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        value = 0;
+
+        for (shift = 0; shift < 64; shift += 7) {
+            value |= ((uint64_t)(*buf_p & 0x7f) << shift);
+
+            if ((*buf_p++ & 0x80) == 0) {
+                break;
+            }
+        }
+
+        decoded[i] = value;
+    }
+}
+
+static void reader(void)
+{
+    struct bitstream_reader_t reader;
+    int i;
+
+    bitstream_reader_init(&reader, &buf[0]);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = bitstream_reader_read_varint(&reader);
+    }
+}
+
+static void fast_reader(void)
+{
+    struct bitstream_fast_reader_t reader;
+    int i;
+
+    bitstream_fast_reader_init(&reader, &buf[0], size);
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        decoded[i] = bitstream_fast_reader_read_varint(&reader);
+    }
+}
+
+static void fast_reader_array(void)
+{
+    struct bitstream_fast_reader_t reader;
+
+    bitstream_fast_reader_init(&reader, &buf[0], size);
+    bitstream_fast_reader_read_varint_array(&reader,
+                                            &decoded[0],
+                                            NUMBER_OF_VALUES);
+}
+
+static double measure(void (*function)(void))
+{
+    double best;
+    double start;
+    double elapsed;
+    int run;
+    int i;
+
+    best = 1e18;
+
+    for (run = 0; run < NUMBER_OF_RUNS; run++) {
+        start = now();
+        function();
+        elapsed = (now() - start);
+
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    for (i = 0; i < NUMBER_OF_VALUES; i++) {
+        if (decoded[i] != values[i]) {
+            printf("Decoding failed.\n");
+
+            return (0.0);
+        }
+
+        decoded[i] = 0;
+    }
+
+    return (best / NUMBER_OF_VALUES);
+}
+
+int main()
+{
+    init();
+    printf("%d values, %.2f bytes/value\n",
+           NUMBER_OF_VALUES,
+           (double)size / NUMBER_OF_VALUES);
+    printf("byte loop         %5.2f ns/value\n", measure(byte_loop));
+    printf("reader            %5.2f ns/value\n", measure(reader));
+    printf("fast reader       %5.2f ns/value\n", measure(fast_reader));
+    printf("fast reader array %5.2f ns/value\n", measure(fast_reader_array));
+
+    return (0);
+}
@@ -27,10 +27,26 @@
 #ifndef BITSTREAM_H
 #define BITSTREAM_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #define BITSTREAM_VERSION "0.8.0"
 
+/* Define BITSTREAM_INLINE before including this file to get the hot
+   reader and writer functions static inline, so the compiler can
+   specialize them for constant widths. */
+#if defined(BITSTREAM_INLINE)
+#    define BITSTREAM_API static inline
+#else
+#    define BITSTREAM_API
+#endif
+
 struct bitstream_writer_t {
     uint8_t *buf_p;
     int byte_offset;
@@ -45,12 +61,170 @@ struct bitstream_writer_bounds_t {
     uint8_t last_byte;
 };
 
+/* Write given bytes to the stream. Returns zero on success, otherwise
+   a negative value. */
+typedef int (*bitstream_fast_writer_sink_t)(void *arg_p,
+                                            const uint8_t *buf_p,
+                                            size_t size);
+
+struct bitstream_fast_writer_t {
+    uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int overflow;
+    bitstream_fast_writer_sink_t sink;
+    void *arg_p;
+    uint64_t buf_offset;
+    struct iovec *segments_p;
+    int max_number_of_segments;
+    int number_of_segments;
+    size_t segment_offset;
+};
+
 struct bitstream_reader_t {
     const uint8_t *buf_p;
     int byte_offset;
     int bit_offset;
 };
 
+/* Read at most given number of bytes from the stream into given
+   buffer. Returns number of read bytes, or zero or a negative value at
+   end of stream. */
+typedef ssize_t (*bitstream_fast_reader_refill_t)(void *arg_p,
+                                                  uint8_t *buf_p,
+                                                  size_t size);
+
+struct bitstream_fast_reader_t {
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int overflow;
+    bitstream_fast_reader_refill_t refill;
+    void *arg_p;
+    uint8_t *window_p;
+    size_t window_size;
+    uint64_t buf_offset;
+    const struct iovec *segments_p;
+    int number_of_segments;
+    uint8_t bridge[16];
+    size_t bridge_head;
+};
+
+struct bitstream_lsb_writer_t {
+    uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int overflow;
+};
+
+struct bitstream_lsb_reader_t {
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int overflow;
+};
+
+#ifndef BITSTREAM_PARALLEL_MAX_THREADS
+#    define BITSTREAM_PARALLEL_MAX_THREADS 64
+#endif
+
+/* Encode record at given index. Returns zero on success, otherwise a
+   negative error code. */
+typedef int (*bitstream_encode_record_t)(
+    struct bitstream_fast_writer_t *writer_p,
+    void *arg_p,
+    int index);
+
+struct bitstream_index_t {
+    int interval;
+    int number_of_records;
+    int number_of_entries;
+    int max_number_of_entries;
+    uint64_t *offsets_p;
+};
+
+#ifndef BITSTREAM_PLAN_MAX_FIELDS
+#    define BITSTREAM_PLAN_MAX_FIELDS 64
+#endif
+
+struct bitstream_plan_group_t {
+    uint64_t mask;
+    uint64_t extract_mask;
+    int skip;
+    int number_of_fields;
+    int number_of_bits;
+    int lane_width;
+};
+
+struct bitstream_plan_t {
+    int number_of_fields;
+    int number_of_groups;
+    int64_t number_of_bits;
+    uint8_t widths[BITSTREAM_PLAN_MAX_FIELDS];
+    uint8_t gaps[BITSTREAM_PLAN_MAX_FIELDS];
+    struct bitstream_plan_group_t groups[BITSTREAM_PLAN_MAX_FIELDS];
+};
+
+#ifndef BITSTREAM_CAN_MAX_SIGNALS
+#    define BITSTREAM_CAN_MAX_SIGNALS 64
+#endif
+
+/* Signal byte orders, @1 and @0 in DBC files. */
+#define BITSTREAM_CAN_INTEL 0
+#define BITSTREAM_CAN_MOTOROLA 1
+
+struct bitstream_can_signal_t {
+    int start;
+    int length;
+    int byte_order;
+    int is_signed;
+    double scale;
+    double offset;
+};
+
+struct bitstream_can_codec_signal_t {
+    uint64_t mask;
+    int byte_offset;
+    int shift;
+    int length;
+    int byte_order;
+    int is_signed;
+    double scale;
+    double offset;
+};
+
+struct bitstream_can_codec_t {
+    int frame_size;
+    int number_of_signals;
+    struct bitstream_can_codec_signal_t signals[BITSTREAM_CAN_MAX_SIGNALS];
+};
+
+#ifndef BITSTREAM_HUFFMAN_MAX_SYMBOLS
+#    define BITSTREAM_HUFFMAN_MAX_SYMBOLS 288
+#endif
+
+#define BITSTREAM_HUFFMAN_MAX_LENGTH 15
+#define BITSTREAM_HUFFMAN_ROOT_BITS 10
+
+/* The root table and room for the subtables of any complete code. */
+#define BITSTREAM_HUFFMAN_TABLE_SIZE                                    \
+    ((1 << BITSTREAM_HUFFMAN_ROOT_BITS) + 6 * BITSTREAM_HUFFMAN_MAX_SYMBOLS)
+
+struct bitstream_huffman_t {
+    int number_of_symbols;
+    uint8_t lengths[BITSTREAM_HUFFMAN_MAX_SYMBOLS];
+    uint16_t codes[BITSTREAM_HUFFMAN_MAX_SYMBOLS];
+    uint32_t table[BITSTREAM_HUFFMAN_TABLE_SIZE];
+};
+
 /*
  * The writer.
  */
@@ -64,6 +238,7 @@ int bitstream_writer_size_in_bytes(struct bitstream_writer_t *self_p);
 
 /* Write bits to the stream. Clears each byte before bits are
    written. */
+BITSTREAM_API
 void bitstream_writer_write_bit(struct bitstream_writer_t *self_p,
                                 int value);
 
@@ -71,19 +246,35 @@ void bitstream_writer_write_bytes(struct bitstream_writer_t *self_p,
                                   const uint8_t *buf_p,
                                   int length);
 
+/* Write given number of bits from given buffer, starting with the
+   most significant bit of the first byte. */
+void bitstream_writer_write_bits(struct bitstream_writer_t *self_p,
+                                 const uint8_t *buf_p,
+                                 int number_of_bits);
+
+/* Write everything written to given other writer, for example to join
+   parts encoded in parallel. */
+void bitstream_writer_append(struct bitstream_writer_t *self_p,
+                             struct bitstream_writer_t *other_p);
+
+BITSTREAM_API
 void bitstream_writer_write_u8(struct bitstream_writer_t *self_p,
                                uint8_t value);
 
+BITSTREAM_API
 void bitstream_writer_write_u16(struct bitstream_writer_t *self_p,
                                 uint16_t value);
 
+BITSTREAM_API
 void bitstream_writer_write_u32(struct bitstream_writer_t *self_p,
                                 uint32_t value);
 
+BITSTREAM_API
 void bitstream_writer_write_u64(struct bitstream_writer_t *self_p,
                                 uint64_t value);
 
 /* Upper unused bits must be zero. */
+BITSTREAM_API
 void bitstream_writer_write_u64_bits(struct bitstream_writer_t *self_p,
                                      uint64_t value,
                                      int number_of_bits);
@@ -96,6 +287,39 @@ void bitstream_writer_write_repeated_u8(struct bitstream_writer_t *self_p,
                                         uint8_t value,
                                         int length);
 
+/* Exp-Golomb codes, ue(v) and se(v) in H.264 and HEVC. */
+void bitstream_writer_write_ue(struct bitstream_writer_t *self_p,
+                               uint32_t value);
+
+void bitstream_writer_write_se(struct bitstream_writer_t *self_p,
+                               int32_t value);
+
+/* Golomb-Rice code with given parameter, 0 to 31. The quotient is
+   written as zeros followed by a one, as in FLAC. */
+void bitstream_writer_write_rice(struct bitstream_writer_t *self_p,
+                                 uint32_t value,
+                                 int parameter);
+
+/* Unary code, given number of zeros followed by a one, and Elias
+   gamma and delta codes of given value, which must be at least one. A
+   gamma code is the Exp-Golomb code of the value minus one. */
+void bitstream_writer_write_unary(struct bitstream_writer_t *self_p,
+                                  uint32_t value);
+
+void bitstream_writer_write_gamma(struct bitstream_writer_t *self_p,
+                                  uint32_t value);
+
+void bitstream_writer_write_delta(struct bitstream_writer_t *self_p,
+                                  uint32_t value);
+
+/* Unsigned LEB128, as protobuf varints, and zigzag encoded signed
+   LEB128, as protobuf sint64. At most ten bytes. */
+void bitstream_writer_write_varint(struct bitstream_writer_t *self_p,
+                                   uint64_t value);
+
+void bitstream_writer_write_signed_varint(struct bitstream_writer_t *self_p,
+                                          int64_t value);
+
 /* Insert bits into the stream. Leaves all other bits unmodified. */
 void bitstream_writer_insert_bit(struct bitstream_writer_t *self_p,
                                  int value);
@@ -126,6 +350,21 @@ void bitstream_writer_insert_u64_bits(struct bitstream_writer_t *self_p,
 void bitstream_writer_seek(struct bitstream_writer_t *self_p,
                            int offset);
 
+/* Insert given number of zero bits at given bit offset, moving all
+   bits from the offset to the end of the stream towards the end. The
+   write position moves by the same number of bits. Use the insert
+   functions to fill in the zero bits. */
+void bitstream_writer_insert_zero_bits(struct bitstream_writer_t *self_p,
+                                       int bit_offset,
+                                       int number_of_bits);
+
+/* Delete given number of bits at given bit offset, moving all bits
+   after them to the end of the stream towards the beginning. The write
+   position moves by the same number of bits. */
+void bitstream_writer_delete_bits(struct bitstream_writer_t *self_p,
+                                  int bit_offset,
+                                  int number_of_bits);
+
 /* Save-restore first and last bytes in given range, so write can be
    used in given range. */
 void bitstream_writer_bounds_save(struct bitstream_writer_bounds_t *self_p,
@@ -135,6 +374,179 @@ void bitstream_writer_bounds_save(struct bitstream_writer_bounds_t *self_p,
 
 void bitstream_writer_bounds_restore(struct bitstream_writer_bounds_t *self_p);
 
+/*
+ * The fast writer. Collects bits in a 64 bits register and stores
+ * them as whole big endian 64 bits words, so each write is a shift and
+ * an or. Call bitstream_fast_writer_flush() to store the last
+ * partially filled word before using the buffer.
+ *
+ * Nothing is stored past the end of the buffer. Instead a sticky
+ * overflow flag is set, which only has to be checked once after the
+ * whole message has been written.
+ *
+ * Positions and sizes are 64 bits, so streams larger than 256 MiB
+ * can be written.
+ */
+
+void bitstream_fast_writer_init(struct bitstream_fast_writer_t *self_p,
+                                uint8_t *buf_p,
+                                size_t size);
+
+/* Write to a stream, for example a file or a socket, using given
+   block buffer of given size, which must be at least 8 bytes. Whole
+   bytes are handed to given sink function whenever the block is full
+   and on flush. The partial last byte is kept until it is complete, so
+   pad the stream to a byte boundary before the final flush. Failed
+   sink calls sets the overflow flag. Seeking backwards is limited to
+   bytes still in the block. */
+void bitstream_fast_writer_init_stream(struct bitstream_fast_writer_t *self_p,
+                                       uint8_t *buf_p,
+                                       size_t size,
+                                       bitstream_fast_writer_sink_t sink,
+                                       void *arg_p);
+
+/* Sink function writing to a file descriptor with write(2). Given
+   argument is a pointer to the file descriptor. */
+int bitstream_fast_writer_sink_fd(void *arg_p,
+                                  const uint8_t *buf_p,
+                                  size_t size);
+
+/* Sink function writing to a FILE with fwrite(3). Given argument is
+   the FILE pointer. */
+int bitstream_fast_writer_sink_file(void *arg_p,
+                                    const uint8_t *buf_p,
+                                    size_t size);
+
+/* Write to a list of segments, ready for writev(2) or sendmsg(2).
+   Bit packed data is written to given buffer as usual, while byte
+   aligned payloads written with
+   bitstream_fast_writer_write_bytes_reference() are referenced
+   instead of copied. Seeking backwards is limited to after the last
+   referenced payload. */
+void bitstream_fast_writer_init_segments(struct bitstream_fast_writer_t *self_p,
+                                         uint8_t *buf_p,
+                                         size_t size,
+                                         struct iovec *segments_p,
+                                         int max_number_of_segments);
+
+uint64_t bitstream_fast_writer_size_in_bits(
+    struct bitstream_fast_writer_t *self_p);
+
+size_t bitstream_fast_writer_size_in_bytes(
+    struct bitstream_fast_writer_t *self_p);
+
+/* Write bits to the stream. Clears each byte before bits are
+   written. */
+BITSTREAM_API
+void bitstream_fast_writer_write_bit(struct bitstream_fast_writer_t *self_p,
+                                     int value);
+
+void bitstream_fast_writer_write_bytes(struct bitstream_fast_writer_t *self_p,
+                                       const uint8_t *buf_p,
+                                       int length);
+
+/* Write everything written to given other writer, which must write
+   to a buffer. The other writer is flushed. */
+void bitstream_fast_writer_append(struct bitstream_fast_writer_t *self_p,
+                                  struct bitstream_fast_writer_t *other_p);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u8(struct bitstream_fast_writer_t *self_p,
+                                    uint8_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u16(struct bitstream_fast_writer_t *self_p,
+                                     uint16_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u32(struct bitstream_fast_writer_t *self_p,
+                                     uint32_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u64(struct bitstream_fast_writer_t *self_p,
+                                     uint64_t value);
+
+/* Upper unused bits must be zero. */
+BITSTREAM_API
+void bitstream_fast_writer_write_u64_bits(
+    struct bitstream_fast_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits);
+
+/* Slow path of bitstream_fast_writer_write_u64_bits(), storing the
+   register. Do not call directly. */
+void bitstream_fast_writer_write_u64_bits_store(
+    struct bitstream_fast_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits);
+
+/* Exp-Golomb and Golomb-Rice codes, as the writer. */
+BITSTREAM_API
+void bitstream_fast_writer_write_ue(struct bitstream_fast_writer_t *self_p,
+                                    uint32_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_se(struct bitstream_fast_writer_t *self_p,
+                                    int32_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_rice(struct bitstream_fast_writer_t *self_p,
+                                      uint32_t value,
+                                      int parameter);
+
+/* Unary, Elias gamma and Elias delta codes, as the writer. */
+BITSTREAM_API
+void bitstream_fast_writer_write_unary(struct bitstream_fast_writer_t *self_p,
+                                       uint32_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_gamma(struct bitstream_fast_writer_t *self_p,
+                                       uint32_t value);
+
+BITSTREAM_API
+void bitstream_fast_writer_write_delta(struct bitstream_fast_writer_t *self_p,
+                                       uint32_t value);
+
+/* Varints, as the writer. */
+void bitstream_fast_writer_write_varint(struct bitstream_fast_writer_t *self_p,
+                                        uint64_t value);
+
+void bitstream_fast_writer_write_signed_varint(
+    struct bitstream_fast_writer_t *self_p,
+    int64_t value);
+
+/* Write given bytes by reference if in segments mode and the write
+   position is byte aligned, otherwise copy them like
+   bitstream_fast_writer_write_bytes(). Given buffer must be valid
+   until the segments have been used. */
+void bitstream_fast_writer_write_bytes_reference(
+    struct bitstream_fast_writer_t *self_p,
+    const uint8_t *buf_p,
+    int length);
+
+/* Flush and add the last bytes of the buffer as a segment. Returns
+   the number of segments. */
+int bitstream_fast_writer_finish_segments(
+    struct bitstream_fast_writer_t *self_p);
+
+/* Store buffered bits in the buffer. Writing may continue after a
+   flush. When writing to a stream, all whole bytes are also handed to
+   the sink. */
+void bitstream_fast_writer_flush(struct bitstream_fast_writer_t *self_p);
+
+/* Move write position. Seeking backwards makes the written size
+   smaller. Bits before the new position in its byte are kept, all
+   other bits in that byte are cleared by the next flush. Seeking to
+   before bytes already handed to the sink, or to before the end of the
+   last referenced payload, sets the overflow flag and leaves the
+   position as is. */
+void bitstream_fast_writer_seek(struct bitstream_fast_writer_t *self_p,
+                                int64_t offset);
+
+/* Returns non-zero if bits were written past the end of the buffer
+   since init. */
+int bitstream_fast_writer_overflow(struct bitstream_fast_writer_t *self_p);
+
 /*
  * The reader.
  */
@@ -143,28 +555,685 @@ void bitstream_reader_init(struct bitstream_reader_t *self_p,
                            const uint8_t *buf_p);
 
 /* Read bits from the stream. */
+BITSTREAM_API
 int bitstream_reader_read_bit(struct bitstream_reader_t *self_p);
 
 void bitstream_reader_read_bytes(struct bitstream_reader_t *self_p,
                                  uint8_t *buf_p,
                                  int length);
 
+BITSTREAM_API
 uint8_t bitstream_reader_read_u8(struct bitstream_reader_t *self_p);
 
+BITSTREAM_API
 uint16_t bitstream_reader_read_u16(struct bitstream_reader_t *self_p);
 
+BITSTREAM_API
 uint32_t bitstream_reader_read_u32(struct bitstream_reader_t *self_p);
 
+BITSTREAM_API
 uint64_t bitstream_reader_read_u64(struct bitstream_reader_t *self_p);
 
+BITSTREAM_API
 uint64_t bitstream_reader_read_u64_bits(struct bitstream_reader_t *self_p,
                                         int number_of_bits);
 
+/* Get given number of bits, 0 to 64, without moving the read
+   position. Typically followed by bitstream_reader_skip_bits() with
+   the number of bits actually used, for example the length of a
+   Huffman code found by looking up the peeked bits in a table. */
+BITSTREAM_API
+uint64_t bitstream_reader_peek_u64_bits(struct bitstream_reader_t *self_p,
+                                        int number_of_bits);
+
+/* Move read position given number of bits forward. */
+BITSTREAM_API
+void bitstream_reader_skip_bits(struct bitstream_reader_t *self_p,
+                                int number_of_bits);
+
+/* Read Exp-Golomb and Golomb-Rice codes written by the writer. The
+   leading zeros are counted a byte at a time, so only bytes of the
+   code are read. An Exp-Golomb code has at most 32 leading zeros. */
+uint32_t bitstream_reader_read_ue(struct bitstream_reader_t *self_p);
+
+int32_t bitstream_reader_read_se(struct bitstream_reader_t *self_p);
+
+uint32_t bitstream_reader_read_rice(struct bitstream_reader_t *self_p,
+                                    int parameter);
+
+/* Read given number of codes. */
+void bitstream_reader_read_ue_array(struct bitstream_reader_t *self_p,
+                                    uint32_t *values_p,
+                                    int length);
+
+void bitstream_reader_read_se_array(struct bitstream_reader_t *self_p,
+                                    int32_t *values_p,
+                                    int length);
+
+void bitstream_reader_read_rice_array(struct bitstream_reader_t *self_p,
+                                      uint32_t *values_p,
+                                      int length,
+                                      int parameter);
+
+/* Read unary, Elias gamma and Elias delta codes. */
+uint32_t bitstream_reader_read_unary(struct bitstream_reader_t *self_p);
+
+uint32_t bitstream_reader_read_gamma(struct bitstream_reader_t *self_p);
+
+uint32_t bitstream_reader_read_delta(struct bitstream_reader_t *self_p);
+
+/* Read varints. The reader does not know the buffer size, so the
+   bytes are read one at a time to never read past the varint. */
+uint64_t bitstream_reader_read_varint(struct bitstream_reader_t *self_p);
+
+int64_t bitstream_reader_read_signed_varint(
+    struct bitstream_reader_t *self_p);
+
 /* Move read position. */
 void bitstream_reader_seek(struct bitstream_reader_t *self_p,
                            int offset);
 
+/* Move read position to given bit offset from the beginning of the
+   stream. */
+void bitstream_reader_seek_to(struct bitstream_reader_t *self_p,
+                              int bit_offset);
+
 /* Get read position. */
 int bitstream_reader_tell(struct bitstream_reader_t *self_p);
 
+/*
+ * The fast reader. Keeps up to 64 bits of the stream in a register
+ * that is refilled with a single unaligned 64 bits load, so each read
+ * is a shift and a mask. The buffer size must be given, as the reader
+ * never loads bytes past its end.
+ *
+ * Zeros are read past the end of the buffer and a sticky overflow flag
+ * is set, which only has to be checked once after the whole message
+ * has been read. The check is part of the refill, so it costs close to
+ * nothing per read.
+ *
+ * Positions and sizes are 64 bits, so streams larger than 256 MiB,
+ * for example memory mapped files, can be read.
+ */
+
+void bitstream_fast_reader_init(struct bitstream_fast_reader_t *self_p,
+                                const uint8_t *buf_p,
+                                size_t size);
+
+/* Read from a stream, for example a file or a socket, using given
+   window buffer of given size, which must be at least 8 bytes. Bytes
+   are read from the stream with given refill function whenever fewer
+   than 8 bytes are left in the window, so memory usage is constant
+   regardless of stream size. Seeking backwards is limited to bytes
+   still in the window. Seeking to before them sets the overflow
+   flag. */
+void bitstream_fast_reader_init_stream(struct bitstream_fast_reader_t *self_p,
+                                       uint8_t *buf_p,
+                                       size_t size,
+                                       bitstream_fast_reader_refill_t refill,
+                                       void *arg_p);
+
+/* Read from given chain of segments, for example NIC buffers, as one
+   stream without copying them into a contiguous buffer. Fields
+   straddling segment boundaries are handled transparently, while
+   fields within a segment are read as fast as from a single
+   buffer. Seeking backwards is limited to the current segment. Seeking
+   to before it sets the overflow flag. */
+void bitstream_fast_reader_init_segments(
+    struct bitstream_fast_reader_t *self_p,
+    const struct iovec *segments_p,
+    int number_of_segments);
+
+/* Refill function reading from a file descriptor with read(2). Given
+   argument is a pointer to the file descriptor. */
+ssize_t bitstream_fast_reader_refill_fd(void *arg_p,
+                                        uint8_t *buf_p,
+                                        size_t size);
+
+/* Read bits from the stream. */
+BITSTREAM_API
+int bitstream_fast_reader_read_bit(struct bitstream_fast_reader_t *self_p);
+
+void bitstream_fast_reader_read_bytes(struct bitstream_fast_reader_t *self_p,
+                                      uint8_t *buf_p,
+                                      int length);
+
+BITSTREAM_API
+uint8_t bitstream_fast_reader_read_u8(struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint16_t bitstream_fast_reader_read_u16(struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_u32(struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint64_t bitstream_fast_reader_read_u64(struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint64_t bitstream_fast_reader_read_u64_bits(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits);
+
+/* Slow path of bitstream_fast_reader_read_u64_bits(), refilling the
+   register. Do not call directly. */
+uint64_t bitstream_fast_reader_read_u64_bits_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits);
+
+/* Get given number of bits, 0 to 56, without moving the read
+   position. Zeros are returned for bits past the end of the stream,
+   but the overflow flag is only set if they are skipped or read. */
+BITSTREAM_API
+uint64_t bitstream_fast_reader_peek_u64_bits(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits);
+
+/* Move read position given number of bits forward. */
+BITSTREAM_API
+void bitstream_fast_reader_skip_bits(struct bitstream_fast_reader_t *self_p,
+                                     int number_of_bits);
+
+/* Slow paths of bitstream_fast_reader_peek_u64_bits() and
+   bitstream_fast_reader_skip_bits(). Do not call directly. */
+uint64_t bitstream_fast_reader_peek_u64_bits_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits);
+
+void bitstream_fast_reader_skip_bits_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits);
+
+/* Read Exp-Golomb and Golomb-Rice codes. The code length is found by
+   counting leading zeros in the register. Codes with more than 32
+   leading zeros are not Exp-Golomb codes and sets the overflow
+   flag. */
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_ue(struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+int32_t bitstream_fast_reader_read_se(struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_rice(
+    struct bitstream_fast_reader_t *self_p,
+    int parameter);
+
+/* Slow paths of the Exp-Golomb and Golomb-Rice readers. The
+   Exp-Golomb slow path returns the 33 bits code number. Do not call
+   directly. */
+uint64_t bitstream_fast_reader_read_ue_refill(
+    struct bitstream_fast_reader_t *self_p);
+
+uint32_t bitstream_fast_reader_read_rice_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int parameter);
+
+/* Read given number of codes. The register is kept in locals and
+   refilled before every code, so there is no hard to predict branch
+   on the code length. */
+void bitstream_fast_reader_read_ue_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length);
+
+void bitstream_fast_reader_read_se_array(
+    struct bitstream_fast_reader_t *self_p,
+    int32_t *values_p,
+    int length);
+
+void bitstream_fast_reader_read_rice_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length,
+    int parameter);
+
+/* Read unary, Elias gamma and Elias delta codes. The code length is
+   found with one count of leading zeros in the register. Gamma and
+   delta codes of values longer than 32 bits sets the overflow
+   flag. */
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_unary(
+    struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_gamma(
+    struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_delta(
+    struct bitstream_fast_reader_t *self_p);
+
+/* Slow paths of bitstream_fast_reader_read_gamma() and
+   bitstream_fast_reader_read_delta(). Do not call directly. */
+uint32_t bitstream_fast_reader_read_gamma_refill(
+    struct bitstream_fast_reader_t *self_p);
+
+uint32_t bitstream_fast_reader_read_delta_refill(
+    struct bitstream_fast_reader_t *self_p);
+
+/* Read given number of gamma or delta codes, for example a block of
+   posting list gaps. As the Exp-Golomb array readers. */
+void bitstream_fast_reader_read_gamma_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length);
+
+void bitstream_fast_reader_read_delta_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length);
+
+/* Read varints. Finds the last byte among the bytes in the register
+   with one count of leading zeros of the inverted continuation bits,
+   and packs the seven bits groups of up to seven bytes without a
+   loop. Longer varints are read a byte at a time. More than ten bytes
+   sets the overflow flag. */
+BITSTREAM_API
+uint64_t bitstream_fast_reader_read_varint(
+    struct bitstream_fast_reader_t *self_p);
+
+BITSTREAM_API
+int64_t bitstream_fast_reader_read_signed_varint(
+    struct bitstream_fast_reader_t *self_p);
+
+/* Slow path of the varint readers. Do not call directly. */
+uint64_t bitstream_fast_reader_read_varint_refill(
+    struct bitstream_fast_reader_t *self_p);
+
+/* Read given number of varints. As the Exp-Golomb array readers, and
+   packs the groups with PEXT on CPUs where it is fast. */
+void bitstream_fast_reader_read_varint_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint64_t *values_p,
+    int length);
+
+void bitstream_fast_reader_read_signed_varint_array(
+    struct bitstream_fast_reader_t *self_p,
+    int64_t *values_p,
+    int length);
+
+/* Move read position. */
+void bitstream_fast_reader_seek(struct bitstream_fast_reader_t *self_p,
+                                int64_t offset);
+
+/* Move read position to given bit offset from the beginning of the
+   stream. */
+void bitstream_fast_reader_seek_to(struct bitstream_fast_reader_t *self_p,
+                                   uint64_t bit_offset);
+
+/* Get read position. */
+uint64_t bitstream_fast_reader_tell(struct bitstream_fast_reader_t *self_p);
+
+/* Returns non-zero if bits were read past the end of the buffer since
+   init. */
+int bitstream_fast_reader_overflow(struct bitstream_fast_reader_t *self_p);
+
+/*
+ * The LSB first writer and reader. Works like the fast writer and
+ * reader, but the first bit of each byte is its least significant bit
+ * and fields are written least significant bit first, as in DEFLATE
+ * and in CAN signals with Intel byte order. Byte aligned u16, u32 and
+ * u64 values are thereby stored little endian. The register is loaded
+ * and stored as little endian 64 bits words.
+ *
+ * Nothing is read or written past the end of the buffer. Instead a
+ * sticky overflow flag is set.
+ */
+
+void bitstream_lsb_writer_init(struct bitstream_lsb_writer_t *self_p,
+                               uint8_t *buf_p,
+                               size_t size);
+
+uint64_t bitstream_lsb_writer_size_in_bits(
+    struct bitstream_lsb_writer_t *self_p);
+
+size_t bitstream_lsb_writer_size_in_bytes(
+    struct bitstream_lsb_writer_t *self_p);
+
+/* Write bits to the stream. Clears each byte before bits are
+   written. */
+BITSTREAM_API
+void bitstream_lsb_writer_write_bit(struct bitstream_lsb_writer_t *self_p,
+                                    int value);
+
+void bitstream_lsb_writer_write_bytes(struct bitstream_lsb_writer_t *self_p,
+                                      const uint8_t *buf_p,
+                                      int length);
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u8(struct bitstream_lsb_writer_t *self_p,
+                                   uint8_t value);
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u16(struct bitstream_lsb_writer_t *self_p,
+                                    uint16_t value);
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u32(struct bitstream_lsb_writer_t *self_p,
+                                    uint32_t value);
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u64(struct bitstream_lsb_writer_t *self_p,
+                                    uint64_t value);
+
+/* Upper unused bits must be zero. */
+BITSTREAM_API
+void bitstream_lsb_writer_write_u64_bits(
+    struct bitstream_lsb_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits);
+
+/* Slow path of bitstream_lsb_writer_write_u64_bits(), storing the
+   register. Do not call directly. */
+void bitstream_lsb_writer_write_u64_bits_store(
+    struct bitstream_lsb_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits);
+
+/* Store buffered bits in the buffer. Writing may continue after a
+   flush. */
+void bitstream_lsb_writer_flush(struct bitstream_lsb_writer_t *self_p);
+
+/* Move write position. Seeking backwards makes the written size
+   smaller. */
+void bitstream_lsb_writer_seek(struct bitstream_lsb_writer_t *self_p,
+                               int64_t offset);
+
+/* Returns non-zero if bits were written past the end of the buffer
+   since init. */
+int bitstream_lsb_writer_overflow(struct bitstream_lsb_writer_t *self_p);
+
+void bitstream_lsb_reader_init(struct bitstream_lsb_reader_t *self_p,
+                               const uint8_t *buf_p,
+                               size_t size);
+
+/* Read bits from the stream. */
+BITSTREAM_API
+int bitstream_lsb_reader_read_bit(struct bitstream_lsb_reader_t *self_p);
+
+void bitstream_lsb_reader_read_bytes(struct bitstream_lsb_reader_t *self_p,
+                                     uint8_t *buf_p,
+                                     int length);
+
+BITSTREAM_API
+uint8_t bitstream_lsb_reader_read_u8(struct bitstream_lsb_reader_t *self_p);
+
+BITSTREAM_API
+uint16_t bitstream_lsb_reader_read_u16(struct bitstream_lsb_reader_t *self_p);
+
+BITSTREAM_API
+uint32_t bitstream_lsb_reader_read_u32(struct bitstream_lsb_reader_t *self_p);
+
+BITSTREAM_API
+uint64_t bitstream_lsb_reader_read_u64(struct bitstream_lsb_reader_t *self_p);
+
+BITSTREAM_API
+uint64_t bitstream_lsb_reader_read_u64_bits(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits);
+
+/* Slow path of bitstream_lsb_reader_read_u64_bits(), refilling the
+   register. Do not call directly. */
+uint64_t bitstream_lsb_reader_read_u64_bits_refill(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits);
+
+/* Same as the fast reader peek and skip. */
+BITSTREAM_API
+uint64_t bitstream_lsb_reader_peek_u64_bits(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits);
+
+BITSTREAM_API
+void bitstream_lsb_reader_skip_bits(struct bitstream_lsb_reader_t *self_p,
+                                    int number_of_bits);
+
+/* Slow paths of bitstream_lsb_reader_peek_u64_bits() and
+   bitstream_lsb_reader_skip_bits(). Do not call directly. */
+uint64_t bitstream_lsb_reader_peek_u64_bits_refill(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits);
+
+void bitstream_lsb_reader_skip_bits_refill(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits);
+
+/* Move read position. */
+void bitstream_lsb_reader_seek(struct bitstream_lsb_reader_t *self_p,
+                               int64_t offset);
+
+/* Move read position to given bit offset from the beginning of the
+   stream. */
+void bitstream_lsb_reader_seek_to(struct bitstream_lsb_reader_t *self_p,
+                                  uint64_t bit_offset);
+
+/* Get read position. */
+uint64_t bitstream_lsb_reader_tell(struct bitstream_lsb_reader_t *self_p);
+
+/* Returns non-zero if bits were read past the end of the buffer since
+   init. */
+int bitstream_lsb_reader_overflow(struct bitstream_lsb_reader_t *self_p);
+
+/*
+ * Layout plans. A plan is compiled once from the widths and offsets
+ * of the fields in a fixed format message and then decodes and
+ * encodes whole messages. Fields are read and written in groups of up
+ * to 56 bits with a single register operation per group, and split
+ * with BMI2 PEXT and PDEP if the CPU supports it.
+ */
+
+/* Field offsets are in bits from the start of the message, in
+   increasing order without overlap. Gaps between fields are skipped
+   when decoding and written as zeros when encoding. Give NULL offsets
+   for fields without gaps. Returns zero on success, or -EINVAL if
+   there are more than BITSTREAM_PLAN_MAX_FIELDS fields, a width is
+   not 1 to 64 or fields overlap. */
+int bitstream_plan_init(struct bitstream_plan_t *self_p,
+                        const int *widths_p,
+                        const int *offsets_p,
+                        int number_of_fields);
+
+/* Number of bits from the start of the message to the end of the
+   last field. */
+uint64_t bitstream_plan_size_in_bits(struct bitstream_plan_t *self_p);
+
+/* Read one value per field, same as calling
+   bitstream_fast_reader_read_u64_bits() once per field. The reader
+   is left at the end of the last field. */
+void bitstream_plan_decode(struct bitstream_plan_t *self_p,
+                           struct bitstream_fast_reader_t *reader_p,
+                           uint64_t *values_p);
+
+/* Write one value per field, same as calling
+   bitstream_fast_writer_write_u64_bits() once per field. Values are
+   truncated to their field width. */
+void bitstream_plan_encode(struct bitstream_plan_t *self_p,
+                           struct bitstream_fast_writer_t *writer_p,
+                           const uint64_t *values_p);
+
+/*
+ * Seek index. Maps record numbers to bit offsets in a stream of
+ * variable length records, sampled every interval records. Any
+ * sampled record can be found without decoding the records before
+ * it, so a decode can for example be split across threads. The index
+ * is kept separately from the stream and can be stored with
+ * bitstream_index_encode().
+ */
+
+/* Initialize an empty index sampling every given number of records,
+   storing up to given number of offsets in given array. Returns zero
+   on success, or -EINVAL if the interval is smaller than one. */
+int bitstream_index_init(struct bitstream_index_t *self_p,
+                         int interval,
+                         uint64_t *offsets_p,
+                         int max_number_of_entries);
+
+/* Add the next record, starting at given bit offset, typically
+   bitstream_writer_size_in_bits() just before the record is
+   written. Returns zero on success, or -ENOSPC if the offsets array
+   is full. */
+int bitstream_index_add(struct bitstream_index_t *self_p,
+                        uint64_t bit_offset);
+
+/* Find the closest sampled record at or before given record. Its bit
+   offset is written to given pointer. Returns the sampled record
+   number, from which records must be decoded up to the wanted one,
+   or -EINVAL if the record is not in the index. */
+int bitstream_index_lookup(struct bitstream_index_t *self_p,
+                           int record,
+                           uint64_t *bit_offset_p);
+
+/* Returns the size in bytes of the encoded index. */
+size_t bitstream_index_encoded_size(struct bitstream_index_t *self_p);
+
+/* Encode the index into given buffer. Returns the number of encoded
+   bytes, or -ENOSPC if the buffer is too small. */
+ssize_t bitstream_index_encode(struct bitstream_index_t *self_p,
+                               uint8_t *buf_p,
+                               size_t size);
+
+/* Decode an index encoded by bitstream_index_encode() into the
+   offsets array given to bitstream_index_init(), replacing its
+   contents. Returns zero on success, -ENOSPC if the offsets array is
+   too small, or -EPROTO if the data is malformed. */
+int bitstream_index_decode(struct bitstream_index_t *self_p,
+                           const uint8_t *buf_p,
+                           size_t size);
+
+/*
+ * CAN signal codec. Compiled once from a DBC like signal table and
+ * then unpacks and packs whole classic CAN or CAN FD frames of up to
+ * 64 bytes. Frames of up to 8 bytes are loaded and stored as a single
+ * 64 bits word and each signal is a shift and a mask. In longer
+ * frames each signal is a single unaligned 64 bits load.
+ */
+
+/* Start bits and byte orders are as in DBC files, that is, the least
+   significant bit of Intel signals and the most significant bit of
+   Motorola signals, with bit 0 being the least significant bit of the
+   first byte. Signals may overlap, as multiplexed signals do. Returns
+   zero on success, or -EINVAL if the frame size is not 1 to 64 bytes,
+   there are more than BITSTREAM_CAN_MAX_SIGNALS signals, or a signal
+   does not fit in the frame. */
+int bitstream_can_codec_init(struct bitstream_can_codec_t *self_p,
+                             const struct bitstream_can_signal_t *signals_p,
+                             int number_of_signals,
+                             int frame_size);
+
+/* Unpack one raw value per signal from given frame. Signed signals
+   are sign extended to 64 bits. */
+void bitstream_can_codec_unpack_raw(struct bitstream_can_codec_t *self_p,
+                                    const uint8_t *frame_p,
+                                    uint64_t *values_p);
+
+/* Pack one raw value per signal into given frame. Values are
+   truncated to their signal length and bits not covered by any
+   signal are cleared. */
+void bitstream_can_codec_pack_raw(struct bitstream_can_codec_t *self_p,
+                                  uint8_t *frame_p,
+                                  const uint64_t *values_p);
+
+/* Same as bitstream_can_codec_unpack_raw(), but values are scaled to
+   physical values, raw * scale + offset. */
+void bitstream_can_codec_unpack(struct bitstream_can_codec_t *self_p,
+                                const uint8_t *frame_p,
+                                double *values_p);
+
+/* Same as bitstream_can_codec_pack_raw(), but given physical values
+   are converted to raw values, (value - offset) / scale, rounded to
+   nearest. */
+void bitstream_can_codec_pack(struct bitstream_can_codec_t *self_p,
+                              uint8_t *frame_p,
+                              const double *values_p);
+
+/*
+ * Canonical Huffman codes of up to BITSTREAM_HUFFMAN_MAX_LENGTH bits,
+ * written most significant bit first with the fast writer and read
+ * with the fast reader. Decoding peeks BITSTREAM_HUFFMAN_MAX_LENGTH
+ * bits once per symbol and looks them up in a table of
+ * 2^BITSTREAM_HUFFMAN_ROOT_BITS entries, followed by a small second
+ * level table for longer codes.
+ */
+
+/* Calculate code lengths of at most given maximum length, 1 to
+   BITSTREAM_HUFFMAN_MAX_LENGTH, from given symbol frequencies. Symbols
+   with frequency zero gets length zero. Returns zero on success, or
+   -EINVAL if there are more than BITSTREAM_HUFFMAN_MAX_SYMBOLS
+   symbols or the symbols does not fit in given maximum length. */
+int bitstream_huffman_lengths(uint8_t *lengths_p,
+                              const uint32_t *frequencies_p,
+                              int number_of_symbols,
+                              int max_length);
+
+/* Initialize the canonical code with given code lengths, which may be
+   zero for unused symbols. Returns zero on success, or -EINVAL if
+   there are more than BITSTREAM_HUFFMAN_MAX_SYMBOLS symbols, a length
+   is longer than BITSTREAM_HUFFMAN_MAX_LENGTH or the lengths are
+   oversubscribed. */
+int bitstream_huffman_init(struct bitstream_huffman_t *self_p,
+                           const uint8_t *lengths_p,
+                           int number_of_symbols);
+
+/* Write given symbol, which must have a non-zero code length. */
+void bitstream_huffman_write_symbol(struct bitstream_huffman_t *self_p,
+                                    struct bitstream_fast_writer_t *writer_p,
+                                    int symbol);
+
+/* Read a symbol. Returns the symbol, or -EPROTO if the bits are not a
+   code of an used symbol. */
+int bitstream_huffman_read_symbol(struct bitstream_huffman_t *self_p,
+                                  struct bitstream_fast_reader_t *reader_p);
+
+/* Write given symbols. */
+void bitstream_huffman_encode(struct bitstream_huffman_t *self_p,
+                              struct bitstream_fast_writer_t *writer_p,
+                              const uint16_t *symbols_p,
+                              int number_of_symbols);
+
+/* Read given number of symbols. Returns zero on success, or -EPROTO
+   as bitstream_huffman_read_symbol(). */
+int bitstream_huffman_decode(struct bitstream_huffman_t *self_p,
+                             struct bitstream_fast_reader_t *reader_p,
+                             uint16_t *symbols_p,
+                             int number_of_symbols);
+
+/*
+ * Parallel encoding. Found in bitstream_parallel.c, which requires
+ * POSIX threads.
+ */
+
+/* Encode given number of records with given callback on up to given
+   number of threads and write them in index order, giving the same
+   bits as encoding them one by one with this writer. Each thread
+   encodes a range of records with a fast writer into its own equally
+   sized slice of given workspace, and the slices are joined with
+   bitstream_fast_writer_append(). The bit offset of each record in
+   this writer is written to given offsets array. Returns zero on
+   success, -ENOSPC if a slice is too small, -EINVAL on bad arguments,
+   or the first error returned by the callback. Nothing is written on
+   failure.
+
+   Threads are created and joined in each call, as keeping a pool
+   would put pthread types in this header. Creating a thread costs
+   tens of microseconds, so give each call at least thousands of
+   records. */
+int bitstream_fast_writer_write_parallel(
+    struct bitstream_fast_writer_t *self_p,
+    int number_of_records,
+    bitstream_encode_record_t encode,
+    void *arg_p,
+    uint64_t *offsets_p,
+    int number_of_threads,
+    uint8_t *workspace_p,
+    size_t workspace_size);
+
+#if defined(BITSTREAM_INLINE)
+#    include "bitstream_inline.h"
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,336 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Erik Moqvist
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BITSTREAM_HPP
+#define BITSTREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include "bitstream.h"
+
+/* C++17 front end with compile time field widths. All classes are thin
+   wrappers around the C structs and never allocate. Define
+   BITSTREAM_INLINE before including this file to get the classic
+   reader and writer inlined as well. */
+
+namespace bitstream {
+
+/* Smallest unsigned type holding given number of bits. */
+template<int N>
+using uint_t = typename std::conditional<
+    (N <= 8), uint8_t,
+    typename std::conditional<
+        (N <= 16), uint16_t,
+        typename std::conditional<(N <= 32), uint32_t, uint64_t>::type
+        >::type
+    >::type;
+
+template<int N>
+constexpr uint64_t mask()
+{
+    static_assert((N >= 1) && (N <= 64), "width must be 1 to 64 bits");
+
+    return (N == 64 ? ~(uint64_t)0 : (((uint64_t)1 << N) - 1));
+}
+
+class Writer {
+public:
+    explicit Writer(uint8_t *buf_p)
+    {
+        bitstream_writer_init(&writer_, buf_p);
+    }
+
+    /* Write the N least significant bits of given value. Upper bits
+       are ignored. */
+    template<int N>
+    void write(uint64_t value)
+    {
+        value &= mask<N>();
+
+        if constexpr (N == 1) {
+            bitstream_writer_write_bit(&writer_, (int)value);
+        } else if constexpr (N == 8) {
+            bitstream_writer_write_u8(&writer_, (uint8_t)value);
+        } else if constexpr (N == 16) {
+            bitstream_writer_write_u16(&writer_, (uint16_t)value);
+        } else if constexpr (N == 32) {
+            bitstream_writer_write_u32(&writer_, (uint32_t)value);
+        } else if constexpr (N == 64) {
+            bitstream_writer_write_u64(&writer_, value);
+        } else {
+            bitstream_writer_write_u64_bits(&writer_, value, N);
+        }
+    }
+
+    int size_in_bits()
+    {
+        return (bitstream_writer_size_in_bits(&writer_));
+    }
+
+    int size_in_bytes()
+    {
+        return (bitstream_writer_size_in_bytes(&writer_));
+    }
+
+    struct bitstream_writer_t *get()
+    {
+        return (&writer_);
+    }
+
+private:
+    struct bitstream_writer_t writer_;
+};
+
+class Reader {
+public:
+    explicit Reader(const uint8_t *buf_p)
+    {
+        bitstream_reader_init(&reader_, buf_p);
+    }
+
+    template<int N>
+    uint_t<N> read()
+    {
+        static_assert((N >= 1) && (N <= 64), "width must be 1 to 64 bits");
+
+        if constexpr (N == 1) {
+            return ((uint_t<N>)bitstream_reader_read_bit(&reader_));
+        } else if constexpr (N == 8) {
+            return (bitstream_reader_read_u8(&reader_));
+        } else if constexpr (N == 16) {
+            return (bitstream_reader_read_u16(&reader_));
+        } else if constexpr (N == 32) {
+            return (bitstream_reader_read_u32(&reader_));
+        } else if constexpr (N == 64) {
+            return (bitstream_reader_read_u64(&reader_));
+        } else {
+            return ((uint_t<N>)bitstream_reader_read_u64_bits(&reader_, N));
+        }
+    }
+
+    void seek(int offset)
+    {
+        bitstream_reader_seek(&reader_, offset);
+    }
+
+    int tell()
+    {
+        return (bitstream_reader_tell(&reader_));
+    }
+
+    struct bitstream_reader_t *get()
+    {
+        return (&reader_);
+    }
+
+private:
+    struct bitstream_reader_t reader_;
+};
+
+/* Writer using the 64 bit accumulator. The common case of a field
+   fitting in the accumulator is inlined with constant shifts, the rest
+   is handed to the library. */
+class FastWriter {
+public:
+    FastWriter(uint8_t *buf_p, size_t size)
+    {
+        bitstream_fast_writer_init(&writer_, buf_p, size);
+    }
+
+    template<int N>
+    void write(uint64_t value)
+    {
+        value &= mask<N>();
+
+        if constexpr (N < 64) {
+            int free_bits = (64 - writer_.number_of_bits);
+
+            if (N < free_bits) {
+                writer_.value |= (value << (free_bits - N));
+                writer_.number_of_bits += N;
+
+                return;
+            }
+        }
+
+        bitstream_fast_writer_write_u64_bits_store(&writer_, value, N);
+    }
+
+    void flush()
+    {
+        bitstream_fast_writer_flush(&writer_);
+    }
+
+    uint64_t size_in_bits()
+    {
+        return (bitstream_fast_writer_size_in_bits(&writer_));
+    }
+
+    size_t size_in_bytes()
+    {
+        return (bitstream_fast_writer_size_in_bytes(&writer_));
+    }
+
+    bool overflow()
+    {
+        return (bitstream_fast_writer_overflow(&writer_) != 0);
+    }
+
+    struct bitstream_fast_writer_t *get()
+    {
+        return (&writer_);
+    }
+
+private:
+    struct bitstream_fast_writer_t writer_;
+};
+
+class FastReader {
+public:
+    FastReader(const uint8_t *buf_p, size_t size)
+    {
+        bitstream_fast_reader_init(&reader_, buf_p, size);
+    }
+
+    template<int N>
+    uint_t<N> read()
+    {
+        static_assert((N >= 1) && (N <= 64), "width must be 1 to 64 bits");
+
+        if constexpr (N < 64) {
+            if (N <= reader_.number_of_bits) {
+                uint64_t value = (reader_.value >> (64 - N));
+                reader_.value <<= N;
+                reader_.number_of_bits -= N;
+
+                return ((uint_t<N>)value);
+            }
+        }
+
+        return ((uint_t<N>)bitstream_fast_reader_read_u64_bits_refill(&reader_,
+                                                                     N));
+    }
+
+    void seek_to(uint64_t bit_offset)
+    {
+        bitstream_fast_reader_seek_to(&reader_, bit_offset);
+    }
+
+    uint64_t tell()
+    {
+        return (bitstream_fast_reader_tell(&reader_));
+    }
+
+    bool overflow()
+    {
+        return (bitstream_fast_reader_overflow(&reader_) != 0);
+    }
+
+    struct bitstream_fast_reader_t *get()
+    {
+        return (&reader_);
+    }
+
+private:
+    struct bitstream_fast_reader_t reader_;
+};
+
+/* Fixed record layout of given field widths, most significant field
+   first. Layouts of at most 56 bits are read and written as one field
+   and split with constant shifts, longer layouts are unrolled field by
+   field. Works with all readers and writers above. */
+template<int... Widths>
+class Layout {
+public:
+    static_assert(sizeof...(Widths) > 0, "layout must have fields");
+    static_assert(((Widths >= 1) && ...) && ((Widths <= 64) && ...),
+                  "width must be 1 to 64 bits");
+
+    static constexpr int number_of_fields = sizeof...(Widths);
+    static constexpr int number_of_bits = (Widths + ...);
+
+    template<typename TReader>
+    static void decode(TReader& reader, uint64_t *values_p)
+    {
+        if constexpr (number_of_bits <= 56) {
+            split(reader.template read<number_of_bits>(),
+                  values_p,
+                  std::make_index_sequence<number_of_fields>());
+        } else {
+            int i = 0;
+
+            ((values_p[i++] = reader.template read<Widths>()), ...);
+        }
+    }
+
+    template<typename TWriter>
+    static void encode(TWriter& writer, const uint64_t *values_p)
+    {
+        if constexpr (number_of_bits <= 56) {
+            writer.template write<number_of_bits>(
+                pack(values_p, std::make_index_sequence<number_of_fields>()));
+        } else {
+            int i = 0;
+
+            (writer.template write<Widths>(values_p[i++]), ...);
+        }
+    }
+
+private:
+    static constexpr int widths[] = { Widths... };
+
+    /* Number of bits after given field. */
+    static constexpr int shift(size_t index)
+    {
+        int value = 0;
+
+        for (size_t i = index + 1; i < sizeof...(Widths); i++) {
+            value += widths[i];
+        }
+
+        return (value);
+    }
+
+    template<size_t... I>
+    static void split(uint64_t value,
+                      uint64_t *values_p,
+                      std::index_sequence<I...>)
+    {
+        ((values_p[I] = ((value >> shift(I)) & mask<widths[I]>())), ...);
+    }
+
+    template<size_t... I>
+    static uint64_t pack(const uint64_t *values_p, std::index_sequence<I...>)
+    {
+        return ((((values_p[I] & mask<widths[I]>()) << shift(I)) | ...));
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,955 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Erik Moqvist
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Hot reader and writer functions. Defined static inline in every
+ * file including bitstream.h if BITSTREAM_INLINE is defined, and out
+ * of line in the library. The fast reader and writer only work on
+ * the 64 bits register inline, and call the library to refill or
+ * store it.
+ */
+
+#ifndef BITSTREAM_INLINE_H
+#define BITSTREAM_INLINE_H
+
+#include "bitstream.h"
+
+BITSTREAM_API
+void bitstream_writer_write_bit(struct bitstream_writer_t *self_p,
+                                int value)
+{
+    if (self_p->bit_offset == 0) {
+        self_p->buf_p[self_p->byte_offset] = (value << 7);
+        self_p->bit_offset = 1;
+    } else {
+        self_p->buf_p[self_p->byte_offset] |= (value << (8 - self_p->bit_offset - 1));
+
+        if (self_p->bit_offset == 7) {
+            self_p->bit_offset = 0;
+            self_p->byte_offset++;
+        } else {
+            self_p->bit_offset++;
+        }
+    }
+}
+
+BITSTREAM_API
+void bitstream_writer_write_u8(struct bitstream_writer_t *self_p,
+                               uint8_t value)
+{
+    if (self_p->bit_offset == 0) {
+        self_p->buf_p[self_p->byte_offset] = value;
+    } else {
+        self_p->buf_p[self_p->byte_offset] |= (value >> self_p->bit_offset);
+        self_p->buf_p[self_p->byte_offset + 1] =
+            (uint8_t)(value << (8 - self_p->bit_offset));
+    }
+
+    self_p->byte_offset++;
+}
+
+BITSTREAM_API
+void bitstream_writer_write_u16(struct bitstream_writer_t *self_p,
+                                uint16_t value)
+{
+    if (self_p->bit_offset == 0) {
+        self_p->buf_p[self_p->byte_offset] = (value >> 8);
+    } else {
+        self_p->buf_p[self_p->byte_offset] |= (value >> (8 + self_p->bit_offset));
+        self_p->buf_p[self_p->byte_offset + 2] =
+            (uint8_t)(value << (8 - self_p->bit_offset));
+        value >>= self_p->bit_offset;
+    }
+
+    self_p->buf_p[self_p->byte_offset + 1] = (uint8_t)value;
+    self_p->byte_offset += 2;
+}
+
+BITSTREAM_API
+void bitstream_writer_write_u32(struct bitstream_writer_t *self_p,
+                                uint32_t value)
+{
+    int i;
+
+    if (self_p->bit_offset == 0) {
+        self_p->buf_p[self_p->byte_offset] = (value >> 24);
+    } else {
+        self_p->buf_p[self_p->byte_offset] |= (value >> (24 + self_p->bit_offset));
+        self_p->buf_p[self_p->byte_offset + 4] =
+            (uint8_t)(value << (8 - self_p->bit_offset));
+        value >>= self_p->bit_offset;
+    }
+
+    for (i = 3; i > 0; i--) {
+        self_p->buf_p[self_p->byte_offset + i] = value;
+        value >>= 8;
+    }
+
+    self_p->byte_offset += 4;
+}
+
+BITSTREAM_API
+void bitstream_writer_write_u64(struct bitstream_writer_t *self_p,
+                                uint64_t value)
+{
+    int i;
+
+
+    if (self_p->bit_offset == 0) {
+        self_p->buf_p[self_p->byte_offset] = (value >> 56);
+    } else {
+        self_p->buf_p[self_p->byte_offset] |= (value >> (56 + self_p->bit_offset));
+        self_p->buf_p[self_p->byte_offset + 8] =
+            (uint8_t)(value << (8 - self_p->bit_offset));
+        value >>= self_p->bit_offset;
+    }
+
+    for (i = 7; i > 0; i--) {
+        self_p->buf_p[self_p->byte_offset + i] = (uint8_t)value;
+        value >>= 8;
+    }
+
+    self_p->byte_offset += 8;
+}
+
+BITSTREAM_API
+void bitstream_writer_write_u64_bits(struct bitstream_writer_t *self_p,
+                                     uint64_t value,
+                                     int number_of_bits)
+{
+    int i;
+    int first_byte_bits;
+    int last_byte_bits;
+    int full_bytes;
+
+    if (number_of_bits == 0) {
+        return;
+    }
+
+    /* Align beginning. */
+    first_byte_bits = (8 - self_p->bit_offset);
+
+    if (first_byte_bits != 8) {
+        if (number_of_bits < first_byte_bits) {
+            self_p->buf_p[self_p->byte_offset] |=
+                (uint8_t)(value << (first_byte_bits - number_of_bits));
+            self_p->bit_offset += number_of_bits;
+        } else {
+            self_p->buf_p[self_p->byte_offset] |= (value >> (number_of_bits
+                                                             - first_byte_bits));
+            self_p->byte_offset++;
+            self_p->bit_offset = 0;
+        }
+
+        number_of_bits -= first_byte_bits;
+
+        if (number_of_bits <= 0) {
+            return;
+        }
+    }
+
+    /* Align end. */
+    last_byte_bits = (number_of_bits % 8);
+    full_bytes = (number_of_bits / 8);
+
+    if (last_byte_bits != 0) {
+        self_p->buf_p[self_p->byte_offset + full_bytes] =
+            (uint8_t)(value << (8 - last_byte_bits));
+        value >>= last_byte_bits;
+        self_p->bit_offset = last_byte_bits;
+    }
+
+    /* Copy middle bytes. */
+    for (i = full_bytes; i > 0; i--) {
+        self_p->buf_p[self_p->byte_offset + i - 1] = (uint8_t)value;
+        value >>= 8;
+    }
+
+    self_p->byte_offset += full_bytes;
+}
+
+BITSTREAM_API
+int bitstream_reader_read_bit(struct bitstream_reader_t *self_p)
+{
+    int value;
+
+    if (self_p->bit_offset == 0) {
+        value = (self_p->buf_p[self_p->byte_offset] >> 7);
+        self_p->bit_offset = 1;
+    } else {
+        value = ((self_p->buf_p[self_p->byte_offset] >> (7 - self_p->bit_offset)) & 0x1);
+
+        if (self_p->bit_offset == 7) {
+            self_p->bit_offset = 0;
+            self_p->byte_offset++;
+        } else {
+            self_p->bit_offset++;
+        }
+    }
+
+    return (value);
+}
+
+BITSTREAM_API
+uint8_t bitstream_reader_read_u8(struct bitstream_reader_t *self_p)
+{
+    uint8_t value;
+
+    value = (self_p->buf_p[self_p->byte_offset] << self_p->bit_offset);
+    self_p->byte_offset++;
+
+    if (self_p->bit_offset != 0) {
+        value |= (self_p->buf_p[self_p->byte_offset] >> (8 - self_p->bit_offset));
+    }
+
+    return (value);
+}
+
+BITSTREAM_API
+uint16_t bitstream_reader_read_u16(struct bitstream_reader_t *self_p)
+{
+    uint16_t value;
+    int i;
+    int offset;
+    const uint8_t *src_p;
+
+    src_p = &self_p->buf_p[self_p->byte_offset];
+    offset = (16 + self_p->bit_offset);
+    value = 0;
+
+    for (i = 0; i < 2; i++) {
+        offset -= 8;
+        value |= ((uint16_t)src_p[i] << offset);
+    }
+
+    if (offset != 0) {
+        value |= (src_p[2] >> (8 - offset));
+    }
+
+    self_p->byte_offset += 2;
+
+    return (value);
+}
+
+BITSTREAM_API
+uint32_t bitstream_reader_read_u32(struct bitstream_reader_t *self_p)
+{
+    uint32_t value;
+    int i;
+    int offset;
+    const uint8_t *src_p;
+
+    src_p = &self_p->buf_p[self_p->byte_offset];
+    offset = (32 + self_p->bit_offset);
+    value = 0;
+
+    for (i = 0; i < 4; i++) {
+        offset -= 8;
+        value |= ((uint32_t)src_p[i] << offset);
+    }
+
+    if (offset != 0) {
+        value |= (src_p[4] >> (8 - offset));
+    }
+
+    self_p->byte_offset += 4;
+
+    return (value);
+}
+
+BITSTREAM_API
+uint64_t bitstream_reader_read_u64(struct bitstream_reader_t *self_p)
+{
+    uint64_t value;
+    int i;
+    int offset;
+    const uint8_t *src_p;
+
+    src_p = &self_p->buf_p[self_p->byte_offset];
+    offset = (64 + self_p->bit_offset);
+    value = 0;
+
+    for (i = 0; i < 8; i++) {
+        offset -= 8;
+        value |= ((uint64_t)src_p[i] << offset);
+    }
+
+    if (offset != 0) {
+        value |= ((uint64_t)src_p[8] >> (8 - offset));
+    }
+
+    self_p->byte_offset += 8;
+
+    return (value);
+}
+
+BITSTREAM_API
+uint64_t bitstream_reader_read_u64_bits(struct bitstream_reader_t *self_p,
+                                        int number_of_bits)
+{
+    uint64_t value;
+    int i;
+    int first_byte_bits;
+    int last_byte_bits;
+    int full_bytes;
+
+    if (number_of_bits == 0) {
+        return (0);
+    }
+
+    /* Align beginning. */
+    first_byte_bits = (8 - self_p->bit_offset);
+
+    if (first_byte_bits != 8) {
+        if (number_of_bits < first_byte_bits) {
+            value = (self_p->buf_p[self_p->byte_offset] >> (first_byte_bits
+                                                            - number_of_bits));
+            value &= ((1 << number_of_bits) - 1);
+            self_p->bit_offset += number_of_bits;
+        } else {
+            value = self_p->buf_p[self_p->byte_offset];
+            value &= ((1 << first_byte_bits) - 1);
+            self_p->byte_offset++;
+            self_p->bit_offset = 0;
+        }
+
+        number_of_bits -= first_byte_bits;
+
+        if (number_of_bits <= 0) {
+            return (value);
+        }
+    } else {
+        value = 0;
+    }
+
+    /* Copy middle bytes. */
+    full_bytes = (number_of_bits / 8);
+
+    for (i = 0; i < full_bytes; i++) {
+        value <<= 8;
+        value |= self_p->buf_p[self_p->byte_offset + i];
+    }
+
+    /* Last byte. */
+    last_byte_bits = (number_of_bits % 8);
+
+    if (last_byte_bits != 0) {
+        value <<= last_byte_bits;
+        value |= (self_p->buf_p[self_p->byte_offset + full_bytes]
+                  >> (8 - last_byte_bits));
+        self_p->bit_offset = last_byte_bits;
+    }
+
+    self_p->byte_offset += full_bytes;
+
+    return (value);
+}
+
+BITSTREAM_API
+uint64_t bitstream_reader_peek_u64_bits(struct bitstream_reader_t *self_p,
+                                        int number_of_bits)
+{
+    const uint8_t *buf_p;
+    uint64_t value;
+    int i;
+    int number_of_bytes;
+
+    if (number_of_bits == 0) {
+        return (0);
+    }
+
+    /* The bits fits in one 64 bits word. */
+    if (number_of_bits <= 56) {
+        buf_p = &self_p->buf_p[self_p->byte_offset];
+        number_of_bytes = ((self_p->bit_offset + number_of_bits + 7) / 8);
+        value = 0;
+
+        for (i = 0; i < number_of_bytes; i++) {
+            value <<= 8;
+            value |= buf_p[i];
+        }
+
+        value >>= (8 * number_of_bytes - self_p->bit_offset - number_of_bits);
+
+        return (value & ((1ull << number_of_bits) - 1));
+    }
+
+    value = bitstream_reader_read_u64_bits(self_p, number_of_bits);
+    bitstream_reader_seek(self_p, -number_of_bits);
+
+    return (value);
+}
+
+BITSTREAM_API
+void bitstream_reader_skip_bits(struct bitstream_reader_t *self_p,
+                                int number_of_bits)
+{
+    number_of_bits += self_p->bit_offset;
+    self_p->byte_offset += (number_of_bits >> 3);
+    self_p->bit_offset = (number_of_bits & 7);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u64_bits(
+    struct bitstream_fast_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits)
+{
+    int free_bits;
+
+    free_bits = (64 - self_p->number_of_bits);
+
+    if ((number_of_bits > 0) && (number_of_bits < free_bits)) {
+        self_p->value |= (value << (free_bits - number_of_bits));
+        self_p->number_of_bits += number_of_bits;
+    } else {
+        bitstream_fast_writer_write_u64_bits_store(self_p,
+                                                   value,
+                                                   number_of_bits);
+    }
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_bit(struct bitstream_fast_writer_t *self_p,
+                                     int value)
+{
+    bitstream_fast_writer_write_u64_bits(self_p, (uint64_t)value, 1);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u8(struct bitstream_fast_writer_t *self_p,
+                                    uint8_t value)
+{
+    bitstream_fast_writer_write_u64_bits(self_p, value, 8);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u16(struct bitstream_fast_writer_t *self_p,
+                                     uint16_t value)
+{
+    bitstream_fast_writer_write_u64_bits(self_p, value, 16);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u32(struct bitstream_fast_writer_t *self_p,
+                                     uint32_t value)
+{
+    bitstream_fast_writer_write_u64_bits(self_p, value, 32);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_u64(struct bitstream_fast_writer_t *self_p,
+                                     uint64_t value)
+{
+    bitstream_fast_writer_write_u64_bits_store(self_p, value, 64);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_ue(struct bitstream_fast_writer_t *self_p,
+                                    uint32_t value)
+{
+    uint64_t code;
+    int number_of_bits;
+
+    code = ((uint64_t)value + 1);
+    number_of_bits = (64 - __builtin_clzll(code));
+
+    if (number_of_bits <= 32) {
+        bitstream_fast_writer_write_u64_bits(self_p,
+                                             code,
+                                             2 * number_of_bits - 1);
+    } else {
+        bitstream_fast_writer_write_u64_bits(self_p, 0, number_of_bits - 1);
+        bitstream_fast_writer_write_u64_bits(self_p, code, number_of_bits);
+    }
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_se(struct bitstream_fast_writer_t *self_p,
+                                    int32_t value)
+{
+    uint64_t code;
+    int number_of_bits;
+
+    if (value > 0) {
+        code = (2 * (uint64_t)value);
+    } else {
+        code = (2 * (uint64_t)(-(int64_t)value) + 1);
+    }
+
+    number_of_bits = (64 - __builtin_clzll(code));
+
+    if (number_of_bits <= 32) {
+        bitstream_fast_writer_write_u64_bits(self_p,
+                                             code,
+                                             2 * number_of_bits - 1);
+    } else {
+        bitstream_fast_writer_write_u64_bits(self_p, 0, number_of_bits - 1);
+        bitstream_fast_writer_write_u64_bits(self_p, code, number_of_bits);
+    }
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_rice(struct bitstream_fast_writer_t *self_p,
+                                      uint32_t value,
+                                      int parameter)
+{
+    uint32_t quotient;
+
+    quotient = (value >> parameter);
+
+    while (quotient >= 32) {
+        bitstream_fast_writer_write_u64_bits(self_p, 0, 32);
+        quotient -= 32;
+    }
+
+    bitstream_fast_writer_write_u64_bits(
+        self_p,
+        (value & ((1ull << parameter) - 1)) | (1ull << parameter),
+        (int)quotient + 1 + parameter);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_unary(struct bitstream_fast_writer_t *self_p,
+                                       uint32_t value)
+{
+    bitstream_fast_writer_write_rice(self_p, value, 0);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_gamma(struct bitstream_fast_writer_t *self_p,
+                                       uint32_t value)
+{
+    bitstream_fast_writer_write_ue(self_p, value - 1);
+}
+
+BITSTREAM_API
+void bitstream_fast_writer_write_delta(struct bitstream_fast_writer_t *self_p,
+                                       uint32_t value)
+{
+    int length;
+    int length_bits;
+
+    length = (64 - __builtin_clzll(value));
+    length_bits = (64 - __builtin_clzll((uint64_t)length));
+    bitstream_fast_writer_write_u64_bits(
+        self_p,
+        ((uint64_t)length << (length - 1)) | (value ^ (1ull << (length - 1))),
+        2 * length_bits + length - 2);
+}
+
+BITSTREAM_API
+uint64_t bitstream_fast_reader_read_u64_bits(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits)
+{
+    uint64_t value;
+
+    if ((number_of_bits == 0) || (number_of_bits > self_p->number_of_bits)) {
+        return (bitstream_fast_reader_read_u64_bits_refill(self_p,
+                                                           number_of_bits));
+    }
+
+    value = ((self_p->value >> 1) >> (63 - number_of_bits));
+    self_p->value = ((self_p->value << 1) << (number_of_bits - 1));
+    self_p->number_of_bits -= number_of_bits;
+
+    return (value);
+}
+
+BITSTREAM_API
+int bitstream_fast_reader_read_bit(struct bitstream_fast_reader_t *self_p)
+{
+    return ((int)bitstream_fast_reader_read_u64_bits(self_p, 1));
+}
+
+BITSTREAM_API
+uint8_t bitstream_fast_reader_read_u8(struct bitstream_fast_reader_t *self_p)
+{
+    return ((uint8_t)bitstream_fast_reader_read_u64_bits(self_p, 8));
+}
+
+BITSTREAM_API
+uint16_t bitstream_fast_reader_read_u16(struct bitstream_fast_reader_t *self_p)
+{
+    return ((uint16_t)bitstream_fast_reader_read_u64_bits(self_p, 16));
+}
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_u32(struct bitstream_fast_reader_t *self_p)
+{
+    return ((uint32_t)bitstream_fast_reader_read_u64_bits(self_p, 32));
+}
+
+BITSTREAM_API
+uint64_t bitstream_fast_reader_read_u64(struct bitstream_fast_reader_t *self_p)
+{
+    return (bitstream_fast_reader_read_u64_bits_refill(self_p, 64));
+}
+
+BITSTREAM_API
+uint64_t bitstream_fast_reader_peek_u64_bits(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits)
+{
+    if ((number_of_bits == 0) || (number_of_bits > self_p->number_of_bits)) {
+        return (bitstream_fast_reader_peek_u64_bits_refill(self_p,
+                                                           number_of_bits));
+    }
+
+    return ((self_p->value >> 1) >> (63 - number_of_bits));
+}
+
+BITSTREAM_API
+void bitstream_fast_reader_skip_bits(struct bitstream_fast_reader_t *self_p,
+                                     int number_of_bits)
+{
+    if ((number_of_bits == 0) || (number_of_bits > self_p->number_of_bits)) {
+        bitstream_fast_reader_skip_bits_refill(self_p, number_of_bits);
+    } else {
+        self_p->value = ((self_p->value << 1) << (number_of_bits - 1));
+        self_p->number_of_bits -= number_of_bits;
+    }
+}
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_ue(struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    int zeros;
+    int number_of_bits;
+
+    value = self_p->value;
+    zeros = __builtin_clzll(value | 1);
+    number_of_bits = (2 * zeros + 1);
+
+    if (number_of_bits > self_p->number_of_bits) {
+        return ((uint32_t)bitstream_fast_reader_read_ue_refill(self_p));
+    }
+
+    self_p->value = ((value << 1) << (number_of_bits - 1));
+    self_p->number_of_bits -= number_of_bits;
+
+    return ((uint32_t)((value << zeros) >> (63 - zeros)) - 1);
+}
+
+BITSTREAM_API
+int32_t bitstream_fast_reader_read_se(struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    uint64_t code_number;
+    int zeros;
+    int number_of_bits;
+
+    value = self_p->value;
+    zeros = __builtin_clzll(value | 1);
+    number_of_bits = (2 * zeros + 1);
+
+    if (number_of_bits > self_p->number_of_bits) {
+        code_number = bitstream_fast_reader_read_ue_refill(self_p);
+    } else {
+        self_p->value = ((value << 1) << (number_of_bits - 1));
+        self_p->number_of_bits -= number_of_bits;
+        code_number = (((value << zeros) >> (63 - zeros)) - 1);
+    }
+
+    if (code_number & 1) {
+        return ((int32_t)((code_number + 1) / 2));
+    } else {
+        return ((int32_t)(-(int64_t)(code_number / 2)));
+    }
+}
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_rice(
+    struct bitstream_fast_reader_t *self_p,
+    int parameter)
+{
+    uint64_t value;
+    int zeros;
+    int number_of_bits;
+
+    value = self_p->value;
+    zeros = __builtin_clzll(value | 1);
+    number_of_bits = (zeros + 1 + parameter);
+
+    if ((value == 0) || (number_of_bits > self_p->number_of_bits)) {
+        return (bitstream_fast_reader_read_rice_refill(self_p, parameter));
+    }
+
+    self_p->value = ((value << 1) << (number_of_bits - 1));
+    self_p->number_of_bits -= number_of_bits;
+
+    /* The one is removed from the remainder by the xor. */
+    return (((uint32_t)zeros << parameter)
+            | ((uint32_t)((value << zeros) >> (63 - parameter))
+               ^ (1u << parameter)));
+}
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_unary(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    int zeros;
+
+    value = self_p->value;
+    zeros = __builtin_clzll(value | 1);
+
+    if ((value == 0) || (zeros >= self_p->number_of_bits)) {
+        return (bitstream_fast_reader_read_rice_refill(self_p, 0));
+    }
+
+    self_p->value = ((value << 1) << zeros);
+    self_p->number_of_bits -= (zeros + 1);
+
+    return ((uint32_t)zeros);
+}
+
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_gamma(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    int zeros;
+    int number_of_bits;
+
+    value = self_p->value;
+    zeros = __builtin_clzll(value | 1);
+    number_of_bits = (2 * zeros + 1);
+
+    if (number_of_bits > self_p->number_of_bits) {
+        return (bitstream_fast_reader_read_gamma_refill(self_p));
+    }
+
+    self_p->value = ((value << 1) << (number_of_bits - 1));
+    self_p->number_of_bits -= number_of_bits;
+
+    return ((uint32_t)((value << zeros) >> (63 - zeros)));
+}
+
+/* The value length is a gamma code in the first 11 bits of the
+   register, followed by the value without its leading one. */
+BITSTREAM_API
+uint32_t bitstream_fast_reader_read_delta(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    int zeros;
+    int length;
+    int number_of_bits;
+
+    value = self_p->value;
+    zeros = __builtin_clzll(value | 1);
+
+    if (zeros < 6) {
+        length = (int)((value << zeros) >> (63 - zeros));
+        number_of_bits = (2 * zeros + length);
+
+        if ((length <= 32) && (number_of_bits <= self_p->number_of_bits)) {
+            self_p->value = ((value << 1) << (number_of_bits - 1));
+            self_p->number_of_bits -= number_of_bits;
+
+            return ((uint32_t)(((value << (2 * zeros)) | (1ull << 63))
+                               >> (64 - length)));
+        }
+    }
+
+    return (bitstream_fast_reader_read_delta_refill(self_p));
+}
+
+/* The last byte is the first one with its continuation bit cleared.
+   Bytes past the valid bits may be zero, so a byte found there is
+   left to the slow path. */
+BITSTREAM_API
+uint64_t bitstream_fast_reader_read_varint(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    int number_of_bits;
+
+    value = self_p->value;
+    number_of_bits = (__builtin_clzll((~value & 0x8080808080808080ull) | 1)
+                      + 8);
+
+    if (number_of_bits > self_p->number_of_bits) {
+        return (bitstream_fast_reader_read_varint_refill(self_p));
+    }
+
+    self_p->value = ((value << 1) << (number_of_bits - 1));
+    self_p->number_of_bits -= number_of_bits;
+
+    /* First byte least significant, then pack the groups. */
+    value = (__builtin_bswap64(value) & (~0ull >> (64 - number_of_bits)));
+    value &= 0x7f7f7f7f7f7f7f7full;
+    value = (((value & 0x7f007f007f007f00ull) >> 1)
+             | (value & 0x007f007f007f007full));
+    value = (((value & 0x3fff00003fff0000ull) >> 2)
+             | (value & 0x00003fff00003fffull));
+    value = (((value & 0x0fffffff00000000ull) >> 4)
+             | (value & 0x000000000fffffffull));
+
+    return (value);
+}
+
+BITSTREAM_API
+int64_t bitstream_fast_reader_read_signed_varint(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+
+    value = bitstream_fast_reader_read_varint(self_p);
+
+    return ((int64_t)((value >> 1) ^ -(value & 1)));
+}
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u64_bits(
+    struct bitstream_lsb_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits)
+{
+    if ((number_of_bits > 0)
+        && (number_of_bits < (64 - self_p->number_of_bits))) {
+        self_p->value |= (value << self_p->number_of_bits);
+        self_p->number_of_bits += number_of_bits;
+    } else {
+        bitstream_lsb_writer_write_u64_bits_store(self_p,
+                                                  value,
+                                                  number_of_bits);
+    }
+}
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_bit(struct bitstream_lsb_writer_t *self_p,
+                                    int value)
+{
+    bitstream_lsb_writer_write_u64_bits(self_p, (uint64_t)value, 1);
+}
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u8(struct bitstream_lsb_writer_t *self_p,
+                                   uint8_t value)
+{
+    bitstream_lsb_writer_write_u64_bits(self_p, value, 8);
+}
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u16(struct bitstream_lsb_writer_t *self_p,
+                                    uint16_t value)
+{
+    bitstream_lsb_writer_write_u64_bits(self_p, value, 16);
+}
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u32(struct bitstream_lsb_writer_t *self_p,
+                                    uint32_t value)
+{
+    bitstream_lsb_writer_write_u64_bits(self_p, value, 32);
+}
+
+BITSTREAM_API
+void bitstream_lsb_writer_write_u64(struct bitstream_lsb_writer_t *self_p,
+                                    uint64_t value)
+{
+    bitstream_lsb_writer_write_u64_bits_store(self_p, value, 64);
+}
+
+BITSTREAM_API
+uint64_t bitstream_lsb_reader_read_u64_bits(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits)
+{
+    uint64_t value;
+
+    if ((number_of_bits == 0) || (number_of_bits > self_p->number_of_bits)) {
+        return (bitstream_lsb_reader_read_u64_bits_refill(self_p,
+                                                          number_of_bits));
+    }
+
+    value = (self_p->value & (~(uint64_t)0 >> (64 - number_of_bits)));
+    self_p->value >>= number_of_bits;
+    self_p->number_of_bits -= number_of_bits;
+
+    return (value);
+}
+
+BITSTREAM_API
+int bitstream_lsb_reader_read_bit(struct bitstream_lsb_reader_t *self_p)
+{
+    return ((int)bitstream_lsb_reader_read_u64_bits(self_p, 1));
+}
+
+BITSTREAM_API
+uint8_t bitstream_lsb_reader_read_u8(struct bitstream_lsb_reader_t *self_p)
+{
+    return ((uint8_t)bitstream_lsb_reader_read_u64_bits(self_p, 8));
+}
+
+BITSTREAM_API
+uint16_t bitstream_lsb_reader_read_u16(struct bitstream_lsb_reader_t *self_p)
+{
+    return ((uint16_t)bitstream_lsb_reader_read_u64_bits(self_p, 16));
+}
+
+BITSTREAM_API
+uint32_t bitstream_lsb_reader_read_u32(struct bitstream_lsb_reader_t *self_p)
+{
+    return ((uint32_t)bitstream_lsb_reader_read_u64_bits(self_p, 32));
+}
+
+BITSTREAM_API
+uint64_t bitstream_lsb_reader_read_u64(struct bitstream_lsb_reader_t *self_p)
+{
+    return (bitstream_lsb_reader_read_u64_bits_refill(self_p, 64));
+}
+
+BITSTREAM_API
+uint64_t bitstream_lsb_reader_peek_u64_bits(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits)
+{
+    if ((number_of_bits == 0) || (number_of_bits > self_p->number_of_bits)) {
+        return (bitstream_lsb_reader_peek_u64_bits_refill(self_p,
+                                                          number_of_bits));
+    }
+
+    return (self_p->value & (~(uint64_t)0 >> (64 - number_of_bits)));
+}
+
+BITSTREAM_API
+void bitstream_lsb_reader_skip_bits(struct bitstream_lsb_reader_t *self_p,
+                                    int number_of_bits)
+{
+    if ((number_of_bits == 0) || (number_of_bits > self_p->number_of_bits)) {
+        bitstream_lsb_reader_skip_bits_refill(self_p, number_of_bits);
+    } else {
+        self_p->value >>= number_of_bits;
+        self_p->number_of_bits -= number_of_bits;
+    }
+}
+
+#endif
@@ -24,194 +24,377 @@
  * SOFTWARE.
  */
 
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+/* The library always has the functions out of line. */
+#undef BITSTREAM_INLINE
 #include "bitstream.h"
+#include "bitstream_inline.h"
 
-void bitstream_writer_init(struct bitstream_writer_t *self_p,
-                           uint8_t *buf_p)
+#if defined(__GNUC__) && defined(__x86_64__)
+#    define BITSTREAM_X86_64
+#    include <immintrin.h>
+#endif
+
+#if defined(BITSTREAM_X86_64)
+
+/* PDEP and PEXT are microcoded and very slow on AMD CPUs before
+   Zen 3. */
+static int cpu_has_fast_bmi2(void)
 {
-    self_p->buf_p = buf_p;
-    self_p->byte_offset = 0;
-    self_p->bit_offset = 0;
+    __builtin_cpu_init();
+
+    return (__builtin_cpu_supports("bmi2")
+            && !__builtin_cpu_is("bdver4")
+            && !__builtin_cpu_is("znver1")
+            && !__builtin_cpu_is("znver2"));
 }
 
-int bitstream_writer_size_in_bits(struct bitstream_writer_t *self_p)
+#endif
+
+static uint64_t load_u64_be(const uint8_t *buf_p)
 {
-    return (8 * self_p->byte_offset + self_p->bit_offset);
+    uint64_t value;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(&value, buf_p, sizeof(value));
+    value = __builtin_bswap64(value);
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    memcpy(&value, buf_p, sizeof(value));
+#else
+    int i;
+
+    value = 0;
+
+    for (i = 0; i < 8; i++) {
+        value <<= 8;
+        value |= buf_p[i];
+    }
+#endif
+
+    return (value);
 }
 
-int bitstream_writer_size_in_bytes(struct bitstream_writer_t *self_p)
+static void store_u64_be(uint8_t *buf_p, uint64_t value)
 {
-    return (self_p->byte_offset + (self_p->bit_offset + 7) / 8);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    value = __builtin_bswap64(value);
+    memcpy(buf_p, &value, sizeof(value));
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    memcpy(buf_p, &value, sizeof(value));
+#else
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        buf_p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+#endif
 }
 
-void bitstream_writer_write_bit(struct bitstream_writer_t *self_p,
-                                int value)
+static uint64_t load_u64_le(const uint8_t *buf_p)
 {
-    if (self_p->bit_offset == 0) {
-        self_p->buf_p[self_p->byte_offset] = (value << 7);
-        self_p->bit_offset = 1;
-    } else {
-        self_p->buf_p[self_p->byte_offset] |= (value << (8 - self_p->bit_offset - 1));
+    uint64_t value;
 
-        if (self_p->bit_offset == 7) {
-            self_p->bit_offset = 0;
-            self_p->byte_offset++;
-        } else {
-            self_p->bit_offset++;
-        }
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(&value, buf_p, sizeof(value));
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    memcpy(&value, buf_p, sizeof(value));
+    value = __builtin_bswap64(value);
+#else
+    int i;
+
+    value = 0;
+
+    for (i = 7; i >= 0; i--) {
+        value <<= 8;
+        value |= buf_p[i];
     }
+#endif
+
+    return (value);
 }
 
-void bitstream_writer_write_bytes(struct bitstream_writer_t *self_p,
-                                  const uint8_t *buf_p,
-                                  int length)
+static void store_u64_le(uint8_t *buf_p, uint64_t value)
 {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(buf_p, &value, sizeof(value));
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    value = __builtin_bswap64(value);
+    memcpy(buf_p, &value, sizeof(value));
+#else
     int i;
-    uint8_t *dst_p;
 
-    dst_p = &self_p->buf_p[self_p->byte_offset];
+    for (i = 0; i < 8; i++) {
+        buf_p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+#endif
+}
 
-    if (self_p->bit_offset == 0) {
-        memcpy(dst_p, buf_p, sizeof(uint8_t) * length);
-    } else {
-        for (i = 0; i < length; i++) {
-            dst_p[i] |= (buf_p[i] >> self_p->bit_offset);
-            dst_p[i + 1] = (uint8_t)(buf_p[i] << (8 - self_p->bit_offset));
-        }
+typedef void (*shift_bytes_left_t)(uint8_t *dst_p,
+                                   const uint8_t *src_p,
+                                   int length,
+                                   int shift);
+
+/* Funnel shift given number of bytes left by 1 to 7 bits, shifting
+   in bits from the next byte. Reads one byte more than written. */
+static void shift_bytes_left_words(uint8_t *dst_p,
+                                   const uint8_t *src_p,
+                                   int length,
+                                   int shift)
+{
+    int i;
+
+    while (length >= 8) {
+        store_u64_be(dst_p,
+                     ((load_u64_be(src_p) << shift)
+                      | (src_p[8] >> (8 - shift))));
+        dst_p += 8;
+        src_p += 8;
+        length -= 8;
     }
 
-    self_p->byte_offset += length;
+    for (i = 0; i < length; i++) {
+        dst_p[i] = (uint8_t)((src_p[i] << shift) | (src_p[i + 1] >> (8 - shift)));
+    }
 }
 
-void bitstream_writer_write_u8(struct bitstream_writer_t *self_p,
-                               uint8_t value)
+#if defined(__GNUC__)
+
+/* Portable vectors, compiled to SSE2 on x86-64 and NEON on ARM. */
+typedef uint8_t bytes16_t __attribute__((vector_size(16)));
+
+static void shift_bytes_left_16(uint8_t *dst_p,
+                                const uint8_t *src_p,
+                                int length,
+                                int shift)
 {
-    if (self_p->bit_offset == 0) {
-        self_p->buf_p[self_p->byte_offset] = value;
-    } else {
-        self_p->buf_p[self_p->byte_offset] |= (value >> self_p->bit_offset);
-        self_p->buf_p[self_p->byte_offset + 1] =
-            (uint8_t)(value << (8 - self_p->bit_offset));
+    bytes16_t first;
+    bytes16_t second;
+
+    while (length >= 16) {
+        memcpy(&first, src_p, sizeof(first));
+        memcpy(&second, src_p + 1, sizeof(second));
+        first = ((first << shift) | (second >> (8 - shift)));
+        memcpy(dst_p, &first, sizeof(first));
+        dst_p += 16;
+        src_p += 16;
+        length -= 16;
     }
 
-    self_p->byte_offset++;
+    shift_bytes_left_words(dst_p, src_p, length, shift);
 }
 
-void bitstream_writer_write_u16(struct bitstream_writer_t *self_p,
-                                uint16_t value)
+#endif
+
+#if defined(BITSTREAM_X86_64)
+
+typedef uint8_t bytes32_t __attribute__((vector_size(32)));
+
+__attribute__((target("avx2")))
+static void shift_bytes_left_32(uint8_t *dst_p,
+                                const uint8_t *src_p,
+                                int length,
+                                int shift)
 {
-    if (self_p->bit_offset == 0) {
-        self_p->buf_p[self_p->byte_offset] = (value >> 8);
-    } else {
-        self_p->buf_p[self_p->byte_offset] |= (value >> (8 + self_p->bit_offset));
-        self_p->buf_p[self_p->byte_offset + 2] =
-            (uint8_t)(value << (8 - self_p->bit_offset));
-        value >>= self_p->bit_offset;
+    bytes32_t first;
+    bytes32_t second;
+
+    while (length >= 32) {
+        memcpy(&first, src_p, sizeof(first));
+        memcpy(&second, src_p + 1, sizeof(second));
+        first = ((first << shift) | (second >> (8 - shift)));
+        memcpy(dst_p, &first, sizeof(first));
+        dst_p += 32;
+        src_p += 32;
+        length -= 32;
     }
 
-    self_p->buf_p[self_p->byte_offset + 1] = (uint8_t)value;
-    self_p->byte_offset += 2;
+    /* Avoid AVX to SSE transition penalties in the tail. */
+    _mm256_zeroupper();
+    shift_bytes_left_16(dst_p, src_p, length, shift);
 }
 
-void bitstream_writer_write_u32(struct bitstream_writer_t *self_p,
-                                uint32_t value)
-{
-    int i;
+#endif
 
-    if (self_p->bit_offset == 0) {
-        self_p->buf_p[self_p->byte_offset] = (value >> 24);
+static void shift_bytes_left_resolve(uint8_t *dst_p,
+                                     const uint8_t *src_p,
+                                     int length,
+                                     int shift);
+
+static shift_bytes_left_t shift_bytes_left_vector = shift_bytes_left_resolve;
+
+/* Short copies are not worth the indirect call. */
+static void shift_bytes_left(uint8_t *dst_p,
+                             const uint8_t *src_p,
+                             int length,
+                             int shift)
+{
+    if (length < 16) {
+        shift_bytes_left_words(dst_p, src_p, length, shift);
     } else {
-        self_p->buf_p[self_p->byte_offset] |= (value >> (24 + self_p->bit_offset));
-        self_p->buf_p[self_p->byte_offset + 4] =
-            (uint8_t)(value << (8 - self_p->bit_offset));
-        value >>= self_p->bit_offset;
+        shift_bytes_left_vector(dst_p, src_p, length, shift);
     }
+}
 
-    for (i = 3; i > 0; i--) {
-        self_p->buf_p[self_p->byte_offset + i] = value;
-        value >>= 8;
+/* Select implementation on first call. */
+static void shift_bytes_left_resolve(uint8_t *dst_p,
+                                     const uint8_t *src_p,
+                                     int length,
+                                     int shift)
+{
+#if defined(__GNUC__)
+    shift_bytes_left_vector = shift_bytes_left_16;
+#else
+    shift_bytes_left_vector = shift_bytes_left_words;
+#endif
+
+#if defined(BITSTREAM_X86_64)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        shift_bytes_left_vector = shift_bytes_left_32;
     }
+#endif
 
-    self_p->byte_offset += 4;
+    shift_bytes_left_vector(dst_p, src_p, length, shift);
 }
 
-void bitstream_writer_write_u64(struct bitstream_writer_t *self_p,
-                                uint64_t value)
+/* Same as shift_bytes_left(), but from the end to the beginning, so
+   the destination may overlap the source at a higher address. */
+static void shift_bytes_left_backward(uint8_t *dst_p,
+                                      const uint8_t *src_p,
+                                      int length,
+                                      int shift)
 {
-    int i;
-
-
-    if (self_p->bit_offset == 0) {
-        self_p->buf_p[self_p->byte_offset] = (value >> 56);
-    } else {
-        self_p->buf_p[self_p->byte_offset] |= (value >> (56 + self_p->bit_offset));
-        self_p->buf_p[self_p->byte_offset + 8] =
-            (uint8_t)(value << (8 - self_p->bit_offset));
-        value >>= self_p->bit_offset;
+#if defined(__GNUC__)
+    bytes16_t first;
+    bytes16_t second;
+
+    while (length >= 16) {
+        length -= 16;
+        memcpy(&first, &src_p[length], sizeof(first));
+        memcpy(&second, &src_p[length + 1], sizeof(second));
+        first = ((first << shift) | (second >> (8 - shift)));
+        memcpy(&dst_p[length], &first, sizeof(first));
     }
+#endif
 
-    for (i = 7; i > 0; i--) {
-        self_p->buf_p[self_p->byte_offset + i] = (uint8_t)value;
-        value >>= 8;
+    while (length >= 8) {
+        length -= 8;
+        store_u64_be(&dst_p[length],
+                     ((load_u64_be(&src_p[length]) << shift)
+                      | (src_p[length + 8] >> (8 - shift))));
     }
 
-    self_p->byte_offset += 8;
+    while (length > 0) {
+        length--;
+        dst_p[length] = (uint8_t)((src_p[length] << shift)
+                                  | (src_p[length + 1] >> (8 - shift)));
+    }
 }
 
-void bitstream_writer_write_u64_bits(struct bitstream_writer_t *self_p,
-                                     uint64_t value,
-                                     int number_of_bits)
+/* Clear given number of bits starting at given bit offset. */
+static void clear_bits(uint8_t *buf_p, int bit_offset, int number_of_bits)
 {
-    int i;
-    int first_byte_bits;
-    int last_byte_bits;
-    int full_bytes;
+    int byte_offset;
+    int first;
 
     if (number_of_bits == 0) {
         return;
     }
 
-    /* Align beginning. */
-    first_byte_bits = (8 - self_p->bit_offset);
+    byte_offset = (bit_offset / 8);
+    first = (bit_offset % 8);
 
-    if (first_byte_bits != 8) {
-        if (number_of_bits < first_byte_bits) {
-            self_p->buf_p[self_p->byte_offset] |=
-                (uint8_t)(value << (first_byte_bits - number_of_bits));
-            self_p->bit_offset += number_of_bits;
-        } else {
-            self_p->buf_p[self_p->byte_offset] |= (value >> (number_of_bits
-                                                             - first_byte_bits));
-            self_p->byte_offset++;
-            self_p->bit_offset = 0;
-        }
+    if (first + number_of_bits <= 8) {
+        buf_p[byte_offset] &= ~((0xff >> first)
+                                & (0xff << (8 - first - number_of_bits)));
 
-        number_of_bits -= first_byte_bits;
+        return;
+    }
 
-        if (number_of_bits <= 0) {
-            return;
-        }
+    if (first != 0) {
+        buf_p[byte_offset] &= ~(0xff >> first);
+        byte_offset++;
+        number_of_bits -= (8 - first);
     }
 
-    /* Align end. */
-    last_byte_bits = (number_of_bits % 8);
-    full_bytes = (number_of_bits / 8);
+    memset(&buf_p[byte_offset], 0, (size_t)(number_of_bits / 8));
+    byte_offset += (number_of_bits / 8);
 
-    if (last_byte_bits != 0) {
-        self_p->buf_p[self_p->byte_offset + full_bytes] =
-            (uint8_t)(value << (8 - last_byte_bits));
-        value >>= last_byte_bits;
-        self_p->bit_offset = last_byte_bits;
+    if ((number_of_bits % 8) != 0) {
+        buf_p[byte_offset] &= (0xff >> (number_of_bits % 8));
     }
+}
 
-    /* Copy middle bytes. */
-    for (i = full_bytes; i > 0; i--) {
-        self_p->buf_p[self_p->byte_offset + i - 1] = (uint8_t)value;
-        value >>= 8;
+void bitstream_writer_init(struct bitstream_writer_t *self_p,
+                           uint8_t *buf_p)
+{
+    self_p->buf_p = buf_p;
+    self_p->byte_offset = 0;
+    self_p->bit_offset = 0;
+}
+
+int bitstream_writer_size_in_bits(struct bitstream_writer_t *self_p)
+{
+    return (8 * self_p->byte_offset + self_p->bit_offset);
+}
+
+int bitstream_writer_size_in_bytes(struct bitstream_writer_t *self_p)
+{
+    return (self_p->byte_offset + (self_p->bit_offset + 7) / 8);
+}
+
+void bitstream_writer_write_bytes(struct bitstream_writer_t *self_p,
+                                  const uint8_t *buf_p,
+                                  int length)
+{
+    uint8_t *dst_p;
+
+    dst_p = &self_p->buf_p[self_p->byte_offset];
+
+    if (self_p->bit_offset == 0) {
+        memcpy(dst_p, buf_p, sizeof(uint8_t) * length);
+    } else if (length > 0) {
+        dst_p[0] |= (buf_p[0] >> self_p->bit_offset);
+        shift_bytes_left(&dst_p[1],
+                         buf_p,
+                         length - 1,
+                         8 - self_p->bit_offset);
+        dst_p[length] = (uint8_t)(buf_p[length - 1] << (8 - self_p->bit_offset));
+    }
+
+    self_p->byte_offset += length;
+}
+
+void bitstream_writer_write_bits(struct bitstream_writer_t *self_p,
+                                 const uint8_t *buf_p,
+                                 int number_of_bits)
+{
+    int rest;
+
+    bitstream_writer_write_bytes(self_p, buf_p, number_of_bits / 8);
+    rest = (number_of_bits % 8);
+
+    if (rest != 0) {
+        bitstream_writer_write_u64_bits(self_p,
+                                        buf_p[number_of_bits / 8] >> (8 - rest),
+                                        rest);
     }
+}
 
-    self_p->byte_offset += full_bytes;
+void bitstream_writer_append(struct bitstream_writer_t *self_p,
+                             struct bitstream_writer_t *other_p)
+{
+    bitstream_writer_write_bits(self_p,
+                                other_p->buf_p,
+                                bitstream_writer_size_in_bits(other_p));
 }
 
 void bitstream_writer_write_repeated_bit(struct bitstream_writer_t *self_p,
@@ -240,6 +423,171 @@ void bitstream_writer_write_repeated_u8(struct bitstream_writer_t *self_p,
     }
 }
 
+/* Exp-Golomb code number of given signed value, 1, -1, 2, -2 ... to
+   1, 2, 3, 4 ... Does not fit in 32 bits for INT32_MIN. */
+static uint64_t exp_golomb_code_number(int32_t value)
+{
+    if (value > 0) {
+        return (2 * (uint64_t)value - 1);
+    } else {
+        return (2 * (uint64_t)(-(int64_t)value));
+    }
+}
+
+static int32_t exp_golomb_signed(uint64_t code_number)
+{
+    if (code_number & 1) {
+        return ((int32_t)((code_number + 1) / 2));
+    } else {
+        return ((int32_t)(-(int64_t)(code_number / 2)));
+    }
+}
+
+/* Given code number plus one as leading zeros followed by its own
+   bits. */
+static void writer_write_exp_golomb(struct bitstream_writer_t *self_p,
+                                    uint64_t value)
+{
+    int number_of_bits;
+
+    number_of_bits = (64 - __builtin_clzll(value));
+
+    if (number_of_bits <= 32) {
+        bitstream_writer_write_u64_bits(self_p, value, 2 * number_of_bits - 1);
+    } else {
+        bitstream_writer_write_u64_bits(self_p, 0, number_of_bits - 1);
+        bitstream_writer_write_u64_bits(self_p, value, number_of_bits);
+    }
+}
+
+void bitstream_writer_write_ue(struct bitstream_writer_t *self_p,
+                               uint32_t value)
+{
+    writer_write_exp_golomb(self_p, (uint64_t)value + 1);
+}
+
+void bitstream_writer_write_se(struct bitstream_writer_t *self_p,
+                               int32_t value)
+{
+    writer_write_exp_golomb(self_p, exp_golomb_code_number(value) + 1);
+}
+
+void bitstream_writer_write_rice(struct bitstream_writer_t *self_p,
+                                 uint32_t value,
+                                 int parameter)
+{
+    uint32_t quotient;
+    uint64_t remainder;
+
+    quotient = (value >> parameter);
+    remainder = ((value & ((1ull << parameter) - 1)) | (1ull << parameter));
+
+    if (quotient < 32) {
+        bitstream_writer_write_u64_bits(self_p,
+                                        remainder,
+                                        (int)quotient + 1 + parameter);
+    } else {
+        bitstream_writer_write_repeated_bit(self_p, 0, (int)quotient);
+        bitstream_writer_write_u64_bits(self_p, remainder, parameter + 1);
+    }
+}
+
+void bitstream_writer_write_unary(struct bitstream_writer_t *self_p,
+                                  uint32_t value)
+{
+    bitstream_writer_write_rice(self_p, value, 0);
+}
+
+void bitstream_writer_write_gamma(struct bitstream_writer_t *self_p,
+                                  uint32_t value)
+{
+    writer_write_exp_golomb(self_p, value);
+}
+
+/* The gamma code of the value length followed by the value without
+   its leading one, at most 42 bits. */
+void bitstream_writer_write_delta(struct bitstream_writer_t *self_p,
+                                  uint32_t value)
+{
+    int length;
+    int length_bits;
+
+    length = (64 - __builtin_clzll(value));
+    length_bits = (64 - __builtin_clzll((uint64_t)length));
+    bitstream_writer_write_u64_bits(
+        self_p,
+        ((uint64_t)length << (length - 1)) | (value ^ (1ull << (length - 1))),
+        2 * length_bits + length - 2);
+}
+
+/* Spread the low 56 bits of given value to seven bits groups, the
+   least significant group in the least significant byte. */
+static uint64_t varint_spread(uint64_t value)
+{
+    value &= 0x00ffffffffffffffull;
+    value = (((value & 0x00fffffff0000000ull) << 4)
+             | (value & 0x000000000fffffffull));
+    value = (((value & 0x0fffc0000fffc000ull) << 2)
+             | (value & 0x00003fff00003fffull));
+    value = (((value & 0x3f803f803f803f80ull) << 1)
+             | (value & 0x007f007f007f007full));
+
+    return (value);
+}
+
+static int varint_size(uint64_t value)
+{
+    return ((70 - __builtin_clzll(value | 1)) / 7);
+}
+
+/* Given varint of at most eight bytes, first byte most significant. */
+static uint64_t varint_bytes(uint64_t value, int number_of_bytes)
+{
+    uint64_t bytes;
+
+    bytes = (varint_spread(value)
+             | (0x8080808080808080ull
+                & ((1ull << (8 * number_of_bytes - 8)) - 1)));
+
+    return (__builtin_bswap64(bytes) >> (64 - 8 * number_of_bytes));
+}
+
+static uint64_t zigzag_encode(int64_t value)
+{
+    return (((uint64_t)value << 1) ^ -((uint64_t)value >> 63));
+}
+
+static int64_t zigzag_decode(uint64_t value)
+{
+    return ((int64_t)((value >> 1) ^ -(value & 1)));
+}
+
+/* Varints longer than eight bytes are written as eight bytes with
+   the low 56 bits followed by the rest. */
+void bitstream_writer_write_varint(struct bitstream_writer_t *self_p,
+                                   uint64_t value)
+{
+    int number_of_bytes;
+
+    if (value >= (1ull << 56)) {
+        bitstream_writer_write_u64(
+            self_p,
+            __builtin_bswap64(varint_spread(value) | 0x8080808080808080ull));
+        value >>= 56;
+    }
+
+    number_of_bytes = varint_size(value);
+    bitstream_writer_write_u64_bits(self_p,
+                                    varint_bytes(value, number_of_bytes),
+                                    8 * number_of_bytes);
+}
+
+void bitstream_writer_write_signed_varint(struct bitstream_writer_t *self_p,
+                                          int64_t value)
+{
+    bitstream_writer_write_varint(self_p, zigzag_encode(value));
+}
+
 void bitstream_writer_insert_bit(struct bitstream_writer_t *self_p,
                                  int value)
 {
@@ -341,6 +689,101 @@ void bitstream_writer_seek(struct bitstream_writer_t *self_p,
     self_p->bit_offset = (offset % 8);
 }
 
+/* Clear bits after the write position in the current byte, as writes
+   in the middle of a byte only sets bits. */
+static void writer_clear_tail(struct bitstream_writer_t *self_p)
+{
+    if (self_p->bit_offset != 0) {
+        self_p->buf_p[self_p->byte_offset] &= ~(0xff >> self_p->bit_offset);
+    }
+}
+
+/* The stream is moved as whole bytes starting at the byte containing
+   given bit offset, and the bits before the offset in that byte are
+   put back afterwards. */
+void bitstream_writer_insert_zero_bits(struct bitstream_writer_t *self_p,
+                                       int bit_offset,
+                                       int number_of_bits)
+{
+    int size;
+    int byte_offset;
+    int head_bits;
+    int length;
+    int bytes;
+    int shift;
+    uint8_t head;
+    uint8_t *src_p;
+    uint8_t *dst_p;
+
+    size = bitstream_writer_size_in_bits(self_p);
+    byte_offset = (bit_offset / 8);
+    head_bits = (bit_offset % 8);
+    length = ((size + 7) / 8 - byte_offset);
+    bytes = (number_of_bits / 8);
+    shift = (number_of_bits % 8);
+    src_p = &self_p->buf_p[byte_offset];
+    dst_p = &src_p[bytes];
+    head = (uint8_t)(src_p[0] & ~(0xff >> head_bits));
+
+    if (length > 0) {
+        if (shift == 0) {
+            memmove(dst_p, src_p, (size_t)length);
+        } else {
+            dst_p[length] = (uint8_t)(src_p[length - 1] << (8 - shift));
+            shift_bytes_left_backward(&dst_p[1], src_p, length - 1, 8 - shift);
+            dst_p[0] = (src_p[0] >> shift);
+        }
+    }
+
+    src_p[0] = (uint8_t)((src_p[0] & (0xff >> head_bits)) | head);
+    clear_bits(self_p->buf_p, bit_offset, number_of_bits);
+    bitstream_writer_seek(self_p, number_of_bits);
+    writer_clear_tail(self_p);
+}
+
+void bitstream_writer_delete_bits(struct bitstream_writer_t *self_p,
+                                  int bit_offset,
+                                  int number_of_bits)
+{
+    int size;
+    int byte_offset;
+    int head_bits;
+    int length;
+    int shift;
+    uint8_t head;
+    uint8_t *src_p;
+    uint8_t *dst_p;
+    uint8_t *end_p;
+
+    size = (bitstream_writer_size_in_bits(self_p) - number_of_bits);
+    byte_offset = (bit_offset / 8);
+    head_bits = (bit_offset % 8);
+    length = ((size + 7) / 8 - byte_offset);
+    shift = (number_of_bits % 8);
+    dst_p = &self_p->buf_p[byte_offset];
+    src_p = &dst_p[number_of_bits / 8];
+    end_p = &self_p->buf_p[bitstream_writer_size_in_bytes(self_p)];
+    head = (uint8_t)(dst_p[0] & ~(0xff >> head_bits));
+
+    if (length > 0) {
+        if (shift == 0) {
+            memmove(dst_p, src_p, (size_t)length);
+        } else {
+            shift_bytes_left(dst_p, src_p, length - 1, shift);
+            dst_p[length - 1] = (uint8_t)(src_p[length - 1] << shift);
+
+            if (&src_p[length] < end_p) {
+                dst_p[length - 1] |= (src_p[length] >> (8 - shift));
+            }
+        }
+    }
+
+    dst_p[0] = (uint8_t)((dst_p[0] & (0xff >> head_bits)) | head);
+    self_p->byte_offset = (size / 8);
+    self_p->bit_offset = (size % 8);
+    writer_clear_tail(self_p);
+}
+
 void bitstream_writer_bounds_save(struct bitstream_writer_bounds_t *self_p,
                                   struct bitstream_writer_t *writer_p,
                                   int bit_offset,
@@ -386,215 +829,3113 @@ void bitstream_writer_bounds_restore(struct bitstream_writer_bounds_t *self_p)
     }
 }
 
-void bitstream_reader_init(struct bitstream_reader_t *self_p,
-                           const uint8_t *buf_p)
+/* Number of bytes from given offset to the end of the buffer, or zero
+   if the offset is past the end. */
+static size_t bytes_left(size_t size, size_t offset)
 {
-    self_p->buf_p = buf_p;
-    self_p->byte_offset = 0;
-    self_p->bit_offset = 0;
+    if (offset >= size) {
+        return (0);
+    }
+
+    return (size - offset);
 }
 
-int bitstream_reader_read_bit(struct bitstream_reader_t *self_p)
+/* Hand all whole bytes in the window to the sink and start over at
+   the beginning of the window. Returns zero if not writing to a
+   stream. */
+static int fast_writer_drain(struct bitstream_fast_writer_t *self_p)
 {
-    int value;
+    size_t size;
 
-    if (self_p->bit_offset == 0) {
-        value = (self_p->buf_p[self_p->byte_offset] >> 7);
-        self_p->bit_offset = 1;
-    } else {
-        value = ((self_p->buf_p[self_p->byte_offset] >> (7 - self_p->bit_offset)) & 0x1);
+    if (self_p->sink == NULL) {
+        return (0);
+    }
 
-        if (self_p->bit_offset == 7) {
-            self_p->bit_offset = 0;
-            self_p->byte_offset++;
-        } else {
-            self_p->bit_offset++;
+    size = self_p->byte_offset;
+
+    if (size > self_p->size) {
+        size = self_p->size;
+    }
+
+    if (size > 0) {
+        if (self_p->sink(self_p->arg_p, self_p->buf_p, size) != 0) {
+            self_p->overflow = 1;
         }
     }
 
-    return (value);
+    self_p->buf_offset += self_p->byte_offset;
+    self_p->byte_offset = 0;
+
+    return (1);
 }
 
-void bitstream_reader_read_bytes(struct bitstream_reader_t *self_p,
-                                 uint8_t *buf_p,
-                                 int length)
+/* Store given number of bytes from the register, but only those that
+   fits in the buffer. Sets the overflow flag if any byte did not
+   fit. */
+static void fast_writer_store_tail(struct bitstream_fast_writer_t *self_p,
+                                   int bytes)
 {
     int i;
-    const uint8_t *src_p;
+    size_t left;
+    uint64_t value;
 
-    src_p = &self_p->buf_p[self_p->byte_offset];
+    left = bytes_left(self_p->size, self_p->byte_offset);
 
-    if (self_p->bit_offset == 0) {
-        memcpy(buf_p, src_p, sizeof(uint8_t) * length);
+    if ((left < (size_t)bytes) && fast_writer_drain(self_p)) {
+        left = bytes_left(self_p->size, self_p->byte_offset);
+    }
+
+    if (left < (size_t)bytes) {
+        self_p->overflow = 1;
+        bytes = (int)left;
+    }
+
+    value = self_p->value;
+
+    for (i = 0; i < bytes; i++) {
+        self_p->buf_p[self_p->byte_offset + i] = (uint8_t)(value >> 56);
+        value <<= 8;
+    }
+}
+
+/* At most 64 bits. */
+static void fast_writer_write(struct bitstream_fast_writer_t *self_p,
+                              uint64_t value,
+                              int number_of_bits)
+{
+    int free_bits;
+    int rest;
+
+    free_bits = (64 - self_p->number_of_bits);
+
+    if (number_of_bits < free_bits) {
+        self_p->value |= (value << (free_bits - number_of_bits));
+        self_p->number_of_bits += number_of_bits;
+    } else {
+        rest = (number_of_bits - free_bits);
+        self_p->value |= (value >> rest);
+
+        if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+            store_u64_be(&self_p->buf_p[self_p->byte_offset], self_p->value);
+        } else {
+            fast_writer_store_tail(self_p, 8);
+        }
+
+        self_p->byte_offset += 8;
+        self_p->value = ((value << 1) << (63 - rest));
+        self_p->number_of_bits = rest;
+    }
+}
+
+/* Store all buffered whole bytes and keep the partial byte, if
+   any. */
+static void fast_writer_store_bytes(struct bitstream_fast_writer_t *self_p)
+{
+    int bytes;
+
+    fast_writer_store_tail(self_p, (self_p->number_of_bits + 7) / 8);
+    bytes = (self_p->number_of_bits / 8);
+    self_p->byte_offset += bytes;
+    self_p->value <<= (8 * bytes);
+    self_p->number_of_bits -= (8 * bytes);
+}
+
+void bitstream_fast_writer_init(struct bitstream_fast_writer_t *self_p,
+                                uint8_t *buf_p,
+                                size_t size)
+{
+    self_p->buf_p = buf_p;
+    self_p->size = size;
+    self_p->byte_offset = 0;
+    self_p->value = 0;
+    self_p->number_of_bits = 0;
+    self_p->overflow = 0;
+    self_p->sink = NULL;
+    self_p->arg_p = NULL;
+    self_p->buf_offset = 0;
+    self_p->segments_p = NULL;
+    self_p->max_number_of_segments = 0;
+    self_p->number_of_segments = 0;
+    self_p->segment_offset = 0;
+}
+
+void bitstream_fast_writer_init_segments(struct bitstream_fast_writer_t *self_p,
+                                         uint8_t *buf_p,
+                                         size_t size,
+                                         struct iovec *segments_p,
+                                         int max_number_of_segments)
+{
+    bitstream_fast_writer_init(self_p, buf_p, size);
+    self_p->segments_p = segments_p;
+    self_p->max_number_of_segments = max_number_of_segments;
+}
+
+void bitstream_fast_writer_init_stream(struct bitstream_fast_writer_t *self_p,
+                                       uint8_t *buf_p,
+                                       size_t size,
+                                       bitstream_fast_writer_sink_t sink,
+                                       void *arg_p)
+{
+    bitstream_fast_writer_init(self_p, buf_p, size);
+    self_p->sink = sink;
+    self_p->arg_p = arg_p;
+}
+
+int bitstream_fast_writer_sink_fd(void *arg_p, const uint8_t *buf_p, size_t size)
+{
+    ssize_t res;
+
+    while (size > 0) {
+        res = write(*(int *)arg_p, buf_p, size);
+
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return (-errno);
+        }
+
+        buf_p += res;
+        size -= (size_t)res;
+    }
+
+    return (0);
+}
+
+int bitstream_fast_writer_sink_file(void *arg_p,
+                                    const uint8_t *buf_p,
+                                    size_t size)
+{
+    if (fwrite(buf_p, sizeof(uint8_t), size, arg_p) != size) {
+        return (-EIO);
+    }
+
+    return (0);
+}
+
+uint64_t bitstream_fast_writer_size_in_bits(
+    struct bitstream_fast_writer_t *self_p)
+{
+    return ((8 * (self_p->buf_offset + self_p->byte_offset))
+            + self_p->number_of_bits);
+}
+
+size_t bitstream_fast_writer_size_in_bytes(
+    struct bitstream_fast_writer_t *self_p)
+{
+    return (self_p->buf_offset
+            + self_p->byte_offset
+            + (self_p->number_of_bits + 7) / 8);
+}
+
+void bitstream_fast_writer_write_bytes(struct bitstream_fast_writer_t *self_p,
+                                       const uint8_t *buf_p,
+                                       int length)
+{
+    int i;
+    size_t left;
+
+    if ((self_p->number_of_bits % 8) == 0) {
+        fast_writer_store_bytes(self_p);
+
+        while (length > 0) {
+            left = bytes_left(self_p->size, self_p->byte_offset);
+
+            if (left == 0) {
+                if (fast_writer_drain(self_p)) {
+                    continue;
+                }
+
+                self_p->overflow = 1;
+                self_p->byte_offset += length;
+                break;
+            }
+
+            if (left > (size_t)length) {
+                left = (size_t)length;
+            }
+
+            memcpy(&self_p->buf_p[self_p->byte_offset],
+                   buf_p,
+                   sizeof(uint8_t) * left);
+            self_p->byte_offset += left;
+            buf_p += left;
+            length -= (int)left;
+        }
+    } else {
+        while (length >= 8) {
+            fast_writer_write(self_p, load_u64_be(buf_p), 64);
+            buf_p += 8;
+            length -= 8;
+        }
+
+        for (i = 0; i < length; i++) {
+            fast_writer_write(self_p, buf_p[i], 8);
+        }
+    }
+}
+
+/* In chunks, as the byte writer takes an int length. */
+void bitstream_fast_writer_append(struct bitstream_fast_writer_t *self_p,
+                                  struct bitstream_fast_writer_t *other_p)
+{
+    const uint8_t *buf_p;
+    uint64_t number_of_bits;
+    size_t size;
+    int length;
+    int rest;
+
+    bitstream_fast_writer_flush(other_p);
+    buf_p = other_p->buf_p;
+    number_of_bits = bitstream_fast_writer_size_in_bits(other_p);
+    size = (size_t)(number_of_bits / 8);
+
+    while (size > 0) {
+        length = (size > (1 << 30) ? (1 << 30) : (int)size);
+        bitstream_fast_writer_write_bytes(self_p, buf_p, length);
+        buf_p += length;
+        size -= (size_t)length;
+    }
+
+    rest = (int)(number_of_bits % 8);
+
+    if (rest != 0) {
+        bitstream_fast_writer_write_u64_bits(self_p, *buf_p >> (8 - rest), rest);
+    }
+}
+
+void bitstream_fast_writer_write_u64_bits_store(
+    struct bitstream_fast_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits)
+{
+    if (number_of_bits == 0) {
+        return;
+    }
+
+    fast_writer_write(self_p, value, number_of_bits);
+}
+
+/* Add bytes written to the buffer since the last segment as a
+   segment. */
+static void fast_writer_add_buf_segment(struct bitstream_fast_writer_t *self_p,
+                                        size_t end)
+{
+    if (end > self_p->segment_offset) {
+        self_p->segments_p[self_p->number_of_segments].iov_base =
+            &self_p->buf_p[self_p->segment_offset];
+        self_p->segments_p[self_p->number_of_segments].iov_len =
+            (end - self_p->segment_offset);
+        self_p->number_of_segments++;
+    }
+
+    self_p->segment_offset = end;
+}
+
+void bitstream_fast_writer_write_bytes_reference(
+    struct bitstream_fast_writer_t *self_p,
+    const uint8_t *buf_p,
+    int length)
+{
+    /* Two segments are added now and at most one by finish. */
+    if (((self_p->number_of_bits % 8) != 0)
+        || (self_p->number_of_segments + 3 > self_p->max_number_of_segments)) {
+        bitstream_fast_writer_write_bytes(self_p, buf_p, length);
+
+        return;
+    }
+
+    fast_writer_store_bytes(self_p);
+    fast_writer_add_buf_segment(self_p, self_p->byte_offset);
+    self_p->segments_p[self_p->number_of_segments].iov_base = (void *)buf_p;
+    self_p->segments_p[self_p->number_of_segments].iov_len = (size_t)length;
+    self_p->number_of_segments++;
+    self_p->buf_offset += (uint64_t)length;
+}
+
+void bitstream_fast_writer_write_varint(struct bitstream_fast_writer_t *self_p,
+                                        uint64_t value)
+{
+    int number_of_bytes;
+
+    if (value >= (1ull << 56)) {
+        bitstream_fast_writer_write_u64(
+            self_p,
+            __builtin_bswap64(varint_spread(value) | 0x8080808080808080ull));
+        value >>= 56;
+    }
+
+    number_of_bytes = varint_size(value);
+    bitstream_fast_writer_write_u64_bits(self_p,
+                                         varint_bytes(value, number_of_bytes),
+                                         8 * number_of_bytes);
+}
+
+void bitstream_fast_writer_write_signed_varint(
+    struct bitstream_fast_writer_t *self_p,
+    int64_t value)
+{
+    bitstream_fast_writer_write_varint(self_p, zigzag_encode(value));
+}
+
+int bitstream_fast_writer_finish_segments(
+    struct bitstream_fast_writer_t *self_p)
+{
+    size_t end;
+
+    bitstream_fast_writer_flush(self_p);
+    end = (self_p->byte_offset + (self_p->number_of_bits + 7) / 8);
+
+    if (end > self_p->size) {
+        end = self_p->size;
+    }
+
+    fast_writer_add_buf_segment(self_p, end);
+
+    return (self_p->number_of_segments);
+}
+
+void bitstream_fast_writer_flush(struct bitstream_fast_writer_t *self_p)
+{
+    if (self_p->sink == NULL) {
+        fast_writer_store_tail(self_p, (self_p->number_of_bits + 7) / 8);
+    } else {
+        fast_writer_store_bytes(self_p);
+        fast_writer_drain(self_p);
+    }
+}
+
+void bitstream_fast_writer_seek(struct bitstream_fast_writer_t *self_p,
+                                int64_t offset)
+{
+    uint64_t position;
+
+    /* Store the register without handing the block to the sink, as
+       only bytes in the block can be written again. The block is only
+       drained if the register does not fit in it. Bytes before the
+       segment offset are already in a segment. */
+    position = (bitstream_fast_writer_size_in_bits(self_p) + (uint64_t)offset);
+    fast_writer_store_bytes(self_p);
+
+    if ((position / 8) < (self_p->buf_offset + self_p->segment_offset)) {
+        self_p->overflow = 1;
+
+        return;
+    }
+
+    self_p->byte_offset = (size_t)(position / 8 - self_p->buf_offset);
+    self_p->number_of_bits = (int)(position % 8);
+
+    if ((self_p->number_of_bits == 0)
+        || (self_p->byte_offset >= self_p->size)) {
+        self_p->value = 0;
+    } else {
+        self_p->value = (self_p->buf_p[self_p->byte_offset]
+                         & (0xff00 >> self_p->number_of_bits));
+        self_p->value <<= 56;
+    }
+}
+
+int bitstream_fast_writer_overflow(struct bitstream_fast_writer_t *self_p)
+{
+    return (self_p->overflow);
+}
+
+void bitstream_reader_init(struct bitstream_reader_t *self_p,
+                           const uint8_t *buf_p)
+{
+    self_p->buf_p = buf_p;
+    self_p->byte_offset = 0;
+    self_p->bit_offset = 0;
+}
+
+void bitstream_reader_read_bytes(struct bitstream_reader_t *self_p,
+                                 uint8_t *buf_p,
+                                 int length)
+{
+    const uint8_t *src_p;
+
+    src_p = &self_p->buf_p[self_p->byte_offset];
+
+    if (self_p->bit_offset == 0) {
+        memcpy(buf_p, src_p, sizeof(uint8_t) * length);
+    } else if (length > 0) {
+        shift_bytes_left(buf_p, src_p, length, self_p->bit_offset);
+    }
+
+    self_p->byte_offset += length;
+}
+
+void bitstream_reader_seek(struct bitstream_reader_t *self_p,
+                           int offset)
+{
+    offset += ((8 * self_p->byte_offset) + self_p->bit_offset);
+    self_p->byte_offset = (offset / 8);
+    self_p->bit_offset = (offset % 8);
+}
+
+void bitstream_reader_seek_to(struct bitstream_reader_t *self_p,
+                              int bit_offset)
+{
+    self_p->byte_offset = (bit_offset / 8);
+    self_p->bit_offset = (bit_offset % 8);
+}
+
+int bitstream_reader_tell(struct bitstream_reader_t *self_p)
+{
+    return ((8 * self_p->byte_offset) + self_p->bit_offset);
+}
+
+/* Read zeros and the terminating one. Returns the number of
+   zeros. */
+static int reader_read_unary(struct bitstream_reader_t *self_p)
+{
+    const uint8_t *buf_p;
+    int byte;
+    int zeros;
+    int offset;
+
+    buf_p = &self_p->buf_p[self_p->byte_offset];
+    byte = (buf_p[0] & (0xff >> self_p->bit_offset));
+    zeros = -self_p->bit_offset;
+    offset = 0;
+
+    while (byte == 0) {
+        zeros += 8;
+        offset++;
+        byte = buf_p[offset];
+    }
+
+    /* Position of the one in its byte. */
+    byte = (__builtin_clz((unsigned int)byte) - 24);
+    zeros += byte;
+    self_p->byte_offset += (offset + ((byte + 1) >> 3));
+    self_p->bit_offset = ((byte + 1) & 7);
+
+    return (zeros);
+}
+
+static uint64_t reader_read_exp_golomb(struct bitstream_reader_t *self_p)
+{
+    int zeros;
+
+    zeros = reader_read_unary(self_p);
+
+    return ((((uint64_t)1 << zeros)
+             | bitstream_reader_read_u64_bits(self_p, zeros)) - 1);
+}
+
+uint32_t bitstream_reader_read_ue(struct bitstream_reader_t *self_p)
+{
+    return ((uint32_t)reader_read_exp_golomb(self_p));
+}
+
+int32_t bitstream_reader_read_se(struct bitstream_reader_t *self_p)
+{
+    return (exp_golomb_signed(reader_read_exp_golomb(self_p)));
+}
+
+uint32_t bitstream_reader_read_rice(struct bitstream_reader_t *self_p,
+                                    int parameter)
+{
+    uint32_t quotient;
+
+    quotient = (uint32_t)reader_read_unary(self_p);
+
+    return ((quotient << parameter)
+            | (uint32_t)bitstream_reader_read_u64_bits(self_p, parameter));
+}
+
+void bitstream_reader_read_ue_array(struct bitstream_reader_t *self_p,
+                                    uint32_t *values_p,
+                                    int length)
+{
+    int i;
+
+    for (i = 0; i < length; i++) {
+        values_p[i] = (uint32_t)reader_read_exp_golomb(self_p);
+    }
+}
+
+void bitstream_reader_read_se_array(struct bitstream_reader_t *self_p,
+                                    int32_t *values_p,
+                                    int length)
+{
+    int i;
+
+    for (i = 0; i < length; i++) {
+        values_p[i] = exp_golomb_signed(reader_read_exp_golomb(self_p));
+    }
+}
+
+void bitstream_reader_read_rice_array(struct bitstream_reader_t *self_p,
+                                      uint32_t *values_p,
+                                      int length,
+                                      int parameter)
+{
+    int i;
+
+    for (i = 0; i < length; i++) {
+        values_p[i] = bitstream_reader_read_rice(self_p, parameter);
+    }
+}
+
+uint32_t bitstream_reader_read_unary(struct bitstream_reader_t *self_p)
+{
+    return ((uint32_t)reader_read_unary(self_p));
+}
+
+uint32_t bitstream_reader_read_gamma(struct bitstream_reader_t *self_p)
+{
+    return ((uint32_t)(reader_read_exp_golomb(self_p) + 1));
+}
+
+uint32_t bitstream_reader_read_delta(struct bitstream_reader_t *self_p)
+{
+    int length;
+
+    length = (int)(reader_read_exp_golomb(self_p) + 1);
+
+    return ((uint32_t)((1ull << (length - 1))
+                       | bitstream_reader_read_u64_bits(self_p, length - 1)));
+}
+
+uint64_t bitstream_reader_read_varint(struct bitstream_reader_t *self_p)
+{
+    uint64_t value;
+    uint8_t byte;
+    int shift;
+
+    value = 0;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        byte = bitstream_reader_read_u8(self_p);
+        value |= ((uint64_t)(byte & 0x7f) << shift);
+
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+
+    return (value);
+}
+
+int64_t bitstream_reader_read_signed_varint(struct bitstream_reader_t *self_p)
+{
+    return (zigzag_decode(bitstream_reader_read_varint(self_p)));
+}
+
+/* Load as many whole bytes as fits into the register. Bits of a
+   partially loaded byte are already in place and are loaded again by
+   the next refill, which is harmless as they are or:ed. */
+static void fast_reader_refill(struct bitstream_fast_reader_t *self_p)
+{
+    int bytes;
+
+    bytes = ((63 - self_p->number_of_bits) / 8);
+    self_p->value |= (load_u64_be(&self_p->buf_p[self_p->byte_offset])
+                      >> self_p->number_of_bits);
+    self_p->byte_offset += bytes;
+    self_p->number_of_bits += (8 * bytes);
+}
+
+/* Discard bytes before the read position from the window and fill
+   it with bytes from the stream. Returns non-zero if at least one
+   byte is available after the read position. */
+static int fast_reader_fill_stream(struct bitstream_fast_reader_t *self_p)
+{
+    size_t discard;
+    ssize_t size;
+
+    discard = self_p->byte_offset;
+
+    if (discard > self_p->size) {
+        discard = self_p->size;
+    }
+
+    memmove(&self_p->window_p[0],
+            &self_p->window_p[discard],
+            self_p->size - discard);
+    self_p->buf_offset += discard;
+    self_p->byte_offset -= discard;
+    self_p->size -= discard;
+
+    while (bytes_left(self_p->size, self_p->byte_offset) < 8) {
+        size = self_p->refill(self_p->arg_p,
+                              &self_p->window_p[self_p->size],
+                              self_p->window_size - self_p->size);
+
+        if (size <= 0) {
+            self_p->refill = NULL;
+            break;
+        }
+
+        self_p->size += (size_t)size;
+
+        /* Drop bytes skipped by seek. */
+        if (self_p->byte_offset >= self_p->size) {
+            self_p->buf_offset += self_p->size;
+            self_p->byte_offset -= self_p->size;
+            self_p->size = 0;
+        }
+    }
+
+    return (bytes_left(self_p->size, self_p->byte_offset) > 0);
+}
+
+/* Move to the next segment when the current one is consumed. Fields
+   straddling segments are read from the bridge buffer, which holds
+   the last bytes of the current segment followed by the first bytes
+   of the next segments. Returns non-zero if at least one byte is
+   available after the read position. */
+static int fast_reader_fill_segments(struct bitstream_fast_reader_t *self_p)
+{
+    size_t left;
+    size_t size;
+    const struct iovec *segment_p;
+
+    while (1) {
+        if (self_p->bridge_head > 0) {
+            if (self_p->byte_offset < self_p->bridge_head) {
+                break;
+            }
+
+            /* All bytes of the previous segment are consumed, continue
+               in the first segment copied to the bridge. */
+            self_p->buf_offset += self_p->bridge_head;
+            self_p->byte_offset -= self_p->bridge_head;
+            self_p->buf_p = self_p->segments_p->iov_base;
+            self_p->size = self_p->segments_p->iov_len;
+            self_p->segments_p++;
+            self_p->number_of_segments--;
+            self_p->bridge_head = 0;
+        }
+
+        left = bytes_left(self_p->size, self_p->byte_offset);
+
+        if ((left >= 8) || (self_p->number_of_segments == 0)) {
+            break;
+        }
+
+        if (left == 0) {
+            self_p->buf_offset += self_p->size;
+            self_p->byte_offset -= self_p->size;
+            self_p->buf_p = self_p->segments_p->iov_base;
+            self_p->size = self_p->segments_p->iov_len;
+            self_p->segments_p++;
+            self_p->number_of_segments--;
+        } else {
+            memcpy(&self_p->bridge[0],
+                   &self_p->buf_p[self_p->byte_offset],
+                   left);
+            self_p->buf_offset += self_p->byte_offset;
+            self_p->byte_offset = 0;
+            self_p->buf_p = &self_p->bridge[0];
+            self_p->size = left;
+            self_p->bridge_head = left;
+            segment_p = self_p->segments_p;
+
+            while ((self_p->size < sizeof(self_p->bridge))
+                   && (segment_p < (self_p->segments_p
+                                    + self_p->number_of_segments))) {
+                size = (sizeof(self_p->bridge) - self_p->size);
+
+                if (size > segment_p->iov_len) {
+                    size = segment_p->iov_len;
+                }
+
+                memcpy(&self_p->bridge[self_p->size], segment_p->iov_base, size);
+                self_p->size += size;
+                segment_p++;
+            }
+        }
+    }
+
+    return (bytes_left(self_p->size, self_p->byte_offset) > 0);
+}
+
+static int fast_reader_fill(struct bitstream_fast_reader_t *self_p)
+{
+    if (self_p->refill != NULL) {
+        return (fast_reader_fill_stream(self_p));
+    } else if (self_p->number_of_segments > 0) {
+        return (fast_reader_fill_segments(self_p));
+    } else {
+        return (0);
+    }
+}
+
+/* Fewer than eight bytes left in the buffer. Only whole bytes in the
+   buffer are loaded. Missing bits are read as zeros and sets the
+   overflow flag. */
+static void fast_reader_refill_tail(struct bitstream_fast_reader_t *self_p,
+                                    int number_of_bits)
+{
+    uint64_t word;
+    int i;
+    int bytes;
+    size_t left;
+
+    if (fast_reader_fill(self_p)
+        && (bytes_left(self_p->size, self_p->byte_offset) >= 8)) {
+        fast_reader_refill(self_p);
+
+        return;
+    }
+
+    left = bytes_left(self_p->size, self_p->byte_offset);
+    bytes = ((63 - self_p->number_of_bits) / 8);
+
+    if ((size_t)bytes > left) {
+        bytes = (int)left;
+    }
+
+    word = 0;
+
+    for (i = 0; i < bytes; i++) {
+        word |= ((uint64_t)self_p->buf_p[self_p->byte_offset + i]
+                 << (56 - 8 * i));
+    }
+
+    self_p->value |= (word >> self_p->number_of_bits);
+    self_p->byte_offset += bytes;
+    self_p->number_of_bits += (8 * bytes);
+
+    if (self_p->number_of_bits < number_of_bits) {
+        self_p->overflow = 1;
+        bytes = ((number_of_bits - self_p->number_of_bits + 7) / 8);
+        self_p->byte_offset += bytes;
+        self_p->number_of_bits += (8 * bytes);
+    }
+}
+
+/* At most 56 bits, which is always available after a refill. */
+static uint64_t fast_reader_read(struct bitstream_fast_reader_t *self_p,
+                                 int number_of_bits)
+{
+    uint64_t value;
+
+    if (self_p->number_of_bits < number_of_bits) {
+        if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+            fast_reader_refill(self_p);
+        } else {
+            fast_reader_refill_tail(self_p, number_of_bits);
+        }
+    }
+
+    value = (self_p->value >> (64 - number_of_bits));
+    self_p->value <<= number_of_bits;
+    self_p->number_of_bits -= number_of_bits;
+
+    return (value);
+}
+
+void bitstream_fast_reader_init(struct bitstream_fast_reader_t *self_p,
+                                const uint8_t *buf_p,
+                                size_t size)
+{
+    self_p->buf_p = buf_p;
+    self_p->size = size;
+    self_p->byte_offset = 0;
+    self_p->value = 0;
+    self_p->number_of_bits = 0;
+    self_p->overflow = 0;
+    self_p->refill = NULL;
+    self_p->arg_p = NULL;
+    self_p->window_p = NULL;
+    self_p->window_size = 0;
+    self_p->buf_offset = 0;
+    self_p->segments_p = NULL;
+    self_p->number_of_segments = 0;
+    self_p->bridge_head = 0;
+}
+
+void bitstream_fast_reader_init_stream(struct bitstream_fast_reader_t *self_p,
+                                       uint8_t *buf_p,
+                                       size_t size,
+                                       bitstream_fast_reader_refill_t refill,
+                                       void *arg_p)
+{
+    bitstream_fast_reader_init(self_p, buf_p, 0);
+    self_p->refill = refill;
+    self_p->arg_p = arg_p;
+    self_p->window_p = buf_p;
+    self_p->window_size = size;
+}
+
+void bitstream_fast_reader_init_segments(
+    struct bitstream_fast_reader_t *self_p,
+    const struct iovec *segments_p,
+    int number_of_segments)
+{
+    bitstream_fast_reader_init(self_p, NULL, 0);
+
+    if (number_of_segments > 0) {
+        self_p->buf_p = segments_p[0].iov_base;
+        self_p->size = segments_p[0].iov_len;
+        self_p->segments_p = &segments_p[1];
+        self_p->number_of_segments = (number_of_segments - 1);
+    }
+}
+
+ssize_t bitstream_fast_reader_refill_fd(void *arg_p, uint8_t *buf_p, size_t size)
+{
+    ssize_t res;
+
+    do {
+        res = read(*(int *)arg_p, buf_p, size);
+    } while ((res < 0) && (errno == EINTR));
+
+    return (res);
+}
+
+void bitstream_fast_reader_read_bytes(struct bitstream_fast_reader_t *self_p,
+                                      uint8_t *buf_p,
+                                      int length)
+{
+    int i;
+    size_t left;
+    uint64_t value;
+
+    if ((self_p->number_of_bits % 8) == 0) {
+        /* Byte aligned. Take whole bytes from the register, then copy
+           directly from the buffer. */
+        while ((self_p->number_of_bits > 0) && (length > 0)) {
+            *buf_p++ = (uint8_t)fast_reader_read(self_p, 8);
+            length--;
+        }
+
+        /* Partially loaded bytes are copied below. */
+        if (self_p->number_of_bits == 0) {
+            self_p->value = 0;
+        }
+
+        while (length > 0) {
+            left = bytes_left(self_p->size, self_p->byte_offset);
+
+            if (left == 0) {
+                if (fast_reader_fill(self_p)) {
+                    continue;
+                }
+
+                memset(buf_p, 0, sizeof(uint8_t) * length);
+                self_p->byte_offset += length;
+                self_p->overflow = 1;
+                break;
+            }
+
+            if (left > (size_t)length) {
+                left = (size_t)length;
+            }
+
+            memcpy(buf_p,
+                   &self_p->buf_p[self_p->byte_offset],
+                   sizeof(uint8_t) * left);
+            self_p->byte_offset += left;
+            buf_p += left;
+            length -= (int)left;
+        }
+    } else {
+        /* Seven bytes per refill. */
+        while (length >= 7) {
+            value = fast_reader_read(self_p, 56);
+
+            for (i = 6; i >= 0; i--) {
+                buf_p[i] = (uint8_t)value;
+                value >>= 8;
+            }
+
+            buf_p += 7;
+            length -= 7;
+        }
+
+        for (i = 0; i < length; i++) {
+            buf_p[i] = (uint8_t)fast_reader_read(self_p, 8);
+        }
+    }
+}
+
+uint64_t bitstream_fast_reader_read_u64_bits_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits)
+{
+    uint64_t value;
+
+    if (number_of_bits == 0) {
+        return (0);
+    }
+
+    if (number_of_bits > 56) {
+        value = (fast_reader_read(self_p, number_of_bits - 32) << 32);
+        value |= fast_reader_read(self_p, 32);
+    } else {
+        value = fast_reader_read(self_p, number_of_bits);
+    }
+
+    return (value);
+}
+
+uint64_t bitstream_fast_reader_peek_u64_bits_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits)
+{
+    if (number_of_bits == 0) {
+        return (0);
+    }
+
+    /* Bits past the end of the stream are zero in the register. Do not
+       set the overflow flag, as they may never be used. */
+    if (self_p->number_of_bits < number_of_bits) {
+        if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+            fast_reader_refill(self_p);
+        } else {
+            fast_reader_refill_tail(self_p, 0);
+        }
+    }
+
+    return (self_p->value >> (64 - number_of_bits));
+}
+
+void bitstream_fast_reader_skip_bits_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int number_of_bits)
+{
+    while (number_of_bits > 56) {
+        fast_reader_read(self_p, 56);
+        number_of_bits -= 56;
+    }
+
+    if (number_of_bits > 0) {
+        fast_reader_read(self_p, number_of_bits);
+    }
+}
+
+/* Read zeros and the terminating one. Returns the number of zeros.
+   Sets the overflow flag if the stream ends before the one. */
+static uint32_t fast_reader_read_unary(struct bitstream_fast_reader_t *self_p)
+{
+    uint32_t zeros;
+    int count;
+
+    zeros = 0;
+
+    while (1) {
+        if (self_p->number_of_bits < 57) {
+            if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+                fast_reader_refill(self_p);
+            } else {
+                fast_reader_refill_tail(self_p, 0);
+            }
+        }
+
+        if (self_p->number_of_bits == 0) {
+            self_p->overflow = 1;
+
+            return (zeros);
+        }
+
+        if (self_p->value != 0) {
+            count = __builtin_clzll(self_p->value);
+
+            if (count < self_p->number_of_bits) {
+                self_p->value = ((self_p->value << 1) << count);
+                self_p->number_of_bits -= (count + 1);
+
+                return (zeros + (uint32_t)count);
+            }
+        }
+
+        /* Only zeros in the register. */
+        zeros += (uint32_t)self_p->number_of_bits;
+        self_p->value = 0;
+        self_p->number_of_bits = 0;
+    }
+}
+
+uint64_t bitstream_fast_reader_read_ue_refill(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint32_t zeros;
+
+    zeros = fast_reader_read_unary(self_p);
+
+    if (zeros == 0) {
+        return (0);
+    } else if (zeros > 32) {
+        self_p->overflow = 1;
+
+        return (0);
+    }
+
+    return ((((uint64_t)1 << zeros) | fast_reader_read(self_p, (int)zeros))
+            - 1);
+}
+
+uint32_t bitstream_fast_reader_read_rice_refill(
+    struct bitstream_fast_reader_t *self_p,
+    int parameter)
+{
+    uint32_t value;
+
+    value = (fast_reader_read_unary(self_p) << parameter);
+
+    if (parameter > 0) {
+        value |= (uint32_t)fast_reader_read(self_p, parameter);
+    }
+
+    return (value);
+}
+
+/* Refill the register before every code, which is cheaper than a
+   mispredicted branch on whether the code is in the register. Codes
+   longer than 57 bits and codes at the end of the buffer are read by
+   the slow path. */
+static void fast_reader_read_exp_golomb_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length,
+    int is_signed)
+{
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    uint64_t code_number;
+    int number_of_bits;
+    int zeros;
+    int code_size;
+    int bytes;
+    int i;
+
+    buf_p = self_p->buf_p;
+    size = self_p->size;
+    byte_offset = self_p->byte_offset;
+    value = self_p->value;
+    number_of_bits = self_p->number_of_bits;
+
+    for (i = 0; i < length; i++) {
+        if (bytes_left(size, byte_offset) >= 8) {
+            value |= (load_u64_be(&buf_p[byte_offset]) >> number_of_bits);
+            bytes = ((63 - number_of_bits) / 8);
+            byte_offset += bytes;
+            number_of_bits += (8 * bytes);
+        }
+
+        zeros = __builtin_clzll(value | 1);
+        code_size = (2 * zeros + 1);
+
+        if (code_size <= number_of_bits) {
+            code_number = (((value << zeros) >> (63 - zeros)) - 1);
+            value = ((value << 1) << (code_size - 1));
+            number_of_bits -= code_size;
+        } else {
+            self_p->byte_offset = byte_offset;
+            self_p->value = value;
+            self_p->number_of_bits = number_of_bits;
+            code_number = bitstream_fast_reader_read_ue_refill(self_p);
+            buf_p = self_p->buf_p;
+            size = self_p->size;
+            byte_offset = self_p->byte_offset;
+            value = self_p->value;
+            number_of_bits = self_p->number_of_bits;
+        }
+
+        if (is_signed) {
+            values_p[i] = (uint32_t)exp_golomb_signed(code_number);
+        } else {
+            values_p[i] = (uint32_t)code_number;
+        }
+    }
+
+    self_p->byte_offset = byte_offset;
+    self_p->value = value;
+    self_p->number_of_bits = number_of_bits;
+}
+
+void bitstream_fast_reader_read_ue_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length)
+{
+    fast_reader_read_exp_golomb_array(self_p, values_p, length, 0);
+}
+
+void bitstream_fast_reader_read_se_array(
+    struct bitstream_fast_reader_t *self_p,
+    int32_t *values_p,
+    int length)
+{
+    fast_reader_read_exp_golomb_array(self_p,
+                                      (uint32_t *)values_p,
+                                      length,
+                                      1);
+}
+
+void bitstream_fast_reader_read_rice_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length,
+    int parameter)
+{
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int zeros;
+    int code_size;
+    int bytes;
+    int i;
+
+    buf_p = self_p->buf_p;
+    size = self_p->size;
+    byte_offset = self_p->byte_offset;
+    value = self_p->value;
+    number_of_bits = self_p->number_of_bits;
+
+    for (i = 0; i < length; i++) {
+        if (bytes_left(size, byte_offset) >= 8) {
+            value |= (load_u64_be(&buf_p[byte_offset]) >> number_of_bits);
+            bytes = ((63 - number_of_bits) / 8);
+            byte_offset += bytes;
+            number_of_bits += (8 * bytes);
+        }
+
+        zeros = __builtin_clzll(value | 1);
+        code_size = (zeros + 1 + parameter);
+
+        if ((value != 0) && (code_size <= number_of_bits)) {
+            values_p[i] = (((uint32_t)zeros << parameter)
+                           | ((uint32_t)((value << zeros) >> (63 - parameter))
+                              ^ (1u << parameter)));
+            value = ((value << 1) << (code_size - 1));
+            number_of_bits -= code_size;
+        } else {
+            self_p->byte_offset = byte_offset;
+            self_p->value = value;
+            self_p->number_of_bits = number_of_bits;
+            values_p[i] = bitstream_fast_reader_read_rice_refill(self_p,
+                                                                 parameter);
+            buf_p = self_p->buf_p;
+            size = self_p->size;
+            byte_offset = self_p->byte_offset;
+            value = self_p->value;
+            number_of_bits = self_p->number_of_bits;
+        }
+    }
+
+    self_p->byte_offset = byte_offset;
+    self_p->value = value;
+    self_p->number_of_bits = number_of_bits;
+}
+
+uint32_t bitstream_fast_reader_read_gamma_refill(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+
+    value = (bitstream_fast_reader_read_ue_refill(self_p) + 1);
+
+    if (value > 0xffffffff) {
+        self_p->overflow = 1;
+
+        return (0);
+    }
+
+    return ((uint32_t)value);
+}
+
+uint32_t bitstream_fast_reader_read_delta_refill(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t length;
+
+    length = (bitstream_fast_reader_read_ue_refill(self_p) + 1);
+
+    if (length > 32) {
+        self_p->overflow = 1;
+
+        return (0);
+    } else if (length == 1) {
+        return (1);
+    }
+
+    return ((uint32_t)((1ull << (length - 1))
+                       | fast_reader_read(self_p, (int)length - 1)));
+}
+
+void bitstream_fast_reader_read_gamma_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length)
+{
+    int i;
+
+    fast_reader_read_exp_golomb_array(self_p, values_p, length, 0);
+
+    for (i = 0; i < length; i++) {
+        values_p[i]++;
+    }
+}
+
+/* As the Exp-Golomb array reader. A delta code of a 32 bits value is
+   at most 42 bits, so all valid codes are in the register after a
+   refill. */
+void bitstream_fast_reader_read_delta_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint32_t *values_p,
+    int length)
+{
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int zeros;
+    int value_length;
+    int code_size;
+    int bytes;
+    int i;
+
+    buf_p = self_p->buf_p;
+    size = self_p->size;
+    byte_offset = self_p->byte_offset;
+    value = self_p->value;
+    number_of_bits = self_p->number_of_bits;
+
+    for (i = 0; i < length; i++) {
+        if (bytes_left(size, byte_offset) >= 8) {
+            value |= (load_u64_be(&buf_p[byte_offset]) >> number_of_bits);
+            bytes = ((63 - number_of_bits) / 8);
+            byte_offset += bytes;
+            number_of_bits += (8 * bytes);
+        }
+
+        zeros = __builtin_clzll(value | 1);
+
+        if (zeros < 6) {
+            value_length = (int)((value << zeros) >> (63 - zeros));
+            code_size = (2 * zeros + value_length);
+
+            if ((value_length <= 32) && (code_size <= number_of_bits)) {
+                values_p[i] = (uint32_t)(((value << (2 * zeros))
+                                          | (1ull << 63))
+                                         >> (64 - value_length));
+                value = ((value << 1) << (code_size - 1));
+                number_of_bits -= code_size;
+                continue;
+            }
+        }
+
+        self_p->byte_offset = byte_offset;
+        self_p->value = value;
+        self_p->number_of_bits = number_of_bits;
+        values_p[i] = bitstream_fast_reader_read_delta_refill(self_p);
+        buf_p = self_p->buf_p;
+        size = self_p->size;
+        byte_offset = self_p->byte_offset;
+        value = self_p->value;
+        number_of_bits = self_p->number_of_bits;
+    }
+
+    self_p->byte_offset = byte_offset;
+    self_p->value = value;
+    self_p->number_of_bits = number_of_bits;
+}
+
+/* Pack the seven bits groups of at most eight bytes. */
+static uint64_t varint_pack(uint64_t value)
+{
+    value &= 0x7f7f7f7f7f7f7f7full;
+    value = (((value & 0x7f007f007f007f00ull) >> 1)
+             | (value & 0x007f007f007f007full));
+    value = (((value & 0x3fff00003fff0000ull) >> 2)
+             | (value & 0x00003fff00003fffull));
+    value = (((value & 0x0fffffff00000000ull) >> 4)
+             | (value & 0x000000000fffffffull));
+
+    return (value);
+}
+
+/* Refill and try the register again. Varints longer than seven bytes
+   and varints at the end of the buffer are read a byte at a time. */
+uint64_t bitstream_fast_reader_read_varint_refill(
+    struct bitstream_fast_reader_t *self_p)
+{
+    uint64_t value;
+    uint64_t byte;
+    int number_of_bits;
+    int shift;
+
+    if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+        fast_reader_refill(self_p);
+        value = self_p->value;
+        number_of_bits = (__builtin_clzll((~value & 0x8080808080808080ull)
+                                          | 1)
+                          + 8);
+
+        if (number_of_bits <= self_p->number_of_bits) {
+            self_p->value = ((value << 1) << (number_of_bits - 1));
+            self_p->number_of_bits -= number_of_bits;
+
+            return (varint_pack(__builtin_bswap64(value)
+                                & (~0ull >> (64 - number_of_bits))));
+        }
+    }
+
+    value = 0;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        byte = fast_reader_read(self_p, 8);
+        value |= ((byte & 0x7f) << shift);
+
+        if ((byte & 0x80) == 0) {
+            return (value);
+        }
+    }
+
+    self_p->overflow = 1;
+
+    return (0);
+}
+
+typedef void (*varint_array_t)(struct bitstream_fast_reader_t *self_p,
+                               uint64_t *values_p,
+                               int length);
+
+/* As the Exp-Golomb array reader. Varints of up to seven bytes are
+   in the register after a refill. */
+static void varint_array_generic(struct bitstream_fast_reader_t *self_p,
+                                 uint64_t *values_p,
+                                 int length)
+{
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int code_size;
+    int bytes;
+    int i;
+
+    buf_p = self_p->buf_p;
+    size = self_p->size;
+    byte_offset = self_p->byte_offset;
+    value = self_p->value;
+    number_of_bits = self_p->number_of_bits;
+
+    for (i = 0; i < length; i++) {
+        if (bytes_left(size, byte_offset) >= 8) {
+            value |= (load_u64_be(&buf_p[byte_offset]) >> number_of_bits);
+            bytes = ((63 - number_of_bits) / 8);
+            byte_offset += bytes;
+            number_of_bits += (8 * bytes);
+        }
+
+        code_size = (__builtin_clzll((~value & 0x8080808080808080ull) | 1)
+                     + 8);
+
+        if (code_size <= number_of_bits) {
+            values_p[i] = varint_pack(__builtin_bswap64(value)
+                                      & (~0ull >> (64 - code_size)));
+            value = ((value << 1) << (code_size - 1));
+            number_of_bits -= code_size;
+            continue;
+        }
+
+        self_p->byte_offset = byte_offset;
+        self_p->value = value;
+        self_p->number_of_bits = number_of_bits;
+        values_p[i] = bitstream_fast_reader_read_varint_refill(self_p);
+        buf_p = self_p->buf_p;
+        size = self_p->size;
+        byte_offset = self_p->byte_offset;
+        value = self_p->value;
+        number_of_bits = self_p->number_of_bits;
+    }
+
+    self_p->byte_offset = byte_offset;
+    self_p->value = value;
+    self_p->number_of_bits = number_of_bits;
+}
+
+#if defined(BITSTREAM_X86_64)
+
+/* As the generic reader, but one PEXT packs the groups. */
+__attribute__((target("bmi2")))
+static void varint_array_bmi2(struct bitstream_fast_reader_t *self_p,
+                              uint64_t *values_p,
+                              int length)
+{
+    const uint8_t *buf_p;
+    size_t size;
+    size_t byte_offset;
+    uint64_t value;
+    int number_of_bits;
+    int code_size;
+    int bytes;
+    int i;
+
+    buf_p = self_p->buf_p;
+    size = self_p->size;
+    byte_offset = self_p->byte_offset;
+    value = self_p->value;
+    number_of_bits = self_p->number_of_bits;
+
+    for (i = 0; i < length; i++) {
+        if (bytes_left(size, byte_offset) >= 8) {
+            value |= (load_u64_be(&buf_p[byte_offset]) >> number_of_bits);
+            bytes = ((63 - number_of_bits) / 8);
+            byte_offset += bytes;
+            number_of_bits += (8 * bytes);
+        }
+
+        code_size = (__builtin_clzll((~value & 0x8080808080808080ull) | 1)
+                     + 8);
+
+        if (code_size <= number_of_bits) {
+            values_p[i] = _pext_u64(__builtin_bswap64(value)
+                                    & (~0ull >> (64 - code_size)),
+                                    0x7f7f7f7f7f7f7f7full);
+            value = ((value << 1) << (code_size - 1));
+            number_of_bits -= code_size;
+            continue;
+        }
+
+        self_p->byte_offset = byte_offset;
+        self_p->value = value;
+        self_p->number_of_bits = number_of_bits;
+        values_p[i] = bitstream_fast_reader_read_varint_refill(self_p);
+        buf_p = self_p->buf_p;
+        size = self_p->size;
+        byte_offset = self_p->byte_offset;
+        value = self_p->value;
+        number_of_bits = self_p->number_of_bits;
+    }
+
+    self_p->byte_offset = byte_offset;
+    self_p->value = value;
+    self_p->number_of_bits = number_of_bits;
+}
+
+#endif
+
+static void varint_array_resolve(struct bitstream_fast_reader_t *self_p,
+                                 uint64_t *values_p,
+                                 int length);
+
+static varint_array_t varint_array = varint_array_resolve;
+
+/* Select implementation on first call. */
+static void varint_array_resolve(struct bitstream_fast_reader_t *self_p,
+                                 uint64_t *values_p,
+                                 int length)
+{
+    varint_array = varint_array_generic;
+
+#if defined(BITSTREAM_X86_64)
+    if (cpu_has_fast_bmi2()) {
+        varint_array = varint_array_bmi2;
+    }
+#endif
+
+    varint_array(self_p, values_p, length);
+}
+
+void bitstream_fast_reader_read_varint_array(
+    struct bitstream_fast_reader_t *self_p,
+    uint64_t *values_p,
+    int length)
+{
+    varint_array(self_p, values_p, length);
+}
+
+void bitstream_fast_reader_read_signed_varint_array(
+    struct bitstream_fast_reader_t *self_p,
+    int64_t *values_p,
+    int length)
+{
+    int i;
+
+    varint_array(self_p, (uint64_t *)values_p, length);
+
+    for (i = 0; i < length; i++) {
+        values_p[i] = zigzag_decode((uint64_t)values_p[i]);
+    }
+}
+
+void bitstream_fast_reader_seek(struct bitstream_fast_reader_t *self_p,
+                                int64_t offset)
+{
+    uint64_t position;
+
+    position = (bitstream_fast_reader_tell(self_p) + (uint64_t)offset);
+
+    /* Bytes before the window, the current segment or the bridge are
+       gone, but their last bits may still be in the register. */
+    if ((position / 8) < self_p->buf_offset) {
+        if ((offset >= 0) && (offset <= self_p->number_of_bits)) {
+            bitstream_fast_reader_skip_bits_refill(self_p, (int)offset);
+        } else {
+            self_p->overflow = 1;
+        }
+
+        return;
+    }
+
+    self_p->byte_offset = (size_t)(position / 8 - self_p->buf_offset);
+    self_p->value = 0;
+    self_p->number_of_bits = 0;
+
+    if ((position % 8) != 0) {
+        fast_reader_read(self_p, (int)(position % 8));
+    }
+}
+
+void bitstream_fast_reader_seek_to(struct bitstream_fast_reader_t *self_p,
+                                   uint64_t bit_offset)
+{
+    bitstream_fast_reader_seek(self_p,
+                               (int64_t)(bit_offset
+                                         - bitstream_fast_reader_tell(self_p)));
+}
+
+uint64_t bitstream_fast_reader_tell(struct bitstream_fast_reader_t *self_p)
+{
+    return ((8 * (self_p->buf_offset + self_p->byte_offset))
+            - self_p->number_of_bits);
+}
+
+int bitstream_fast_reader_overflow(struct bitstream_fast_reader_t *self_p)
+{
+    return (self_p->overflow);
+}
+
+/* Store given number of bytes from the register, but only those that
+   fits in the buffer. Sets the overflow flag if any byte did not
+   fit. */
+static void lsb_writer_store_tail(struct bitstream_lsb_writer_t *self_p,
+                                  int bytes)
+{
+    int i;
+    size_t left;
+    uint64_t value;
+
+    left = bytes_left(self_p->size, self_p->byte_offset);
+
+    if (left < (size_t)bytes) {
+        self_p->overflow = 1;
+        bytes = (int)left;
+    }
+
+    value = self_p->value;
+
+    for (i = 0; i < bytes; i++) {
+        self_p->buf_p[self_p->byte_offset + i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+/* At most 64 bits. */
+static void lsb_writer_write(struct bitstream_lsb_writer_t *self_p,
+                             uint64_t value,
+                             int number_of_bits)
+{
+    int free_bits;
+
+    free_bits = (64 - self_p->number_of_bits);
+    self_p->value |= (value << self_p->number_of_bits);
+
+    if (number_of_bits < free_bits) {
+        self_p->number_of_bits += number_of_bits;
+    } else {
+        if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+            store_u64_le(&self_p->buf_p[self_p->byte_offset], self_p->value);
+        } else {
+            lsb_writer_store_tail(self_p, 8);
+        }
+
+        self_p->byte_offset += 8;
+        self_p->value = ((value >> 1) >> (free_bits - 1));
+        self_p->number_of_bits = (number_of_bits - free_bits);
+    }
+}
+
+/* Store all buffered whole bytes and keep the partial byte, if
+   any. */
+static void lsb_writer_store_bytes(struct bitstream_lsb_writer_t *self_p)
+{
+    int bytes;
+
+    lsb_writer_store_tail(self_p, (self_p->number_of_bits + 7) / 8);
+    bytes = (self_p->number_of_bits / 8);
+    self_p->byte_offset += bytes;
+    self_p->value >>= (8 * bytes);
+    self_p->number_of_bits -= (8 * bytes);
+}
+
+void bitstream_lsb_writer_init(struct bitstream_lsb_writer_t *self_p,
+                               uint8_t *buf_p,
+                               size_t size)
+{
+    self_p->buf_p = buf_p;
+    self_p->size = size;
+    self_p->byte_offset = 0;
+    self_p->value = 0;
+    self_p->number_of_bits = 0;
+    self_p->overflow = 0;
+}
+
+uint64_t bitstream_lsb_writer_size_in_bits(
+    struct bitstream_lsb_writer_t *self_p)
+{
+    return ((8 * (uint64_t)self_p->byte_offset) + self_p->number_of_bits);
+}
+
+size_t bitstream_lsb_writer_size_in_bytes(
+    struct bitstream_lsb_writer_t *self_p)
+{
+    return (self_p->byte_offset + (self_p->number_of_bits + 7) / 8);
+}
+
+void bitstream_lsb_writer_write_bytes(struct bitstream_lsb_writer_t *self_p,
+                                      const uint8_t *buf_p,
+                                      int length)
+{
+    int i;
+    size_t left;
+
+    if ((self_p->number_of_bits % 8) == 0) {
+        lsb_writer_store_bytes(self_p);
+        left = bytes_left(self_p->size, self_p->byte_offset);
+
+        if (left < (size_t)length) {
+            self_p->overflow = 1;
+        } else {
+            left = (size_t)length;
+        }
+
+        if (left > 0) {
+            memcpy(&self_p->buf_p[self_p->byte_offset],
+                   buf_p,
+                   sizeof(uint8_t) * left);
+        }
+
+        self_p->byte_offset += length;
+    } else {
+        while (length >= 8) {
+            lsb_writer_write(self_p, load_u64_le(buf_p), 64);
+            buf_p += 8;
+            length -= 8;
+        }
+
+        for (i = 0; i < length; i++) {
+            lsb_writer_write(self_p, buf_p[i], 8);
+        }
+    }
+}
+
+void bitstream_lsb_writer_write_u64_bits_store(
+    struct bitstream_lsb_writer_t *self_p,
+    uint64_t value,
+    int number_of_bits)
+{
+    if (number_of_bits == 0) {
+        return;
+    }
+
+    lsb_writer_write(self_p, value, number_of_bits);
+}
+
+void bitstream_lsb_writer_flush(struct bitstream_lsb_writer_t *self_p)
+{
+    lsb_writer_store_tail(self_p, (self_p->number_of_bits + 7) / 8);
+}
+
+void bitstream_lsb_writer_seek(struct bitstream_lsb_writer_t *self_p,
+                               int64_t offset)
+{
+    uint64_t position;
+
+    bitstream_lsb_writer_flush(self_p);
+    position = (bitstream_lsb_writer_size_in_bits(self_p) + (uint64_t)offset);
+    self_p->byte_offset = (size_t)(position / 8);
+    self_p->number_of_bits = (int)(position % 8);
+
+    if ((self_p->number_of_bits == 0)
+        || (self_p->byte_offset >= self_p->size)) {
+        self_p->value = 0;
+    } else {
+        self_p->value = (self_p->buf_p[self_p->byte_offset]
+                         & ((1 << self_p->number_of_bits) - 1));
+    }
+}
+
+int bitstream_lsb_writer_overflow(struct bitstream_lsb_writer_t *self_p)
+{
+    return (self_p->overflow);
+}
+
+/* Load as many whole bytes as fits into the register. Bits of a
+   partially loaded byte are already in place and are loaded again by
+   the next refill, which is harmless as they are or:ed. */
+static void lsb_reader_refill(struct bitstream_lsb_reader_t *self_p)
+{
+    int bytes;
+
+    bytes = ((63 - self_p->number_of_bits) / 8);
+    self_p->value |= (load_u64_le(&self_p->buf_p[self_p->byte_offset])
+                      << self_p->number_of_bits);
+    self_p->byte_offset += bytes;
+    self_p->number_of_bits += (8 * bytes);
+}
+
+/* Refill byte by byte close to the end of the buffer. Missing bits are
+   read as zeros and sets the overflow flag. */
+static void lsb_reader_refill_tail(struct bitstream_lsb_reader_t *self_p,
+                                   int number_of_bits)
+{
+    int i;
+    int bytes;
+    size_t left;
+
+    left = bytes_left(self_p->size, self_p->byte_offset);
+    bytes = ((63 - self_p->number_of_bits) / 8);
+
+    if ((size_t)bytes > left) {
+        bytes = (int)left;
+    }
+
+    for (i = 0; i < bytes; i++) {
+        self_p->value |= ((uint64_t)self_p->buf_p[self_p->byte_offset + i]
+                          << (self_p->number_of_bits + 8 * i));
+    }
+
+    self_p->byte_offset += bytes;
+    self_p->number_of_bits += (8 * bytes);
+
+    if (self_p->number_of_bits < number_of_bits) {
+        self_p->overflow = 1;
+        bytes = ((number_of_bits - self_p->number_of_bits + 7) / 8);
+        self_p->byte_offset += bytes;
+        self_p->number_of_bits += (8 * bytes);
+    }
+}
+
+/* At most 56 bits, which is always available after a refill. */
+static uint64_t lsb_reader_read(struct bitstream_lsb_reader_t *self_p,
+                                int number_of_bits)
+{
+    uint64_t value;
+
+    if (self_p->number_of_bits < number_of_bits) {
+        if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+            lsb_reader_refill(self_p);
+        } else {
+            lsb_reader_refill_tail(self_p, number_of_bits);
+        }
+    }
+
+    value = (self_p->value & ((1ull << number_of_bits) - 1));
+    self_p->value >>= number_of_bits;
+    self_p->number_of_bits -= number_of_bits;
+
+    return (value);
+}
+
+void bitstream_lsb_reader_init(struct bitstream_lsb_reader_t *self_p,
+                               const uint8_t *buf_p,
+                               size_t size)
+{
+    self_p->buf_p = buf_p;
+    self_p->size = size;
+    self_p->byte_offset = 0;
+    self_p->value = 0;
+    self_p->number_of_bits = 0;
+    self_p->overflow = 0;
+}
+
+void bitstream_lsb_reader_read_bytes(struct bitstream_lsb_reader_t *self_p,
+                                     uint8_t *buf_p,
+                                     int length)
+{
+    int i;
+    size_t left;
+    uint64_t value;
+
+    if ((self_p->number_of_bits % 8) == 0) {
+        /* Byte aligned. Take whole bytes from the register, then copy
+           directly from the buffer. */
+        while ((self_p->number_of_bits > 0) && (length > 0)) {
+            *buf_p++ = (uint8_t)lsb_reader_read(self_p, 8);
+            length--;
+        }
+
+        /* Partially loaded bytes are copied below. */
+        if (self_p->number_of_bits == 0) {
+            self_p->value = 0;
+        }
+
+        left = bytes_left(self_p->size, self_p->byte_offset);
+
+        if (left < (size_t)length) {
+            memset(&buf_p[left], 0, sizeof(uint8_t) * (length - left));
+            self_p->overflow = 1;
+        } else {
+            left = (size_t)length;
+        }
+
+        if (left > 0) {
+            memcpy(buf_p,
+                   &self_p->buf_p[self_p->byte_offset],
+                   sizeof(uint8_t) * left);
+        }
+
+        self_p->byte_offset += length;
     } else {
+        /* Seven bytes per refill. */
+        while (length >= 7) {
+            value = lsb_reader_read(self_p, 56);
+
+            for (i = 0; i < 7; i++) {
+                buf_p[i] = (uint8_t)value;
+                value >>= 8;
+            }
+
+            buf_p += 7;
+            length -= 7;
+        }
+
         for (i = 0; i < length; i++) {
-            buf_p[i] = (src_p[i] << self_p->bit_offset);
-            buf_p[i] |= (src_p[i + 1] >> (8 - self_p->bit_offset));
+            buf_p[i] = (uint8_t)lsb_reader_read(self_p, 8);
+        }
+    }
+}
+
+uint64_t bitstream_lsb_reader_read_u64_bits_refill(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits)
+{
+    uint64_t value;
+
+    if (number_of_bits == 0) {
+        return (0);
+    }
+
+    if (number_of_bits > 56) {
+        value = lsb_reader_read(self_p, 32);
+        value |= (lsb_reader_read(self_p, number_of_bits - 32) << 32);
+    } else {
+        value = lsb_reader_read(self_p, number_of_bits);
+    }
+
+    return (value);
+}
+
+uint64_t bitstream_lsb_reader_peek_u64_bits_refill(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits)
+{
+    if (number_of_bits == 0) {
+        return (0);
+    }
+
+    /* Bits past the end of the stream are zero in the register. Do not
+       set the overflow flag, as they may never be used. */
+    if (self_p->number_of_bits < number_of_bits) {
+        if (bytes_left(self_p->size, self_p->byte_offset) >= 8) {
+            lsb_reader_refill(self_p);
+        } else {
+            lsb_reader_refill_tail(self_p, 0);
+        }
+    }
+
+    return (self_p->value & ((1ull << number_of_bits) - 1));
+}
+
+void bitstream_lsb_reader_skip_bits_refill(
+    struct bitstream_lsb_reader_t *self_p,
+    int number_of_bits)
+{
+    while (number_of_bits > 56) {
+        lsb_reader_read(self_p, 56);
+        number_of_bits -= 56;
+    }
+
+    if (number_of_bits > 0) {
+        lsb_reader_read(self_p, number_of_bits);
+    }
+}
+
+void bitstream_lsb_reader_seek(struct bitstream_lsb_reader_t *self_p,
+                               int64_t offset)
+{
+    uint64_t position;
+
+    position = (bitstream_lsb_reader_tell(self_p) + (uint64_t)offset);
+    self_p->byte_offset = (size_t)(position / 8);
+    self_p->value = 0;
+    self_p->number_of_bits = 0;
+
+    if ((position % 8) != 0) {
+        lsb_reader_read(self_p, (int)(position % 8));
+    }
+}
+
+void bitstream_lsb_reader_seek_to(struct bitstream_lsb_reader_t *self_p,
+                                  uint64_t bit_offset)
+{
+    bitstream_lsb_reader_seek(self_p,
+                              (int64_t)(bit_offset
+                                        - bitstream_lsb_reader_tell(self_p)));
+}
+
+uint64_t bitstream_lsb_reader_tell(struct bitstream_lsb_reader_t *self_p)
+{
+    return ((8 * (uint64_t)self_p->byte_offset) - self_p->number_of_bits);
+}
+
+int bitstream_lsb_reader_overflow(struct bitstream_lsb_reader_t *self_p)
+{
+    return (self_p->overflow);
+}
+
+typedef void (*plan_decode_t)(struct bitstream_plan_t *self_p,
+                              struct bitstream_fast_reader_t *reader_p,
+                              uint64_t *values_p);
+
+static void plan_skip(struct bitstream_fast_reader_t *reader_p,
+                      int number_of_bits)
+{
+    while (number_of_bits > 56) {
+        fast_reader_read(reader_p, 56);
+        number_of_bits -= 56;
+    }
+
+    if (number_of_bits > 0) {
+        fast_reader_read(reader_p, number_of_bits);
+    }
+}
+
+static uint64_t plan_read_group(struct bitstream_plan_group_t *group_p,
+                                struct bitstream_fast_reader_t *reader_p)
+{
+    plan_skip(reader_p, group_p->skip);
+
+    if (group_p->lane_width == 0) {
+        return (bitstream_fast_reader_read_u64_bits(reader_p,
+                                                    group_p->number_of_bits));
+    } else {
+        return (fast_reader_read(reader_p, group_p->number_of_bits));
+    }
+}
+
+static void plan_decode_generic(struct bitstream_plan_t *self_p,
+                                struct bitstream_fast_reader_t *reader_p,
+                                uint64_t *values_p)
+{
+    int i;
+    int j;
+    const uint8_t *widths_p;
+    const uint8_t *gaps_p;
+    struct bitstream_plan_group_t *group_p;
+    uint64_t value;
+
+    widths_p = &self_p->widths[0];
+    gaps_p = &self_p->gaps[0];
+
+    for (i = 0; i < self_p->number_of_groups; i++) {
+        group_p = &self_p->groups[i];
+        value = plan_read_group(group_p, reader_p);
+
+        for (j = group_p->number_of_fields - 1; j >= 0; j--) {
+            values_p[j] = (value & ((2ull << (widths_p[j] - 1)) - 1));
+            value = ((value >> 1) >> (widths_p[j] + gaps_p[j] - 1));
+        }
+
+        widths_p += group_p->number_of_fields;
+        gaps_p += group_p->number_of_fields;
+        values_p += group_p->number_of_fields;
+    }
+}
+
+#if defined(BITSTREAM_X86_64)
+
+/* One PEXT per group removes gaps between fields, if any, and one
+   PDEP spreads the fields into lanes. */
+__attribute__((target("bmi2")))
+static void plan_decode_bmi2(struct bitstream_plan_t *self_p,
+                             struct bitstream_fast_reader_t *reader_p,
+                             uint64_t *values_p)
+{
+    int i;
+    int j;
+    int lane_width;
+    struct bitstream_plan_group_t *group_p;
+    uint64_t lanes;
+    uint64_t lane_mask;
+
+    for (i = 0; i < self_p->number_of_groups; i++) {
+        group_p = &self_p->groups[i];
+        lanes = plan_read_group(group_p, reader_p);
+
+        if (group_p->lane_width == 0) {
+            values_p[0] = lanes;
+        } else {
+            if (group_p->extract_mask != 0) {
+                lanes = _pext_u64(lanes, group_p->extract_mask);
+            }
+
+            lane_width = group_p->lane_width;
+            lanes = _pdep_u64(lanes, group_p->mask);
+            lane_mask = ((1ull << lane_width) - 1);
+
+            for (j = group_p->number_of_fields - 1; j >= 0; j--) {
+                values_p[j] = (lanes & lane_mask);
+                lanes >>= lane_width;
+            }
+        }
+
+        values_p += group_p->number_of_fields;
+    }
+}
+
+#endif
+
+static void plan_decode_resolve(struct bitstream_plan_t *self_p,
+                                struct bitstream_fast_reader_t *reader_p,
+                                uint64_t *values_p);
+
+static plan_decode_t plan_decode = plan_decode_resolve;
+
+/* Select implementation on first call. */
+static void plan_decode_resolve(struct bitstream_plan_t *self_p,
+                                struct bitstream_fast_reader_t *reader_p,
+                                uint64_t *values_p)
+{
+    plan_decode = plan_decode_generic;
+
+#if defined(BITSTREAM_X86_64)
+    if (cpu_has_fast_bmi2()) {
+        plan_decode = plan_decode_bmi2;
+    }
+#endif
+
+    plan_decode(self_p, reader_p, values_p);
+}
+
+/* Fields are read in groups of at most 56 bits, so each group is a
+   single read from the register. Gaps up to the first field of a
+   group are skipped, while gaps between fields in a group are read
+   and thrown away. Fields of up to 16 bits gets their own 8 or 16
+   bits lane in the group mask, with the last field in the lowest
+   lane. Wider fields are read one by one, with lane width zero. */
+int bitstream_plan_init(struct bitstream_plan_t *self_p,
+                        const int *widths_p,
+                        const int *offsets_p,
+                        int number_of_fields)
+{
+    int i;
+    int width;
+    int gap;
+    int lane_width;
+    int64_t end;
+    struct bitstream_plan_group_t *group_p;
+
+    if ((number_of_fields < 0)
+        || (number_of_fields > BITSTREAM_PLAN_MAX_FIELDS)) {
+        return (-EINVAL);
+    }
+
+    end = 0;
+
+    for (i = 0; i < number_of_fields; i++) {
+        if ((widths_p[i] < 1) || (widths_p[i] > 64)) {
+            return (-EINVAL);
+        }
+
+        if (offsets_p != NULL) {
+            if (offsets_p[i] < end) {
+                return (-EINVAL);
+            }
+
+            end = offsets_p[i];
+        }
+
+        end += widths_p[i];
+    }
+
+    self_p->number_of_fields = number_of_fields;
+    self_p->number_of_groups = 0;
+    self_p->number_of_bits = end;
+    group_p = NULL;
+    end = 0;
+
+    for (i = 0; i < number_of_fields; i++) {
+        width = widths_p[i];
+
+        if (offsets_p != NULL) {
+            gap = (int)(offsets_p[i] - end);
+        } else {
+            gap = 0;
+        }
+
+        end += (gap + width);
+
+        if (width <= 8) {
+            lane_width = 8;
+        } else if (width <= 16) {
+            lane_width = 16;
+        } else {
+            lane_width = 0;
+        }
+
+        if ((group_p == NULL)
+            || (group_p->lane_width == 0)
+            || (lane_width != group_p->lane_width)
+            || (group_p->number_of_fields == 64 / lane_width)
+            || (group_p->number_of_bits + gap + width > 56)) {
+            group_p = &self_p->groups[self_p->number_of_groups];
+            group_p->mask = 0;
+            group_p->extract_mask = 0;
+            group_p->skip = gap;
+            group_p->number_of_fields = 0;
+            group_p->number_of_bits = 0;
+            group_p->lane_width = lane_width;
+            self_p->number_of_groups++;
+            gap = 0;
+        }
+
+        if (lane_width != 0) {
+            group_p->mask <<= lane_width;
+            group_p->mask |= ((1ull << width) - 1);
+            group_p->extract_mask <<= (gap + width);
+            group_p->extract_mask |= ((1ull << width) - 1);
+        }
+
+        self_p->widths[i] = (uint8_t)width;
+        self_p->gaps[i] = (uint8_t)gap;
+        group_p->number_of_fields++;
+        group_p->number_of_bits += (gap + width);
+    }
+
+    /* PEXT is only needed in groups with gaps. */
+    for (i = 0; i < self_p->number_of_groups; i++) {
+        group_p = &self_p->groups[i];
+
+        if ((group_p->lane_width != 0)
+            && (group_p->extract_mask
+                == ((1ull << group_p->number_of_bits) - 1))) {
+            group_p->extract_mask = 0;
+        }
+    }
+
+    return (0);
+}
+
+uint64_t bitstream_plan_size_in_bits(struct bitstream_plan_t *self_p)
+{
+    return (self_p->number_of_bits);
+}
+
+void bitstream_plan_decode(struct bitstream_plan_t *self_p,
+                           struct bitstream_fast_reader_t *reader_p,
+                           uint64_t *values_p)
+{
+    plan_decode(self_p, reader_p, values_p);
+}
+
+void bitstream_plan_encode(struct bitstream_plan_t *self_p,
+                           struct bitstream_fast_writer_t *writer_p,
+                           const uint64_t *values_p)
+{
+    int i;
+    int j;
+    int skip;
+    const uint8_t *widths_p;
+    const uint8_t *gaps_p;
+    struct bitstream_plan_group_t *group_p;
+    uint64_t value;
+
+    widths_p = &self_p->widths[0];
+    gaps_p = &self_p->gaps[0];
+
+    for (i = 0; i < self_p->number_of_groups; i++) {
+        group_p = &self_p->groups[i];
+
+        for (skip = group_p->skip; skip > 0; skip -= 64) {
+            fast_writer_write(writer_p, 0, skip < 64 ? skip : 64);
+        }
+
+        value = 0;
+
+        for (j = 0; j < group_p->number_of_fields; j++) {
+            value = ((value << gaps_p[j]) << 1) << (widths_p[j] - 1);
+            value |= (values_p[j] & ((2ull << (widths_p[j] - 1)) - 1));
+        }
+
+        fast_writer_write(writer_p, value, group_p->number_of_bits);
+        widths_p += group_p->number_of_fields;
+        gaps_p += group_p->number_of_fields;
+        values_p += group_p->number_of_fields;
+    }
+}
+
+/* Version 1 format: version (8 bits), interval (32 bits), number of
+   records (64 bits), number of offsets (32 bits) and the offsets (64
+   bits each), all big endian. */
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 17
+
+int bitstream_index_init(struct bitstream_index_t *self_p,
+                         int interval,
+                         uint64_t *offsets_p,
+                         int max_number_of_entries)
+{
+    if (interval < 1) {
+        return (-EINVAL);
+    }
+
+    self_p->interval = interval;
+    self_p->number_of_records = 0;
+    self_p->number_of_entries = 0;
+    self_p->max_number_of_entries = max_number_of_entries;
+    self_p->offsets_p = offsets_p;
+
+    return (0);
+}
+
+int bitstream_index_add(struct bitstream_index_t *self_p,
+                        uint64_t bit_offset)
+{
+    if ((self_p->number_of_records % self_p->interval) == 0) {
+        if (self_p->number_of_entries == self_p->max_number_of_entries) {
+            return (-ENOSPC);
         }
+
+        self_p->offsets_p[self_p->number_of_entries] = bit_offset;
+        self_p->number_of_entries++;
+    }
+
+    self_p->number_of_records++;
+
+    return (0);
+}
+
+int bitstream_index_lookup(struct bitstream_index_t *self_p,
+                           int record,
+                           uint64_t *bit_offset_p)
+{
+    if ((record < 0) || (record >= self_p->number_of_records)) {
+        return (-EINVAL);
+    }
+
+    *bit_offset_p = self_p->offsets_p[record / self_p->interval];
+
+    return (record - (record % self_p->interval));
+}
+
+size_t bitstream_index_encoded_size(struct bitstream_index_t *self_p)
+{
+    return (INDEX_HEADER_SIZE + 8 * (size_t)self_p->number_of_entries);
+}
+
+ssize_t bitstream_index_encode(struct bitstream_index_t *self_p,
+                               uint8_t *buf_p,
+                               size_t size)
+{
+    struct bitstream_fast_writer_t writer;
+    int i;
+
+    if (size < bitstream_index_encoded_size(self_p)) {
+        return (-ENOSPC);
+    }
+
+    bitstream_fast_writer_init(&writer, buf_p, size);
+    bitstream_fast_writer_write_u8(&writer, INDEX_VERSION);
+    bitstream_fast_writer_write_u32(&writer, (uint32_t)self_p->interval);
+    bitstream_fast_writer_write_u64(&writer,
+                                    (uint64_t)self_p->number_of_records);
+    bitstream_fast_writer_write_u32(&writer,
+                                    (uint32_t)self_p->number_of_entries);
+
+    for (i = 0; i < self_p->number_of_entries; i++) {
+        bitstream_fast_writer_write_u64(&writer, self_p->offsets_p[i]);
     }
 
-    self_p->byte_offset += length;
+    bitstream_fast_writer_flush(&writer);
+
+    return ((ssize_t)bitstream_fast_writer_size_in_bytes(&writer));
 }
 
-uint8_t bitstream_reader_read_u8(struct bitstream_reader_t *self_p)
+int bitstream_index_decode(struct bitstream_index_t *self_p,
+                           const uint8_t *buf_p,
+                           size_t size)
 {
-    uint8_t value;
+    struct bitstream_fast_reader_t reader;
+    uint64_t interval;
+    uint64_t number_of_records;
+    uint64_t number_of_entries;
+    int i;
 
-    value = (self_p->buf_p[self_p->byte_offset] << self_p->bit_offset);
-    self_p->byte_offset++;
+    if (size < INDEX_HEADER_SIZE) {
+        return (-EPROTO);
+    }
 
-    if (self_p->bit_offset != 0) {
-        value |= (self_p->buf_p[self_p->byte_offset] >> (8 - self_p->bit_offset));
+    bitstream_fast_reader_init(&reader, buf_p, size);
+
+    if (bitstream_fast_reader_read_u8(&reader) != INDEX_VERSION) {
+        return (-EPROTO);
+    }
+
+    interval = bitstream_fast_reader_read_u32(&reader);
+    number_of_records = bitstream_fast_reader_read_u64(&reader);
+    number_of_entries = bitstream_fast_reader_read_u32(&reader);
+
+    if ((interval < 1)
+        || (interval > INT32_MAX)
+        || (number_of_records > INT32_MAX)
+        || (number_of_entries != ((number_of_records + interval - 1)
+                                  / interval))) {
+        return (-EPROTO);
+    }
+
+    if (number_of_entries > (uint64_t)self_p->max_number_of_entries) {
+        return (-ENOSPC);
+    }
+
+    if ((size - INDEX_HEADER_SIZE) / 8 < number_of_entries) {
+        return (-EPROTO);
+    }
+
+    for (i = 0; i < (int)number_of_entries; i++) {
+        self_p->offsets_p[i] = bitstream_fast_reader_read_u64(&reader);
+    }
+
+    self_p->interval = (int)interval;
+    self_p->number_of_records = (int)number_of_records;
+    self_p->number_of_entries = (int)number_of_entries;
+
+    return (0);
+}
+
+static uint64_t can_sign_extend(struct bitstream_can_codec_signal_t *signal_p,
+                                uint64_t value)
+{
+    uint64_t sign;
+
+    value &= signal_p->mask;
+
+    if (signal_p->is_signed && (signal_p->length < 64)) {
+        sign = (1ull << (signal_p->length - 1));
+        value = ((value ^ sign) - sign);
     }
 
     return (value);
 }
 
-uint16_t bitstream_reader_read_u16(struct bitstream_reader_t *self_p)
+/* Any frame size. Signals crossing the end of the loaded word take
+   their last bits from the byte after it. */
+static uint64_t can_unpack_signal(struct bitstream_can_codec_signal_t *signal_p,
+                                  const uint8_t *frame_p)
+{
+    const uint8_t *buf_p;
+    uint64_t value;
+    int shift;
+
+    buf_p = &frame_p[signal_p->byte_offset];
+    shift = signal_p->shift;
+
+    if (signal_p->byte_order == BITSTREAM_CAN_INTEL) {
+        value = (load_u64_le(buf_p) >> shift);
+
+        if ((shift + signal_p->length) > 64) {
+            value |= ((uint64_t)buf_p[8] << (64 - shift));
+        }
+    } else if (shift >= 0) {
+        value = (load_u64_be(buf_p) >> shift);
+    } else {
+        value = ((load_u64_be(buf_p) << -shift) | (buf_p[8] >> (8 + shift)));
+    }
+
+    return (can_sign_extend(signal_p, value));
+}
+
+int bitstream_can_codec_init(struct bitstream_can_codec_t *self_p,
+                             const struct bitstream_can_signal_t *signals_p,
+                             int number_of_signals,
+                             int frame_size)
 {
-    uint16_t value;
+    struct bitstream_can_codec_signal_t *signal_p;
     int i;
-    int offset;
-    const uint8_t *src_p;
+    int first;
+    int length;
+    int max_byte_offset;
 
-    src_p = &self_p->buf_p[self_p->byte_offset];
-    offset = (16 + self_p->bit_offset);
-    value = 0;
+    if ((frame_size < 1) || (frame_size > 64)) {
+        return (-EINVAL);
+    }
 
-    for (i = 0; i < 2; i++) {
-        offset -= 8;
-        value |= ((uint16_t)src_p[i] << offset);
+    if ((number_of_signals < 0)
+        || (number_of_signals > BITSTREAM_CAN_MAX_SIGNALS)) {
+        return (-EINVAL);
     }
 
-    if (offset != 0) {
-        value |= (src_p[2] >> (8 - offset));
+    /* Frames of up to 8 bytes are unpacked from a zero padded copy. */
+    if (frame_size <= 8) {
+        max_byte_offset = 0;
+    } else {
+        max_byte_offset = (frame_size - 8);
     }
 
-    self_p->byte_offset += 2;
+    for (i = 0; i < number_of_signals; i++) {
+        length = signals_p[i].length;
 
-    return (value);
+        if ((length < 1) || (length > 64) || (signals_p[i].scale == 0.0)) {
+            return (-EINVAL);
+        }
+
+        if ((signals_p[i].start < 0)
+            || (signals_p[i].start >= (8 * frame_size))) {
+            return (-EINVAL);
+        }
+
+        /* First bit of the signal counted from the most significant
+           bit of the first byte for Motorola signals, and from the
+           least significant bit for Intel signals. */
+        switch (signals_p[i].byte_order) {
+
+        case BITSTREAM_CAN_INTEL:
+            first = signals_p[i].start;
+            break;
+
+        case BITSTREAM_CAN_MOTOROLA:
+            first = ((signals_p[i].start & ~7) + 7 - (signals_p[i].start & 7));
+            break;
+
+        default:
+            return (-EINVAL);
+        }
+
+        if ((first + length) > (8 * frame_size)) {
+            return (-EINVAL);
+        }
+
+        signal_p = &self_p->signals[i];
+        signal_p->byte_offset = (first / 8);
+
+        if (signal_p->byte_offset > max_byte_offset) {
+            signal_p->byte_offset = max_byte_offset;
+        }
+
+        first -= (8 * signal_p->byte_offset);
+
+        if (signals_p[i].byte_order == BITSTREAM_CAN_INTEL) {
+            signal_p->shift = first;
+        } else {
+            signal_p->shift = (64 - first - length);
+        }
+
+        if (length == 64) {
+            signal_p->mask = ~0ull;
+        } else {
+            signal_p->mask = ((1ull << length) - 1);
+        }
+
+        signal_p->length = length;
+        signal_p->byte_order = signals_p[i].byte_order;
+        signal_p->is_signed = signals_p[i].is_signed;
+        signal_p->scale = signals_p[i].scale;
+        signal_p->offset = signals_p[i].offset;
+    }
+
+    self_p->frame_size = frame_size;
+    self_p->number_of_signals = number_of_signals;
+
+    return (0);
 }
 
-uint32_t bitstream_reader_read_u32(struct bitstream_reader_t *self_p)
+void bitstream_can_codec_unpack_raw(struct bitstream_can_codec_t *self_p,
+                                    const uint8_t *frame_p,
+                                    uint64_t *values_p)
 {
-    uint32_t value;
+    struct bitstream_can_codec_signal_t *signal_p;
+    uint8_t buf[8];
+    uint64_t intel;
+    uint64_t motorola;
     int i;
-    int offset;
-    const uint8_t *src_p;
 
-    src_p = &self_p->buf_p[self_p->byte_offset];
-    offset = (32 + self_p->bit_offset);
-    value = 0;
+    if (self_p->frame_size > 8) {
+        for (i = 0; i < self_p->number_of_signals; i++) {
+            values_p[i] = can_unpack_signal(&self_p->signals[i], frame_p);
+        }
 
-    for (i = 0; i < 4; i++) {
-        offset -= 8;
-        value |= ((uint32_t)src_p[i] << offset);
+        return;
     }
 
-    if (offset != 0) {
-        value |= (src_p[4] >> (8 - offset));
+    if (self_p->frame_size < 8) {
+        memset(&buf[0], 0, sizeof(buf));
+        memcpy(&buf[0], frame_p, (size_t)self_p->frame_size);
+        frame_p = &buf[0];
     }
 
-    self_p->byte_offset += 4;
+    intel = load_u64_le(frame_p);
+    motorola = load_u64_be(frame_p);
 
-    return (value);
+    for (i = 0; i < self_p->number_of_signals; i++) {
+        signal_p = &self_p->signals[i];
+
+        if (signal_p->byte_order == BITSTREAM_CAN_INTEL) {
+            values_p[i] = can_sign_extend(signal_p, intel >> signal_p->shift);
+        } else {
+            values_p[i] = can_sign_extend(signal_p,
+                                          motorola >> signal_p->shift);
+        }
+    }
 }
 
-uint64_t bitstream_reader_read_u64(struct bitstream_reader_t *self_p)
+/* Signals are or:ed into 64 bits lanes, little endian lanes for Intel
+   signals and big endian lanes for Motorola signals, which are stored
+   once each at the end. This avoids reading back partially
+   overlapping stores, which is slow. */
+void bitstream_can_codec_pack_raw(struct bitstream_can_codec_t *self_p,
+                                  uint8_t *frame_p,
+                                  const uint64_t *values_p)
 {
+    struct bitstream_can_codec_signal_t *signal_p;
+    uint64_t intel[8];
+    uint64_t motorola[8];
     uint64_t value;
+    uint8_t buf[8];
+    int number_of_lanes;
+    int first;
+    int lane;
+    int shift;
+    int size;
     int i;
-    int offset;
-    const uint8_t *src_p;
 
-    src_p = &self_p->buf_p[self_p->byte_offset];
-    offset = (64 + self_p->bit_offset);
-    value = 0;
+    number_of_lanes = ((self_p->frame_size + 7) / 8);
 
-    for (i = 0; i < 8; i++) {
-        offset -= 8;
-        value |= ((uint64_t)src_p[i] << offset);
+    for (i = 0; i < number_of_lanes; i++) {
+        intel[i] = 0;
+        motorola[i] = 0;
     }
 
-    if (offset != 0) {
-        value |= ((uint64_t)src_p[8] >> (8 - offset));
+    for (i = 0; i < self_p->number_of_signals; i++) {
+        signal_p = &self_p->signals[i];
+        value = (values_p[i] & signal_p->mask);
+
+        if (signal_p->byte_order == BITSTREAM_CAN_INTEL) {
+            first = (8 * signal_p->byte_offset + signal_p->shift);
+            lane = (first / 64);
+            shift = (first % 64);
+            intel[lane] |= (value << shift);
+
+            if ((shift + signal_p->length) > 64) {
+                intel[lane + 1] |= (value >> (64 - shift));
+            }
+        } else {
+            first = (8 * signal_p->byte_offset
+                     + 64
+                     - signal_p->shift
+                     - signal_p->length);
+            lane = (first / 64);
+            shift = (64 - (first % 64) - signal_p->length);
+
+            if (shift >= 0) {
+                motorola[lane] |= (value << shift);
+            } else {
+                motorola[lane] |= (value >> -shift);
+                motorola[lane + 1] |= (value << (64 + shift));
+            }
+        }
     }
 
-    self_p->byte_offset += 8;
+    for (i = 0; i < number_of_lanes; i++) {
+        size = (self_p->frame_size - 8 * i);
 
-    return (value);
+        if (size >= 8) {
+            store_u64_be(&frame_p[8 * i], motorola[i]);
+            store_u64_le(&frame_p[8 * i],
+                         load_u64_le(&frame_p[8 * i]) | intel[i]);
+        } else {
+            store_u64_be(&buf[0], motorola[i]);
+            store_u64_le(&buf[0], load_u64_le(&buf[0]) | intel[i]);
+            memcpy(&frame_p[8 * i], &buf[0], (size_t)size);
+        }
+    }
 }
 
-uint64_t bitstream_reader_read_u64_bits(struct bitstream_reader_t *self_p,
-                                        int number_of_bits)
+void bitstream_can_codec_unpack(struct bitstream_can_codec_t *self_p,
+                                const uint8_t *frame_p,
+                                double *values_p)
 {
-    uint64_t value;
+    struct bitstream_can_codec_signal_t *signal_p;
+    uint64_t raw[BITSTREAM_CAN_MAX_SIGNALS];
     int i;
-    int first_byte_bits;
-    int last_byte_bits;
-    int full_bytes;
 
-    if (number_of_bits == 0) {
+    bitstream_can_codec_unpack_raw(self_p, frame_p, &raw[0]);
+
+    for (i = 0; i < self_p->number_of_signals; i++) {
+        signal_p = &self_p->signals[i];
+
+        if (signal_p->is_signed) {
+            values_p[i] = ((double)(int64_t)raw[i] * signal_p->scale
+                           + signal_p->offset);
+        } else {
+            values_p[i] = ((double)raw[i] * signal_p->scale
+                           + signal_p->offset);
+        }
+    }
+}
+
+void bitstream_can_codec_pack(struct bitstream_can_codec_t *self_p,
+                              uint8_t *frame_p,
+                              const double *values_p)
+{
+    struct bitstream_can_codec_signal_t *signal_p;
+    uint64_t raw[BITSTREAM_CAN_MAX_SIGNALS];
+    double value;
+    int i;
+
+    for (i = 0; i < self_p->number_of_signals; i++) {
+        signal_p = &self_p->signals[i];
+        value = ((values_p[i] - signal_p->offset) / signal_p->scale);
+
+        if (value < 0.0) {
+            raw[i] = (uint64_t)(int64_t)(value - 0.5);
+        } else {
+            raw[i] = (uint64_t)(value + 0.5);
+        }
+    }
+
+    bitstream_can_codec_pack_raw(self_p, frame_p, &raw[0]);
+}
+
+#define HUFFMAN_SUBTABLE                                0x80000000u
+#define HUFFMAN_SUBTABLE_BITS                           \
+    (BITSTREAM_HUFFMAN_MAX_LENGTH - BITSTREAM_HUFFMAN_ROOT_BITS)
+
+struct huffman_symbol_t {
+    uint32_t frequency;
+    uint16_t symbol;
+};
+
+static int huffman_compare_symbols(const void *left_p, const void *right_p)
+{
+    const struct huffman_symbol_t *l_p;
+    const struct huffman_symbol_t *r_p;
+
+    l_p = (const struct huffman_symbol_t *)left_p;
+    r_p = (const struct huffman_symbol_t *)right_p;
+
+    if (l_p->frequency != r_p->frequency) {
+        return ((l_p->frequency > r_p->frequency) ? 1 : -1);
+    }
+
+    return ((int)l_p->symbol - (int)r_p->symbol);
+}
+
+/* Moffat and Katajainen's in-place calculation of minimum redundancy
+   code lengths. Given frequencies must be sorted in increasing order
+   and are replaced by their code lengths. */
+static void huffman_minimum_redundancy(uint64_t *values_p, int length)
+{
+    int root;
+    int leaf;
+    int next;
+    int available;
+    int used;
+    int depth;
+
+    if (length == 1) {
+        values_p[0] = 1;
+
+        return;
+    }
+
+    /* Internal node weights, leaving parent pointers. */
+    values_p[0] += values_p[1];
+    root = 0;
+    leaf = 2;
+
+    for (next = 1; next < length - 1; next++) {
+        if ((leaf >= length) || (values_p[root] < values_p[leaf])) {
+            values_p[next] = values_p[root];
+            values_p[root++] = (uint64_t)next;
+        } else {
+            values_p[next] = values_p[leaf++];
+        }
+
+        if ((leaf >= length)
+            || ((root < next) && (values_p[root] < values_p[leaf]))) {
+            values_p[next] += values_p[root];
+            values_p[root++] = (uint64_t)next;
+        } else {
+            values_p[next] += values_p[leaf++];
+        }
+    }
+
+    /* Internal node depths. */
+    values_p[length - 2] = 0;
+
+    for (next = length - 3; next >= 0; next--) {
+        values_p[next] = (values_p[values_p[next]] + 1);
+    }
+
+    /* Leaf depths. */
+    available = 1;
+    used = 0;
+    depth = 0;
+    root = (length - 2);
+    next = (length - 1);
+
+    while (available > 0) {
+        while ((root >= 0) && ((int)values_p[root] == depth)) {
+            used++;
+            root--;
+        }
+
+        while (available > used) {
+            values_p[next--] = (uint64_t)depth;
+            available--;
+        }
+
+        available = (2 * used);
+        depth++;
+        used = 0;
+    }
+}
+
+int bitstream_huffman_lengths(uint8_t *lengths_p,
+                              const uint32_t *frequencies_p,
+                              int number_of_symbols,
+                              int max_length)
+{
+    struct huffman_symbol_t symbols[BITSTREAM_HUFFMAN_MAX_SYMBOLS];
+    uint64_t values[BITSTREAM_HUFFMAN_MAX_SYMBOLS];
+    int counts[64];
+    uint32_t total;
+    int length;
+    int used;
+    int i;
+    int j;
+
+    if ((number_of_symbols < 0)
+        || (number_of_symbols > BITSTREAM_HUFFMAN_MAX_SYMBOLS)
+        || (max_length < 1)
+        || (max_length > BITSTREAM_HUFFMAN_MAX_LENGTH)) {
+        return (-EINVAL);
+    }
+
+    used = 0;
+
+    for (i = 0; i < number_of_symbols; i++) {
+        lengths_p[i] = 0;
+
+        if (frequencies_p[i] > 0) {
+            symbols[used].frequency = frequencies_p[i];
+            symbols[used].symbol = (uint16_t)i;
+            used++;
+        }
+    }
+
+    if (used == 0) {
         return (0);
     }
 
-    /* Align beginning. */
-    first_byte_bits = (8 - self_p->bit_offset);
+    if (used > (1 << max_length)) {
+        return (-EINVAL);
+    }
+
+    qsort(&symbols[0], (size_t)used, sizeof(symbols[0]), huffman_compare_symbols);
+
+    for (i = 0; i < used; i++) {
+        values[i] = symbols[i].frequency;
+    }
+
+    huffman_minimum_redundancy(&values[0], used);
+
+    /* Limit the lengths by moving the longest codes up to the maximum
+       length and then splitting shorter leaves until the Kraft sum is
+       one again. */
+    memset(&counts[0], 0, sizeof(counts));
+
+    for (i = 0; i < used; i++) {
+        length = (int)values[i];
+
+        if (length > max_length) {
+            length = max_length;
+        }
+
+        counts[length]++;
+    }
+
+    total = 0;
+
+    for (i = 1; i <= max_length; i++) {
+        total += ((uint32_t)counts[i] << (max_length - i));
+    }
+
+    while (total > (1u << max_length)) {
+        counts[max_length]--;
+
+        for (i = max_length - 1; i > 0; i--) {
+            if (counts[i] > 0) {
+                counts[i]--;
+                counts[i + 1] += 2;
+                break;
+            }
+        }
+
+        total--;
+    }
+
+    /* Shortest codes to the most frequent symbols. */
+    j = (used - 1);
+
+    for (length = 1; length <= max_length; length++) {
+        for (i = 0; i < counts[length]; i++) {
+            lengths_p[symbols[j--].symbol] = (uint8_t)length;
+        }
+    }
+
+    return (0);
+}
+
+int bitstream_huffman_init(struct bitstream_huffman_t *self_p,
+                           const uint8_t *lengths_p,
+                           int number_of_symbols)
+{
+    uint8_t subtable_bits[1 << BITSTREAM_HUFFMAN_ROOT_BITS];
+    int counts[BITSTREAM_HUFFMAN_MAX_LENGTH + 1];
+    int next_code[BITSTREAM_HUFFMAN_MAX_LENGTH + 1];
+    uint32_t *entry_p;
+    uint32_t entry;
+    int32_t left;
+    int symbol;
+    int length;
+    int prefix;
+    int offset;
+    int bits;
+    int code;
+    int i;
+
+    if ((number_of_symbols < 0)
+        || (number_of_symbols > BITSTREAM_HUFFMAN_MAX_SYMBOLS)) {
+        return (-EINVAL);
+    }
+
+    memset(&counts[0], 0, sizeof(counts));
+
+    for (symbol = 0; symbol < number_of_symbols; symbol++) {
+        if (lengths_p[symbol] > BITSTREAM_HUFFMAN_MAX_LENGTH) {
+            return (-EINVAL);
+        }
+
+        counts[lengths_p[symbol]]++;
+    }
+
+    /* Oversubscribed? Incomplete codes are accepted, as a code with a
+       single symbol is. */
+    left = 1;
+
+    for (length = 1; length <= BITSTREAM_HUFFMAN_MAX_LENGTH; length++) {
+        left = (2 * left - counts[length]);
+
+        if (left < 0) {
+            return (-EINVAL);
+        }
+    }
+
+    /* Canonical codes. */
+    code = 0;
+    counts[0] = 0;
+
+    for (length = 1; length <= BITSTREAM_HUFFMAN_MAX_LENGTH; length++) {
+        code = ((code + counts[length - 1]) << 1);
+        next_code[length] = code;
+    }
+
+    self_p->number_of_symbols = number_of_symbols;
+
+    for (symbol = 0; symbol < number_of_symbols; symbol++) {
+        length = lengths_p[symbol];
+        self_p->lengths[symbol] = (uint8_t)length;
 
-    if (first_byte_bits != 8) {
-        if (number_of_bits < first_byte_bits) {
-            value = (self_p->buf_p[self_p->byte_offset] >> (first_byte_bits
-                                                            - number_of_bits));
-            value &= ((1 << number_of_bits) - 1);
-            self_p->bit_offset += number_of_bits;
+        if (length == 0) {
+            self_p->codes[symbol] = 0;
         } else {
-            value = self_p->buf_p[self_p->byte_offset];
-            value &= ((1 << first_byte_bits) - 1);
-            self_p->byte_offset++;
-            self_p->bit_offset = 0;
+            self_p->codes[symbol] = (uint16_t)next_code[length]++;
         }
+    }
 
-        number_of_bits -= first_byte_bits;
+    /* Subtable sizes, given by the longest code of each root
+       prefix. */
+    memset(&subtable_bits[0], 0, sizeof(subtable_bits));
 
-        if (number_of_bits <= 0) {
-            return (value);
+    for (symbol = 0; symbol < number_of_symbols; symbol++) {
+        length = self_p->lengths[symbol];
+
+        if (length > BITSTREAM_HUFFMAN_ROOT_BITS) {
+            bits = (length - BITSTREAM_HUFFMAN_ROOT_BITS);
+            prefix = (self_p->codes[symbol] >> bits);
+
+            if (bits > subtable_bits[prefix]) {
+                subtable_bits[prefix] = (uint8_t)bits;
+            }
         }
-    } else {
-        value = 0;
     }
 
-    /* Copy middle bytes. */
-    full_bytes = (number_of_bits / 8);
+    /* Empty entries have length zero and are invalid codes. */
+    memset(&self_p->table[0], 0, sizeof(self_p->table));
+    offset = (1 << BITSTREAM_HUFFMAN_ROOT_BITS);
 
-    for (i = 0; i < full_bytes; i++) {
-        value <<= 8;
-        value |= self_p->buf_p[self_p->byte_offset + i];
+    for (prefix = 0; prefix < (1 << BITSTREAM_HUFFMAN_ROOT_BITS); prefix++) {
+        bits = subtable_bits[prefix];
+
+        if (bits > 0) {
+            if ((offset + (1 << bits)) > BITSTREAM_HUFFMAN_TABLE_SIZE) {
+                return (-EINVAL);
+            }
+
+            self_p->table[prefix] = (HUFFMAN_SUBTABLE
+                                     | ((uint32_t)bits << 16)
+                                     | (uint32_t)offset);
+            offset += (1 << bits);
+        }
     }
 
-    /* Last byte. */
-    last_byte_bits = (number_of_bits % 8);
+    for (symbol = 0; symbol < number_of_symbols; symbol++) {
+        length = self_p->lengths[symbol];
+        code = self_p->codes[symbol];
+
+        if (length == 0) {
+            continue;
+        }
+
+        if (length <= BITSTREAM_HUFFMAN_ROOT_BITS) {
+            entry_p = &self_p->table[code << (BITSTREAM_HUFFMAN_ROOT_BITS
+                                              - length)];
+            bits = (BITSTREAM_HUFFMAN_ROOT_BITS - length);
+        } else {
+            length -= BITSTREAM_HUFFMAN_ROOT_BITS;
+            entry = self_p->table[code >> length];
+            bits = (int)((entry >> 16) & 0xff);
+            code &= ((1 << length) - 1);
+            entry_p = &self_p->table[(entry & 0xffff)
+                                     + (code << (bits - length))];
+            bits -= length;
+        }
+
+        entry = (((uint32_t)length << 16) | (uint32_t)symbol);
 
-    if (last_byte_bits != 0) {
-        value <<= last_byte_bits;
-        value |= (self_p->buf_p[self_p->byte_offset + full_bytes]
-                  >> (8 - last_byte_bits));
-        self_p->bit_offset = last_byte_bits;
+        for (i = 0; i < (1 << bits); i++) {
+            entry_p[i] = entry;
+        }
     }
 
-    self_p->byte_offset += full_bytes;
+    return (0);
+}
 
-    return (value);
+void bitstream_huffman_write_symbol(struct bitstream_huffman_t *self_p,
+                                    struct bitstream_fast_writer_t *writer_p,
+                                    int symbol)
+{
+    bitstream_fast_writer_write_u64_bits(writer_p,
+                                         self_p->codes[symbol],
+                                         self_p->lengths[symbol]);
 }
 
-void bitstream_reader_seek(struct bitstream_reader_t *self_p,
-                           int offset)
+int bitstream_huffman_read_symbol(struct bitstream_huffman_t *self_p,
+                                  struct bitstream_fast_reader_t *reader_p)
 {
-    offset += ((8 * self_p->byte_offset) + self_p->bit_offset);
-    self_p->byte_offset = (offset / 8);
-    self_p->bit_offset = (offset % 8);
+    uint32_t entry;
+    int bits;
+    int length;
+
+    bits = (int)bitstream_fast_reader_peek_u64_bits(
+        reader_p,
+        BITSTREAM_HUFFMAN_MAX_LENGTH);
+    entry = self_p->table[bits >> HUFFMAN_SUBTABLE_BITS];
+
+    if (entry & HUFFMAN_SUBTABLE) {
+        length = (int)((entry >> 16) & 0xff);
+        entry = self_p->table[(entry & 0xffff)
+                              + ((bits >> (HUFFMAN_SUBTABLE_BITS - length))
+                                 & ((1 << length) - 1))];
+        length = (int)(entry >> 16);
+
+        if (length == 0) {
+            return (-EPROTO);
+        }
+
+        length += BITSTREAM_HUFFMAN_ROOT_BITS;
+    } else {
+        length = (int)(entry >> 16);
+
+        if (length == 0) {
+            return (-EPROTO);
+        }
+    }
+
+    bitstream_fast_reader_skip_bits(reader_p, length);
+
+    return ((int)(entry & 0xffff));
 }
 
-int bitstream_reader_tell(struct bitstream_reader_t *self_p)
+/* Codes are collected into words of up to 56 bits, so there is one
+   writer call per four to six symbols. */
+void bitstream_huffman_encode(struct bitstream_huffman_t *self_p,
+                              struct bitstream_fast_writer_t *writer_p,
+                              const uint16_t *symbols_p,
+                              int number_of_symbols)
 {
-    return ((8 * self_p->byte_offset) + self_p->bit_offset);
+    uint64_t value;
+    int number_of_bits;
+    int length;
+    int i;
+
+    value = 0;
+    number_of_bits = 0;
+
+    for (i = 0; i < number_of_symbols; i++) {
+        length = self_p->lengths[symbols_p[i]];
+
+        if ((number_of_bits + length) > 56) {
+            bitstream_fast_writer_write_u64_bits(writer_p,
+                                                 value,
+                                                 number_of_bits);
+            value = 0;
+            number_of_bits = 0;
+        }
+
+        value <<= length;
+        value |= self_p->codes[symbols_p[i]];
+        number_of_bits += length;
+    }
+
+    bitstream_fast_writer_write_u64_bits(writer_p, value, number_of_bits);
+}
+
+int bitstream_huffman_decode(struct bitstream_huffman_t *self_p,
+                             struct bitstream_fast_reader_t *reader_p,
+                             uint16_t *symbols_p,
+                             int number_of_symbols)
+{
+    int symbol;
+    int i;
+
+    for (i = 0; i < number_of_symbols; i++) {
+        symbol = bitstream_huffman_read_symbol(self_p, reader_p);
+
+        if (symbol < 0) {
+            return (symbol);
+        }
+
+        symbols_p[i] = (uint16_t)symbol;
+    }
+
+    return (0);
 }
@@ -0,0 +1,167 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Erik Moqvist
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include "bitstream.h"
+
+struct worker_t {
+    pthread_t thread;
+    int started;
+    struct bitstream_fast_writer_t writer;
+    uint8_t *buf_p;
+    size_t size;
+    int begin;
+    int end;
+    bitstream_encode_record_t encode;
+    void *arg_p;
+    uint64_t *offsets_p;
+    int res;
+};
+
+/* Encode records from begin to end into the worker's slice of the
+   workspace, with offsets relative to the start of the slice. The
+   writer never writes past its slice, but sets the overflow flag. */
+static void *worker_main(void *arg_p)
+{
+    struct worker_t *self_p;
+    int i;
+
+    self_p = (struct worker_t *)arg_p;
+    bitstream_fast_writer_init(&self_p->writer, self_p->buf_p, self_p->size);
+    self_p->res = 0;
+
+    for (i = self_p->begin; i < self_p->end; i++) {
+        self_p->offsets_p[i] = bitstream_fast_writer_size_in_bits(
+            &self_p->writer);
+        self_p->res = self_p->encode(&self_p->writer, self_p->arg_p, i);
+
+        if (self_p->res != 0) {
+            break;
+        }
+
+        if (bitstream_fast_writer_overflow(&self_p->writer)) {
+            self_p->res = -ENOSPC;
+            break;
+        }
+    }
+
+    if (self_p->res == 0) {
+        bitstream_fast_writer_flush(&self_p->writer);
+
+        if (bitstream_fast_writer_overflow(&self_p->writer)) {
+            self_p->res = -ENOSPC;
+        }
+    }
+
+    return (NULL);
+}
+
+int bitstream_fast_writer_write_parallel(
+    struct bitstream_fast_writer_t *self_p,
+    int number_of_records,
+    bitstream_encode_record_t encode,
+    void *arg_p,
+    uint64_t *offsets_p,
+    int number_of_threads,
+    uint8_t *workspace_p,
+    size_t workspace_size)
+{
+    struct worker_t workers[BITSTREAM_PARALLEL_MAX_THREADS];
+    struct worker_t *worker_p;
+    size_t slice_size;
+    uint64_t offset;
+    int i;
+    int j;
+
+    if ((number_of_records < 0)
+        || (number_of_threads < 1)
+        || (number_of_threads > BITSTREAM_PARALLEL_MAX_THREADS)) {
+        return (-EINVAL);
+    }
+
+    if (number_of_threads > number_of_records) {
+        number_of_threads = (number_of_records > 0 ? number_of_records : 1);
+    }
+
+    slice_size = (workspace_size / (size_t)number_of_threads);
+
+    for (i = 0; i < number_of_threads; i++) {
+        worker_p = &workers[i];
+        worker_p->buf_p = &workspace_p[i * slice_size];
+        worker_p->size = slice_size;
+        worker_p->begin = (int)(((int64_t)number_of_records * i)
+                                / number_of_threads);
+        worker_p->end = (int)(((int64_t)number_of_records * (i + 1))
+                              / number_of_threads);
+        worker_p->encode = encode;
+        worker_p->arg_p = arg_p;
+        worker_p->offsets_p = offsets_p;
+        worker_p->started = 0;
+    }
+
+    /* The calling thread encodes the first slice. Slices for which no
+       thread could be created are encoded by the calling thread as
+       well. */
+    for (i = 1; i < number_of_threads; i++) {
+        worker_p = &workers[i];
+        worker_p->started = (pthread_create(&worker_p->thread,
+                                            NULL,
+                                            worker_main,
+                                            worker_p) == 0);
+    }
+
+    worker_main(&workers[0]);
+
+    for (i = 1; i < number_of_threads; i++) {
+        worker_p = &workers[i];
+
+        if (worker_p->started) {
+            pthread_join(worker_p->thread, NULL);
+        } else {
+            worker_main(worker_p);
+        }
+    }
+
+    for (i = 0; i < number_of_threads; i++) {
+        if (workers[i].res != 0) {
+            return (workers[i].res);
+        }
+    }
+
+    for (i = 0; i < number_of_threads; i++) {
+        worker_p = &workers[i];
+        offset = bitstream_fast_writer_size_in_bits(self_p);
+
+        for (j = worker_p->begin; j < worker_p->end; j++) {
+            offsets_p[j] += offset;
+        }
+
+        bitstream_fast_writer_append(self_p, &worker_p->writer);
+    }
+
+    return (0);
+}
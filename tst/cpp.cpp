@@ -0,0 +1,117 @@
+#include "bitstream.hpp"
+#include "cpp.h"
+
+using namespace bitstream;
+
+/* 5 + 64 + 13 + 33 = 115 bits, unrolled field by field. */
+using LongLayout = Layout<5, 64, 13, 33>;
+
+/* 1 + 3 + 12 + 7 + 20 = 43 bits, one field split with shifts. */
+using ShortLayout = Layout<1, 3, 12, 7, 20>;
+
+static_assert(LongLayout::number_of_fields == 4);
+static_assert(LongLayout::number_of_bits == 115);
+static_assert(ShortLayout::number_of_bits == 43);
+static_assert(std::is_same<uint_t<7>, uint8_t>::value);
+static_assert(std::is_same<uint_t<9>, uint16_t>::value);
+static_assert(std::is_same<uint_t<32>, uint32_t>::value);
+static_assert(std::is_same<uint_t<33>, uint64_t>::value);
+static_assert(mask<12>() == 0xfff);
+
+template<typename TWriter>
+static void write(TWriter& writer)
+{
+    writer.template write<1>(1);
+    writer.template write<3>(5);
+    writer.template write<8>(0xab);
+    writer.template write<12>(0xf123);
+    writer.template write<16>(0x4567);
+    writer.template write<32>(0x89abcdef);
+    writer.template write<64>(0x0123456789abcdefull);
+    writer.template write<7>(0x55);
+}
+
+template<typename TReader>
+static void read(TReader& reader, uint64_t *values_p)
+{
+    values_p[0] = reader.template read<1>();
+    values_p[1] = reader.template read<3>();
+    values_p[2] = reader.template read<8>();
+    values_p[3] = reader.template read<12>();
+    values_p[4] = reader.template read<16>();
+    values_p[5] = reader.template read<32>();
+    values_p[6] = reader.template read<64>();
+    values_p[7] = reader.template read<7>();
+}
+
+int cpp_write(uint8_t *buf_p, size_t size, int fast)
+{
+    if (fast) {
+        FastWriter writer(buf_p, size);
+
+        write(writer);
+        writer.flush();
+
+        return ((int)writer.size_in_bits());
+    } else {
+        Writer writer(buf_p);
+
+        write(writer);
+
+        return (writer.size_in_bits());
+    }
+}
+
+void cpp_read(const uint8_t *buf_p, size_t size, int fast, uint64_t *values_p)
+{
+    if (fast) {
+        FastReader reader(buf_p, size);
+
+        read(reader, values_p);
+    } else {
+        Reader reader(buf_p);
+
+        read(reader, values_p);
+    }
+}
+
+int cpp_layout_encode(uint8_t *buf_p,
+                      size_t size,
+                      int fast,
+                      const uint64_t *values_p)
+{
+    if (fast) {
+        FastWriter writer(buf_p, size);
+
+        ShortLayout::encode(writer, &values_p[0]);
+        LongLayout::encode(writer, &values_p[5]);
+        writer.flush();
+
+        return ((int)writer.size_in_bits());
+    } else {
+        Writer writer(buf_p);
+
+        ShortLayout::encode(writer, &values_p[0]);
+        LongLayout::encode(writer, &values_p[5]);
+
+        return (writer.size_in_bits());
+    }
+}
+
+void cpp_layout_decode(const uint8_t *buf_p,
+                       size_t size,
+                       int fast,
+                       uint64_t *values_p)
+{
+    if (fast) {
+        FastReader reader(buf_p, size);
+
+        ShortLayout::decode(reader, &values_p[0]);
+        LongLayout::decode(reader, &values_p[5]);
+    } else {
+        Reader reader(buf_p);
+
+        ShortLayout::decode(reader, &values_p[0]);
+        LongLayout::decode(reader, &values_p[5]);
+    }
+}
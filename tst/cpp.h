@@ -0,0 +1,30 @@
+#ifndef CPP_H
+#define CPP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* C++ front end test helpers, implemented in cpp.cpp. */
+int cpp_write(uint8_t *buf_p, size_t size, int fast);
+
+void cpp_read(const uint8_t *buf_p, size_t size, int fast, uint64_t *values_p);
+
+int cpp_layout_encode(uint8_t *buf_p,
+                      size_t size,
+                      int fast,
+                      const uint64_t *values_p);
+
+void cpp_layout_decode(const uint8_t *buf_p,
+                       size_t size,
+                       int fast,
+                       uint64_t *values_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
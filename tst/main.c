@@ -1,6 +1,15 @@
+#include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "nala.h"
 #include "bitstream.h"
+#include "cpp.h"
+
+static int get_bit(const uint8_t *buf_p, int bit_offset)
+{
+    return ((buf_p[bit_offset / 8] >> (7 - bit_offset % 8)) & 1);
+}
 
 TEST(write_bit)
 {
@@ -50,6 +59,188 @@ TEST(write_bytes)
     ASSERT_MEMORY_EQ(&buf[0], "\x12\xf8\x80", 4);
 }
 
+TEST(write_bits)
+{
+    struct bitstream_writer_t writer;
+    uint8_t buf[4];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_writer_write_bit(&writer, 1);
+    bitstream_writer_write_bits(&writer, (uint8_t *)"\x81\xff\xa0", 19);
+    bitstream_writer_write_bits(&writer, (uint8_t *)"\x80", 1);
+    bitstream_writer_write_bits(&writer, (uint8_t *)"\xff", 0);
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 21);
+    ASSERT_MEMORY_EQ(&buf[0], "\xc0\xff\xd8", 3);
+}
+
+TEST(writer_append)
+{
+    struct bitstream_writer_t writer;
+    struct bitstream_writer_t other;
+    uint8_t buf[128];
+    uint8_t other_buf[64];
+    int offset;
+    int size;
+    int i;
+
+    for (offset = 0; offset < 8; offset++) {
+        for (size = 0; size < 300; size += 7) {
+            memset(&buf[0], 0xff, sizeof(buf));
+            memset(&other_buf[0], 0xff, sizeof(other_buf));
+            bitstream_writer_init(&other, &other_buf[0]);
+
+            for (i = 0; i < size; i++) {
+                bitstream_writer_write_bit(&other, (i % 3) == 0);
+            }
+
+            bitstream_writer_init(&writer, &buf[0]);
+            bitstream_writer_write_repeated_bit(&writer, 1, offset);
+            bitstream_writer_append(&writer, &other);
+            bitstream_writer_write_bit(&writer, 1);
+            ASSERT_EQ(bitstream_writer_size_in_bits(&writer),
+                      offset + size + 1);
+
+            for (i = 0; i < offset; i++) {
+                ASSERT_EQ(get_bit(&buf[0], i), 1);
+            }
+
+            for (i = 0; i < size; i++) {
+                ASSERT_EQ(get_bit(&buf[0], offset + i), (i % 3) == 0);
+            }
+
+            for (i = offset + size + 1; i % 8 != 0; i++) {
+                ASSERT_EQ(get_bit(&buf[0], i), 0);
+            }
+        }
+    }
+}
+
+static int encode_record(struct bitstream_fast_writer_t *writer_p,
+                         void *arg_p,
+                         int index)
+{
+    int i;
+
+    if (arg_p != NULL && index == *(int *)arg_p) {
+        return (-EPROTO);
+    }
+
+    bitstream_fast_writer_write_u64_bits(writer_p, index & 0x7, 3);
+
+    for (i = 0; i < index % 5; i++) {
+        bitstream_fast_writer_write_u8(writer_p, (uint8_t)(index + i));
+    }
+
+    return (0);
+}
+
+TEST(fast_writer_write_parallel)
+{
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_fast_writer_t expected_writer;
+    uint8_t buf[4096];
+    uint8_t expected_buf[4096];
+    uint8_t workspace[8192];
+    uint64_t offsets[1000];
+    uint64_t expected_offsets[1000];
+    int numbers_of_threads[] = { 1, 2, 3, 8, 64 };
+    int number_of_records;
+    int i;
+    int j;
+
+    for (number_of_records = 0; number_of_records < 1000;
+         number_of_records += 333) {
+        bitstream_fast_writer_init(&expected_writer,
+                                   &expected_buf[0],
+                                   sizeof(expected_buf));
+        bitstream_fast_writer_write_bit(&expected_writer, 1);
+
+        for (i = 0; i < number_of_records; i++) {
+            expected_offsets[i] =
+                bitstream_fast_writer_size_in_bits(&expected_writer);
+            ASSERT_EQ(encode_record(&expected_writer, NULL, i), 0);
+        }
+
+        bitstream_fast_writer_flush(&expected_writer);
+
+        for (j = 0; j < 5; j++) {
+            bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+            bitstream_fast_writer_write_bit(&writer, 1);
+            ASSERT_EQ(bitstream_fast_writer_write_parallel(
+                          &writer,
+                          number_of_records,
+                          encode_record,
+                          NULL,
+                          &offsets[0],
+                          numbers_of_threads[j],
+                          &workspace[0],
+                          sizeof(workspace)),
+                      0);
+            bitstream_fast_writer_flush(&writer);
+            ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer),
+                      bitstream_fast_writer_size_in_bits(&expected_writer));
+            ASSERT_MEMORY_EQ(&buf[0],
+                             &expected_buf[0],
+                             bitstream_fast_writer_size_in_bytes(&writer));
+            ASSERT_MEMORY_EQ(&offsets[0],
+                             &expected_offsets[0],
+                             sizeof(offsets[0]) * number_of_records);
+            ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+        }
+    }
+}
+
+TEST(fast_writer_write_parallel_errors)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[4096];
+    uint8_t workspace[4096];
+    uint64_t offsets[1000];
+    int index;
+    int i;
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    index = 600;
+    ASSERT_EQ(bitstream_fast_writer_write_parallel(&writer,
+                                                   1000,
+                                                   encode_record,
+                                                   &index,
+                                                   &offsets[0],
+                                                   4,
+                                                   &workspace[0],
+                                                   sizeof(workspace)),
+              -EPROTO);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 0);
+
+    /* Records longer than the slices are not written past them. */
+    memset(&workspace[0], 0xa5, sizeof(workspace));
+    ASSERT_EQ(bitstream_fast_writer_write_parallel(&writer,
+                                                   1000,
+                                                   encode_record,
+                                                   NULL,
+                                                   &offsets[0],
+                                                   4,
+                                                   &workspace[0],
+                                                   1000),
+              -ENOSPC);
+
+    for (i = 1000; i < (int)sizeof(workspace); i++) {
+        ASSERT_EQ(workspace[i], 0xa5);
+    }
+
+    ASSERT_EQ(bitstream_fast_writer_write_parallel(&writer,
+                                                   1000,
+                                                   encode_record,
+                                                   NULL,
+                                                   &offsets[0],
+                                                   0,
+                                                   &workspace[0],
+                                                   sizeof(workspace)),
+              -EINVAL);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 0);
+}
+
 TEST(write_u8)
 {
     struct bitstream_writer_t writer;
@@ -510,6 +701,558 @@ TEST(writer_seek)
     ASSERT_MEMORY_EQ(&buf[0], "\xff\x20\xef\xef", 4);
 }
 
+static void write_pattern(struct bitstream_writer_t *writer_p,
+                          uint8_t *buf_p,
+                          int size,
+                          uint8_t *bits_p)
+{
+    int i;
+
+    memset(buf_p, 0xff, 64);
+    bitstream_writer_init(writer_p, buf_p);
+
+    for (i = 0; i < size; i++) {
+        bits_p[i] = (((i * 7) % 5) < 2);
+        bitstream_writer_write_bit(writer_p, bits_p[i]);
+    }
+}
+
+TEST(writer_insert_zero_bits)
+{
+    struct bitstream_writer_t writer;
+    uint8_t buf[64];
+    uint8_t bits[512];
+    int sizes[] = { 0, 1, 7, 8, 13, 64, 137, 250 };
+    int numbers_of_bits[] = { 0, 1, 5, 8, 9, 16, 63, 130 };
+    int size;
+    int number_of_bits;
+    int bit_offset;
+    int i;
+    int j;
+    int k;
+
+    for (i = 0; i < 8; i++) {
+        size = sizes[i];
+
+        for (j = 0; j < 8; j++) {
+            number_of_bits = numbers_of_bits[j];
+
+            for (bit_offset = 0; bit_offset <= size; bit_offset++) {
+                write_pattern(&writer, &buf[0], size, &bits[0]);
+                bitstream_writer_insert_zero_bits(&writer,
+                                                  bit_offset,
+                                                  number_of_bits);
+                ASSERT_EQ(bitstream_writer_size_in_bits(&writer),
+                          size + number_of_bits);
+                bitstream_writer_write_bit(&writer, 1);
+
+                for (k = 0; k < bit_offset; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], k), bits[k]);
+                }
+
+                for (k = 0; k < number_of_bits; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], bit_offset + k), 0);
+                }
+
+                for (k = bit_offset; k < size; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], k + number_of_bits), bits[k]);
+                }
+
+                ASSERT_EQ(get_bit(&buf[0], size + number_of_bits), 1);
+
+                for (k = size + number_of_bits + 1; k % 8 != 0; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], k), 0);
+                }
+            }
+        }
+    }
+}
+
+TEST(writer_delete_bits)
+{
+    struct bitstream_writer_t writer;
+    uint8_t buf[64];
+    uint8_t bits[512];
+    int sizes[] = { 0, 1, 7, 8, 13, 64, 137, 250 };
+    int numbers_of_bits[] = { 0, 1, 5, 8, 9, 16, 63, 130 };
+    int size;
+    int number_of_bits;
+    int bit_offset;
+    int i;
+    int j;
+    int k;
+
+    for (i = 0; i < 8; i++) {
+        size = sizes[i];
+
+        for (j = 0; j < 8; j++) {
+            number_of_bits = numbers_of_bits[j];
+
+            for (bit_offset = 0;
+                 bit_offset + number_of_bits <= size;
+                 bit_offset++) {
+                write_pattern(&writer, &buf[0], size, &bits[0]);
+                bitstream_writer_delete_bits(&writer,
+                                             bit_offset,
+                                             number_of_bits);
+                ASSERT_EQ(bitstream_writer_size_in_bits(&writer),
+                          size - number_of_bits);
+                bitstream_writer_write_bit(&writer, 1);
+
+                for (k = 0; k < bit_offset; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], k), bits[k]);
+                }
+
+                for (k = bit_offset + number_of_bits; k < size; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], k - number_of_bits), bits[k]);
+                }
+
+                ASSERT_EQ(get_bit(&buf[0], size - number_of_bits), 1);
+
+                for (k = size - number_of_bits + 1; k % 8 != 0; k++) {
+                    ASSERT_EQ(get_bit(&buf[0], k), 0);
+                }
+            }
+        }
+    }
+}
+
+TEST(fast_writer_write_bit)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 1);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x80", 1);
+
+    bitstream_fast_writer_write_bit(&writer, 0);
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_bit(&writer, 0);
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_bit(&writer, 0);
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_bit(&writer, 0);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 1);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\xaa", 1);
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 2);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\xaa\x80", 2);
+}
+
+TEST(fast_writer_write_bytes)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_write_bytes(&writer, (uint8_t *)"\x12", 1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 1);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12", 1);
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_bytes(&writer, (uint8_t *)"\xf1\x00", 2);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 4);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12\xf8\x80\x00", 4);
+
+    bitstream_fast_writer_write_bytes(
+        &writer,
+        (uint8_t *)"\x01\x02\x03\x04\x05\x06\x07\x08\x09",
+        9);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 13);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0],
+                     "\x12\xf8\x80\x00\x81\x01\x82\x02\x83\x03\x84\x04\x80",
+                     13);
+
+    bitstream_fast_writer_write_u64_bits(&writer, 0x7f, 7);
+    bitstream_fast_writer_write_bytes(&writer, (uint8_t *)"\x55\xaa", 2);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 15);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0],
+                     "\x12\xf8\x80\x00\x81\x01\x82\x02\x83\x03\x84\x04\xff"
+                     "\x55\xaa",
+                     15);
+}
+
+TEST(fast_writer_write_u8)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_write_u8(&writer, 0x12);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 1);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12", 1);
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_u8(&writer, 0xf1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 3);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12\xf8\x80", 3);
+}
+
+TEST(fast_writer_write_u16)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_write_u16(&writer, 0x1234);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 2);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12\x34", 2);
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_u16(&writer, 0xf1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 5);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12\x34\x80\x78\x80", 5);
+}
+
+TEST(fast_writer_write_u32)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_write_u32(&writer, 0x12345678);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 4);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12\x34\x56\x78", 4);
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_u32(&writer, 0xf1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 9);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x12\x34\x56\x78\x80\x00\x00\x78\x80", 9);
+}
+
+TEST(fast_writer_write_u64)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_write_u64(&writer, 0x0123456789abcdefll);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 8);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x01\x23\x45\x67\x89\xab\xcd\xef", 8);
+
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_u64(&writer, 0xf1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 17);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(
+        &buf[0],
+        "\x01\x23\x45\x67\x89\xab\xcd\xef\x80\x00\x00\x00\x00\x00\x00\x78\x80",
+        17);
+}
+
+TEST(fast_writer_write_u64_bits_all_offsets)
+{
+    struct bitstream_fast_writer_t fast_writer;
+    struct bitstream_writer_t writer;
+    uint8_t fast_buf[128];
+    uint8_t buf[128];
+    uint64_t value;
+    int offset;
+    int number_of_bits;
+    int i;
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 64; number_of_bits++) {
+            memset(&buf[0], 0, sizeof(buf));
+            memset(&fast_buf[0], 0, sizeof(fast_buf));
+            bitstream_writer_init(&writer, &buf[0]);
+            bitstream_fast_writer_init(&fast_writer,
+                                       &fast_buf[0],
+                                       sizeof(fast_buf));
+            bitstream_writer_write_u64_bits(&writer, 0x5a, offset);
+            bitstream_fast_writer_write_u64_bits(&fast_writer, 0x5a, offset);
+            value = 0x0123456789abcdefull;
+
+            for (i = 0; i < 14; i++) {
+                value = (value * 6364136223846793005ull + 1442695040888963407ull);
+
+                if (number_of_bits < 64) {
+                    value &= ((1ull << number_of_bits) - 1);
+                }
+
+                bitstream_writer_write_u64_bits(&writer, value, number_of_bits);
+                bitstream_fast_writer_write_u64_bits(&fast_writer,
+                                                     value,
+                                                     number_of_bits);
+            }
+
+            ASSERT_EQ(bitstream_fast_writer_size_in_bits(&fast_writer),
+                      bitstream_writer_size_in_bits(&writer));
+            bitstream_fast_writer_flush(&fast_writer);
+            ASSERT_MEMORY_EQ(&fast_buf[0], &buf[0], sizeof(buf));
+        }
+    }
+}
+
+TEST(fast_writer_seek)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[32];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    bitstream_fast_writer_seek(&writer, 1);
+    bitstream_fast_writer_write_u8(&writer, 0x00);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 9);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x80\x00\xff", 3);
+
+    bitstream_fast_writer_seek(&writer, -5);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 4);
+    bitstream_fast_writer_write_u64_bits(&writer, 0xf, 4);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x8f\x00\xff", 3);
+
+    bitstream_fast_writer_seek(&writer, 70);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 78);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x3, 2);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x8f\x00\xff\xff\xff\xff\xff\xff\xff\xff", 10);
+}
+
+TEST(fast_writer_overflow)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t buf[12];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_fast_writer_init(&writer, &buf[0], 10);
+
+    bitstream_fast_writer_write_u64(&writer, 0x0123456789abcdefll);
+    bitstream_fast_writer_write_u8(&writer, 0x11);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x3, 2);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+    ASSERT_MEMORY_EQ(&buf[0], "\x01\x23\x45\x67\x89\xab\xcd\xef\x11\xc0", 10);
+
+    bitstream_fast_writer_write_u64_bits(&writer, 0x3f, 6);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    /* Past the end, nothing is stored. */
+    bitstream_fast_writer_write_u64(&writer, 0);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 1);
+    bitstream_fast_writer_write_bytes(&writer, (uint8_t *)"\x00\x00", 2);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0],
+                     "\x01\x23\x45\x67\x89\xab\xcd\xef\x11\xff\xff\xff",
+                     12);
+
+    /* The flag is sticky. */
+    bitstream_fast_writer_seek(&writer, -80);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 1);
+}
+
+struct sink_t {
+    uint8_t buf[512];
+    size_t size;
+};
+
+static int sink_write(void *arg_p, const uint8_t *buf_p, size_t size)
+{
+    struct sink_t *sink_p;
+
+    sink_p = arg_p;
+    memcpy(&sink_p->buf[sink_p->size], buf_p, size);
+    sink_p->size += size;
+
+    return (0);
+}
+
+TEST(fast_writer_stream)
+{
+    struct bitstream_fast_writer_t stream_writer;
+    struct bitstream_fast_writer_t writer;
+    struct sink_t sink;
+    uint8_t buf[512];
+    uint8_t block[11];
+    uint8_t data[20];
+    uint64_t value;
+    int number_of_bits;
+    int i;
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (uint8_t)(31 * i + 3);
+    }
+
+    sink.size = 0;
+    bitstream_fast_writer_init_stream(&stream_writer,
+                                      &block[0],
+                                      sizeof(block),
+                                      sink_write,
+                                      &sink);
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    number_of_bits = 1;
+    value = 0x0123456789abcdefull;
+
+    while (bitstream_fast_writer_size_in_bits(&writer) < 8 * 400) {
+        value = (value * 6364136223846793005ull + 1442695040888963407ull);
+
+        if (number_of_bits < 64) {
+            value &= ((1ull << number_of_bits) - 1);
+        }
+
+        bitstream_fast_writer_write_u64_bits(&stream_writer,
+                                             value,
+                                             number_of_bits);
+        bitstream_fast_writer_write_u64_bits(&writer, value, number_of_bits);
+        bitstream_fast_writer_write_bytes(&stream_writer,
+                                          &data[0],
+                                          number_of_bits % 20);
+        bitstream_fast_writer_write_bytes(&writer,
+                                          &data[0],
+                                          number_of_bits % 20);
+        ASSERT_EQ(bitstream_fast_writer_size_in_bits(&stream_writer),
+                  bitstream_fast_writer_size_in_bits(&writer));
+
+        if ((number_of_bits % 5) == 0) {
+            bitstream_fast_writer_flush(&stream_writer);
+        }
+
+        number_of_bits = ((number_of_bits * 7) % 64) + 1;
+    }
+
+    /* Pad to a byte boundary before the final flush. */
+    i = (int)(8 - bitstream_fast_writer_size_in_bits(&writer) % 8) % 8;
+    bitstream_fast_writer_write_u64_bits(&stream_writer, 0, i);
+    bitstream_fast_writer_write_u64_bits(&writer, 0, i);
+    bitstream_fast_writer_flush(&stream_writer);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(sink.size, bitstream_fast_writer_size_in_bytes(&writer));
+    ASSERT_MEMORY_EQ(&sink.buf[0], &buf[0], sink.size);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&stream_writer), 0);
+}
+
+TEST(fast_writer_stream_seek)
+{
+    struct bitstream_fast_writer_t writer;
+    struct sink_t sink;
+    uint8_t block[16];
+    uint8_t expected[] = { 0x11, 0x22, 0x44, 0x55 };
+
+    /* Overwrite a byte still in the block. */
+    sink.size = 0;
+    bitstream_fast_writer_init_stream(&writer,
+                                      &block[0],
+                                      sizeof(block),
+                                      sink_write,
+                                      &sink);
+    bitstream_fast_writer_write_u8(&writer, 0x11);
+    bitstream_fast_writer_write_u8(&writer, 0x22);
+    bitstream_fast_writer_write_u8(&writer, 0x33);
+    bitstream_fast_writer_seek(&writer, -8);
+    bitstream_fast_writer_write_u8(&writer, 0x44);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(sink.size, 3);
+    ASSERT_MEMORY_EQ(&sink.buf[0], &expected[0], 3);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    /* The bytes are drained by the flush and can not be written
+       again. */
+    bitstream_fast_writer_seek(&writer, -8);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 24);
+    bitstream_fast_writer_write_u8(&writer, 0x55);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(sink.size, 4);
+    ASSERT_MEMORY_EQ(&sink.buf[0], &expected[0], 4);
+}
+
+TEST(fast_writer_sink_fd)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t block[16];
+    uint8_t buf[64];
+    int fds[2];
+    int i;
+
+    ASSERT_EQ(pipe(fds), 0);
+    bitstream_fast_writer_init_stream(&writer,
+                                      &block[0],
+                                      sizeof(block),
+                                      bitstream_fast_writer_sink_fd,
+                                      &fds[1]);
+    bitstream_fast_writer_write_u64_bits(&writer, 0, 4);
+
+    for (i = 0; i < 63; i++) {
+        bitstream_fast_writer_write_u8(&writer,
+                                       (uint8_t)((i << 4) | ((i + 1) >> 4)));
+    }
+
+    bitstream_fast_writer_write_u64_bits(&writer, 0xf, 4);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), 64);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+    close(fds[1]);
+
+    ASSERT_EQ(read(fds[0], &buf[0], sizeof(buf)), (ssize_t)sizeof(buf));
+    close(fds[0]);
+
+    for (i = 0; i < 64; i++) {
+        ASSERT_EQ(buf[i], i);
+    }
+}
+
+TEST(fast_writer_sink_file)
+{
+    struct bitstream_fast_writer_t writer;
+    uint8_t block[8];
+    uint8_t buf[32];
+    FILE *file_p;
+
+    file_p = tmpfile();
+    ASSERT_NE(file_p, NULL);
+    bitstream_fast_writer_init_stream(&writer,
+                                      &block[0],
+                                      sizeof(block),
+                                      bitstream_fast_writer_sink_file,
+                                      file_p);
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_u64(&writer, 0x0123456789abcdefull);
+    bitstream_fast_writer_write_u64(&writer, 0x0123456789abcdefull);
+    bitstream_fast_writer_write_u64_bits(&writer, 0, 7);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    rewind(file_p);
+    ASSERT_EQ(fread(&buf[0], 1, sizeof(buf), file_p), 17);
+    ASSERT_MEMORY_EQ(&buf[0],
+                     "\x80\x91\xa2\xb3\xc4\xd5\xe6\xf7\x80\x91\xa2\xb3\xc4\xd5"
+                     "\xe6\xf7\x80",
+                     17);
+    fclose(file_p);
+}
+
 TEST(read_bit)
 {
     struct bitstream_reader_t reader;
@@ -555,6 +1298,49 @@ TEST(read_bytes)
     ASSERT_MEMORY_EQ(&data[0], "\xf1", 1);
 }
 
+TEST(write_read_bytes_unaligned)
+{
+    struct bitstream_writer_t writer;
+    struct bitstream_reader_t reader;
+    uint8_t data[100];
+    uint8_t buf[110];
+    uint8_t read[101];
+    int offset;
+    int length;
+    int i;
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (uint8_t)(29 * i + 3);
+    }
+
+    for (offset = 1; offset < 8; offset++) {
+        for (length = 0; length <= 100; length++) {
+            memset(&buf[0], 0xff, sizeof(buf));
+            bitstream_writer_init(&writer, &buf[0]);
+            bitstream_writer_write_repeated_bit(&writer, 0, offset);
+            bitstream_writer_write_bytes(&writer, &data[0], length);
+            bitstream_writer_write_u8(&writer, 0xa5);
+            ASSERT_EQ(bitstream_writer_size_in_bits(&writer),
+                      offset + 8 * length + 8);
+            ASSERT_EQ(buf[length + 1] & (0xff >> offset), 0);
+
+            bitstream_reader_init(&reader, &buf[0]);
+            bitstream_reader_seek(&reader, offset);
+            read[length] = 0x5a;
+            bitstream_reader_read_bytes(&reader, &read[0], length);
+            ASSERT_MEMORY_EQ(&read[0], &data[0], length);
+            ASSERT_EQ(read[length], 0x5a);
+            ASSERT_EQ(bitstream_reader_read_u8(&reader), 0xa5);
+
+            bitstream_reader_init(&reader, &buf[0]);
+
+            for (i = 0; i < offset; i++) {
+                ASSERT_EQ(bitstream_reader_read_bit(&reader), 0);
+            }
+        }
+    }
+}
+
 TEST(read_u16)
 {
     struct bitstream_reader_t reader;
@@ -615,6 +1401,50 @@ TEST(read_u64_bits)
     ASSERT_EQ(bitstream_reader_read_u64_bits(&reader, 0), 0x0);
 }
 
+TEST(reader_peek_skip)
+{
+    struct bitstream_reader_t reader;
+    struct bitstream_reader_t reference;
+    uint8_t buf[64];
+    uint64_t value;
+    int i;
+    int offset;
+    int number_of_bits;
+    int skip;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(37 * i + 11);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 64; number_of_bits++) {
+            bitstream_reader_init(&reader, &buf[0]);
+            bitstream_reader_seek(&reader, offset);
+            bitstream_reader_init(&reference, &buf[0]);
+            bitstream_reader_seek(&reference, offset);
+
+            while (bitstream_reader_tell(&reader) + number_of_bits <= 8 * 55) {
+                value = bitstream_reader_read_u64_bits(&reference,
+                                                       number_of_bits);
+                ASSERT_EQ(bitstream_reader_peek_u64_bits(&reader,
+                                                         number_of_bits),
+                          value);
+                ASSERT_EQ(bitstream_reader_peek_u64_bits(&reader,
+                                                         number_of_bits),
+                          value);
+                skip = (1 + (int)(value % (uint64_t)number_of_bits));
+                bitstream_reader_skip_bits(&reader, skip);
+                bitstream_reader_seek(&reference, skip - number_of_bits);
+                ASSERT_EQ(bitstream_reader_tell(&reader),
+                          bitstream_reader_tell(&reference));
+            }
+        }
+    }
+
+    bitstream_reader_skip_bits(&reader, 0);
+    ASSERT_EQ(bitstream_reader_peek_u64_bits(&reader, 0), 0);
+}
+
 TEST(reader_seek)
 {
     struct bitstream_reader_t reader;
@@ -655,3 +1485,2338 @@ TEST(reader_tell)
     bitstream_reader_seek(&reader, -8);
     ASSERT_EQ(bitstream_reader_tell(&reader), 1);
 }
+
+TEST(fast_reader_read_bit)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = { 0xaa, 0x80 };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+
+    /* Zeros past the end. */
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 0);
+}
+
+TEST(fast_reader_read_u8)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = { 0x12, 0xf8, 0x80 };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0x12);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0xf1);
+}
+
+TEST(fast_reader_read_bytes)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = {
+        0x12, 0xf8, 0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+        0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c
+    };
+    uint8_t data[16];
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 1);
+    ASSERT_MEMORY_EQ(&data[0], "\x12", 1);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 1);
+    ASSERT_MEMORY_EQ(&data[0], "\xf1", 1);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 7), 0);
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 2);
+    ASSERT_MEMORY_EQ(&data[0], "\x00\x01", 2);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 4), 0);
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 9);
+    ASSERT_MEMORY_EQ(&data[0], "\x20\x30\x40\x50\x60\x70\x80\x90\xa0", 9);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 4), 0xb);
+
+    /* Zeros past the end. */
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 3);
+    ASSERT_MEMORY_EQ(&data[0], "\x0c\x00\x00", 3);
+}
+
+TEST(fast_reader_read_u16)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = { 0x12, 0x34, 0x80, 0x78, 0x80 };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    ASSERT_EQ(bitstream_fast_reader_read_u16(&reader), 0x1234);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_u16(&reader), 0xf1);
+}
+
+TEST(fast_reader_read_u32)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = { 0x12, 0x34, 0x56, 0x78, 0x80, 0x00, 0x00, 0x78, 0x80 };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    ASSERT_EQ(bitstream_fast_reader_read_u32(&reader), 0x12345678);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_u32(&reader), 0xf1);
+}
+
+TEST(fast_reader_read_u64)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x80, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x80
+    };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    ASSERT_EQ(bitstream_fast_reader_read_u64(&reader), 0x0123456789abcdefll);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_u64(&reader), 0xf1);
+}
+
+TEST(fast_reader_read_u64_bits)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = {
+        0x12, 0x34, 0x56, 0x78, 0x91, 0x23, 0x45, 0x67, 0x89, 0xaa,
+        0x55, 0x12
+    };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 36), 0x123456789ll);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 36), 0x123456789ll);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 1), 0x1);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 2), 0x1);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 5), 0xa);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 9), 0xaa);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 6), 0x9);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 1), 0x0);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 0), 0x0);
+}
+
+TEST(fast_reader_read_u64_bits_all_offsets)
+{
+    struct bitstream_fast_reader_t fast_reader;
+    struct bitstream_reader_t reader;
+    uint8_t buf[64];
+    int i;
+    int offset;
+    int number_of_bits;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(37 * i + 11);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 64; number_of_bits++) {
+            bitstream_reader_init(&reader, &buf[0]);
+            bitstream_reader_seek(&reader, offset);
+            bitstream_fast_reader_init(&fast_reader, &buf[0], sizeof(buf));
+            bitstream_fast_reader_seek(&fast_reader, offset);
+
+            while (bitstream_reader_tell(&reader) + number_of_bits <= 8 * 55) {
+                ASSERT_EQ(
+                    bitstream_fast_reader_read_u64_bits(&fast_reader,
+                                                        number_of_bits),
+                    bitstream_reader_read_u64_bits(&reader, number_of_bits));
+            }
+
+            ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader),
+                      bitstream_reader_tell(&reader));
+        }
+    }
+}
+
+TEST(fast_reader_peek_skip)
+{
+    struct bitstream_fast_reader_t reader;
+    struct bitstream_reader_t reference;
+    uint8_t buf[64];
+    uint64_t value;
+    int i;
+    int offset;
+    int number_of_bits;
+    int skip;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(37 * i + 11);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 56; number_of_bits++) {
+            bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+            bitstream_fast_reader_seek(&reader, offset);
+            bitstream_reader_init(&reference, &buf[0]);
+            bitstream_reader_seek(&reference, offset);
+
+            while (bitstream_reader_tell(&reference) + number_of_bits
+                   <= 8 * (int)sizeof(buf)) {
+                value = bitstream_reader_peek_u64_bits(&reference,
+                                                       number_of_bits);
+                ASSERT_EQ(bitstream_fast_reader_peek_u64_bits(&reader,
+                                                              number_of_bits),
+                          value);
+                skip = (1 + (int)(value % (uint64_t)number_of_bits));
+                bitstream_fast_reader_skip_bits(&reader, skip);
+                bitstream_reader_skip_bits(&reference, skip);
+                ASSERT_EQ(bitstream_fast_reader_tell(&reader),
+                          bitstream_reader_tell(&reference));
+            }
+
+            ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+        }
+    }
+
+    /* Zeros are peeked past the end without setting the overflow
+       flag, which is set when they are skipped. */
+    bitstream_fast_reader_init(&reader, &buf[0], 2);
+    bitstream_fast_reader_skip_bits(&reader, 4);
+    ASSERT_EQ(bitstream_fast_reader_peek_u64_bits(&reader, 16), 0xb300);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+    bitstream_fast_reader_skip_bits(&reader, 12);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+    bitstream_fast_reader_skip_bits(&reader, 1);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    /* Long skips. */
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_skip_bits(&reader, 3);
+    bitstream_fast_reader_skip_bits(&reader, 300);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 303);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader),
+              (uint8_t)((buf[37] << 7) | (buf[38] >> 1)));
+}
+
+TEST(exp_golomb_rice)
+{
+    uint8_t buf[5];
+    uint8_t fast_buf[5];
+    uint8_t expected[] = { 0xa6, 0x42, 0xa6, 0x42, 0xd4 };
+    struct bitstream_writer_t writer;
+    struct bitstream_fast_writer_t fast_writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+    uint32_t i;
+
+    memset(&buf[0], 0, sizeof(buf));
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_fast_writer_init(&fast_writer, &fast_buf[0], sizeof(fast_buf));
+
+    for (i = 0; i < 5; i++) {
+        bitstream_writer_write_ue(&writer, i);
+        bitstream_fast_writer_write_ue(&fast_writer, i);
+    }
+
+    bitstream_writer_write_se(&writer, 1);
+    bitstream_writer_write_se(&writer, -1);
+    bitstream_writer_write_se(&writer, 2);
+    bitstream_writer_write_se(&writer, -2);
+    bitstream_writer_write_se(&writer, 0);
+    bitstream_writer_write_rice(&writer, 5, 2);
+    bitstream_fast_writer_write_se(&fast_writer, 1);
+    bitstream_fast_writer_write_se(&fast_writer, -1);
+    bitstream_fast_writer_write_se(&fast_writer, 2);
+    bitstream_fast_writer_write_se(&fast_writer, -2);
+    bitstream_fast_writer_write_se(&fast_writer, 0);
+    bitstream_fast_writer_write_rice(&fast_writer, 5, 2);
+    bitstream_fast_writer_flush(&fast_writer);
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 38);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&fast_writer), 38);
+    ASSERT_MEMORY_EQ(&buf[0], &expected[0], sizeof(expected));
+    ASSERT_MEMORY_EQ(&fast_buf[0], &expected[0], sizeof(expected));
+
+    bitstream_reader_init(&reader, &buf[0]);
+    bitstream_fast_reader_init(&fast_reader, &buf[0], sizeof(buf));
+
+    for (i = 0; i < 5; i++) {
+        ASSERT_EQ(bitstream_reader_read_ue(&reader), i);
+        ASSERT_EQ(bitstream_fast_reader_read_ue(&fast_reader), i);
+    }
+
+    ASSERT_EQ(bitstream_reader_read_se(&reader), 1);
+    ASSERT_EQ(bitstream_reader_read_se(&reader), -1);
+    ASSERT_EQ(bitstream_reader_read_se(&reader), 2);
+    ASSERT_EQ(bitstream_reader_read_se(&reader), -2);
+    ASSERT_EQ(bitstream_reader_read_se(&reader), 0);
+    ASSERT_EQ(bitstream_reader_read_rice(&reader, 2), 5);
+    ASSERT_EQ(bitstream_reader_tell(&reader), 38);
+    ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), -1);
+    ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), 2);
+    ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), -2);
+    ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_rice(&fast_reader, 2), 5);
+    ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader), 38);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+}
+
+/* Largest codes and long quotients at all bit offsets. */
+TEST(exp_golomb_rice_limits)
+{
+    uint8_t buf[256];
+    uint8_t fast_buf[256];
+    struct bitstream_writer_t writer;
+    struct bitstream_fast_writer_t fast_writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+    int offset;
+
+    for (offset = 0; offset < 8; offset++) {
+        memset(&buf[0], 0, sizeof(buf));
+        bitstream_writer_init(&writer, &buf[0]);
+        bitstream_writer_seek(&writer, offset);
+        bitstream_writer_write_ue(&writer, 0xffffffff);
+        bitstream_writer_write_ue(&writer, 0x7fffffff);
+        bitstream_writer_write_se(&writer, INT32_MIN);
+        bitstream_writer_write_se(&writer, INT32_MAX);
+        bitstream_writer_write_rice(&writer, 0xffffffff, 31);
+        bitstream_writer_write_rice(&writer, 0, 31);
+        bitstream_writer_write_rice(&writer, 1000, 0);
+        bitstream_writer_write_rice(&writer, 0xabcd, 11);
+
+        memset(&fast_buf[0], 0, sizeof(fast_buf));
+        bitstream_fast_writer_init(&fast_writer,
+                                   &fast_buf[0],
+                                   sizeof(fast_buf));
+        bitstream_fast_writer_seek(&fast_writer, offset);
+        bitstream_fast_writer_write_ue(&fast_writer, 0xffffffff);
+        bitstream_fast_writer_write_ue(&fast_writer, 0x7fffffff);
+        bitstream_fast_writer_write_se(&fast_writer, INT32_MIN);
+        bitstream_fast_writer_write_se(&fast_writer, INT32_MAX);
+        bitstream_fast_writer_write_rice(&fast_writer, 0xffffffff, 31);
+        bitstream_fast_writer_write_rice(&fast_writer, 0, 31);
+        bitstream_fast_writer_write_rice(&fast_writer, 1000, 0);
+        bitstream_fast_writer_write_rice(&fast_writer, 0xabcd, 11);
+        bitstream_fast_writer_flush(&fast_writer);
+        ASSERT_EQ(bitstream_fast_writer_size_in_bits(&fast_writer),
+                  (uint64_t)bitstream_writer_size_in_bits(&writer));
+        ASSERT_MEMORY_EQ(&fast_buf[0],
+                         &buf[0],
+                         bitstream_fast_writer_size_in_bytes(&fast_writer));
+
+        bitstream_reader_init(&reader, &buf[0]);
+        bitstream_reader_seek(&reader, offset);
+        ASSERT_EQ(bitstream_reader_read_ue(&reader), 0xffffffff);
+        ASSERT_EQ(bitstream_reader_read_ue(&reader), 0x7fffffff);
+        ASSERT_EQ(bitstream_reader_read_se(&reader), INT32_MIN);
+        ASSERT_EQ(bitstream_reader_read_se(&reader), INT32_MAX);
+        ASSERT_EQ(bitstream_reader_read_rice(&reader, 31), 0xffffffff);
+        ASSERT_EQ(bitstream_reader_read_rice(&reader, 31), 0);
+        ASSERT_EQ(bitstream_reader_read_rice(&reader, 0), 1000);
+        ASSERT_EQ(bitstream_reader_read_rice(&reader, 11), 0xabcd);
+        ASSERT_EQ(bitstream_reader_tell(&reader),
+                  bitstream_writer_size_in_bits(&writer));
+
+        bitstream_fast_reader_init(&fast_reader,
+                                   &buf[0],
+                                   bitstream_fast_writer_size_in_bytes(
+                                       &fast_writer));
+        bitstream_fast_reader_seek(&fast_reader, offset);
+        ASSERT_EQ(bitstream_fast_reader_read_ue(&fast_reader), 0xffffffff);
+        ASSERT_EQ(bitstream_fast_reader_read_ue(&fast_reader), 0x7fffffff);
+        ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), INT32_MIN);
+        ASSERT_EQ(bitstream_fast_reader_read_se(&fast_reader), INT32_MAX);
+        ASSERT_EQ(bitstream_fast_reader_read_rice(&fast_reader, 31),
+                  0xffffffff);
+        ASSERT_EQ(bitstream_fast_reader_read_rice(&fast_reader, 31), 0);
+        ASSERT_EQ(bitstream_fast_reader_read_rice(&fast_reader, 0), 1000);
+        ASSERT_EQ(bitstream_fast_reader_read_rice(&fast_reader, 11), 0xabcd);
+        ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader),
+                  bitstream_fast_writer_size_in_bits(&fast_writer));
+        ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+    }
+}
+
+TEST(exp_golomb_rice_arrays)
+{
+    static uint8_t buf[16384];
+    uint32_t values[1000];
+    int32_t signed_values[1000];
+    uint32_t decoded[1000];
+    int32_t signed_decoded[1000];
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+    uint32_t state;
+    size_t size;
+    int i;
+
+    state = 1;
+
+    for (i = 0; i < 1000; i++) {
+        state = (state * 1103515245u + 12345u);
+        values[i] = ((state >> 8) >> ((state >> 3) % 24));
+        signed_values[i] = (int32_t)(values[i] >> 1);
+
+        if (state & 1) {
+            signed_values[i] = -signed_values[i];
+        }
+    }
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_fast_writer_write_bit(&writer, 1);
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_ue(&writer, values[i]);
+    }
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_se(&writer, signed_values[i]);
+    }
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_rice(&writer, values[i] >> 10, 5);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+    size = bitstream_fast_writer_size_in_bytes(&writer);
+
+    bitstream_reader_init(&reader, &buf[0]);
+    bitstream_reader_seek(&reader, 1);
+    bitstream_reader_read_ue_array(&reader, &decoded[0], 1000);
+    ASSERT_MEMORY_EQ(&decoded[0], &values[0], sizeof(values));
+    bitstream_reader_read_se_array(&reader, &signed_decoded[0], 1000);
+    ASSERT_MEMORY_EQ(&signed_decoded[0],
+                     &signed_values[0],
+                     sizeof(signed_values));
+    bitstream_reader_read_rice_array(&reader, &decoded[0], 1000, 5);
+
+    for (i = 0; i < 1000; i++) {
+        ASSERT_EQ(decoded[i], values[i] >> 10);
+    }
+
+    /* Exactly the written bytes, so the last codes are decoded in the
+       slow path. */
+    bitstream_fast_reader_init(&fast_reader, &buf[0], size);
+    bitstream_fast_reader_seek(&fast_reader, 1);
+    bitstream_fast_reader_read_ue_array(&fast_reader, &decoded[0], 1000);
+    ASSERT_MEMORY_EQ(&decoded[0], &values[0], sizeof(values));
+    bitstream_fast_reader_read_se_array(&fast_reader,
+                                        &signed_decoded[0],
+                                        1000);
+    ASSERT_MEMORY_EQ(&signed_decoded[0],
+                     &signed_values[0],
+                     sizeof(signed_values));
+    bitstream_fast_reader_read_rice_array(&fast_reader, &decoded[0], 1000, 5);
+
+    for (i = 0; i < 1000; i++) {
+        ASSERT_EQ(decoded[i], values[i] >> 10);
+    }
+
+    ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader),
+              bitstream_fast_writer_size_in_bits(&writer));
+    ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+}
+
+TEST(exp_golomb_rice_overflow)
+{
+    uint8_t buf[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00 };
+    uint32_t values[2];
+    struct bitstream_fast_reader_t reader;
+
+    /* 40 leading zeros is not an Exp-Golomb code. */
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_read_ue(&reader);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    /* Rice quotient of 40, then the stream ends in the next code. */
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_fast_reader_read_rice(&reader, 2), 160);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+    bitstream_fast_reader_read_rice(&reader, 2);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_read_rice_array(&reader, &values[0], 2, 2);
+    ASSERT_EQ(values[0], 160);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+}
+
+TEST(unary_elias)
+{
+    uint8_t buf[4];
+    uint8_t fast_buf[4];
+    uint8_t expected[] = { 0x8d, 0x12, 0x84, 0x4a };
+    struct bitstream_writer_t writer;
+    struct bitstream_fast_writer_t fast_writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+
+    memset(&buf[0], 0, sizeof(buf));
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_writer_write_unary(&writer, 0);
+    bitstream_writer_write_unary(&writer, 3);
+    bitstream_writer_write_gamma(&writer, 1);
+    bitstream_writer_write_gamma(&writer, 2);
+    bitstream_writer_write_gamma(&writer, 4);
+    bitstream_writer_write_delta(&writer, 1);
+    bitstream_writer_write_delta(&writer, 2);
+    bitstream_writer_write_delta(&writer, 10);
+    bitstream_writer_write_delta(&writer, 3);
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 31);
+    ASSERT_MEMORY_EQ(&buf[0], &expected[0], sizeof(expected));
+
+    bitstream_fast_writer_init(&fast_writer, &fast_buf[0], sizeof(fast_buf));
+    bitstream_fast_writer_write_unary(&fast_writer, 0);
+    bitstream_fast_writer_write_unary(&fast_writer, 3);
+    bitstream_fast_writer_write_gamma(&fast_writer, 1);
+    bitstream_fast_writer_write_gamma(&fast_writer, 2);
+    bitstream_fast_writer_write_gamma(&fast_writer, 4);
+    bitstream_fast_writer_write_delta(&fast_writer, 1);
+    bitstream_fast_writer_write_delta(&fast_writer, 2);
+    bitstream_fast_writer_write_delta(&fast_writer, 10);
+    bitstream_fast_writer_write_delta(&fast_writer, 3);
+    bitstream_fast_writer_flush(&fast_writer);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&fast_writer), 31);
+    ASSERT_MEMORY_EQ(&fast_buf[0], &expected[0], sizeof(expected));
+
+    bitstream_reader_init(&reader, &buf[0]);
+    ASSERT_EQ(bitstream_reader_read_unary(&reader), 0);
+    ASSERT_EQ(bitstream_reader_read_unary(&reader), 3);
+    ASSERT_EQ(bitstream_reader_read_gamma(&reader), 1);
+    ASSERT_EQ(bitstream_reader_read_gamma(&reader), 2);
+    ASSERT_EQ(bitstream_reader_read_gamma(&reader), 4);
+    ASSERT_EQ(bitstream_reader_read_delta(&reader), 1);
+    ASSERT_EQ(bitstream_reader_read_delta(&reader), 2);
+    ASSERT_EQ(bitstream_reader_read_delta(&reader), 10);
+    ASSERT_EQ(bitstream_reader_read_delta(&reader), 3);
+    ASSERT_EQ(bitstream_reader_tell(&reader), 31);
+
+    bitstream_fast_reader_init(&fast_reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_fast_reader_read_unary(&fast_reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_unary(&fast_reader), 3);
+    ASSERT_EQ(bitstream_fast_reader_read_gamma(&fast_reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_gamma(&fast_reader), 2);
+    ASSERT_EQ(bitstream_fast_reader_read_gamma(&fast_reader), 4);
+    ASSERT_EQ(bitstream_fast_reader_read_delta(&fast_reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_delta(&fast_reader), 2);
+    ASSERT_EQ(bitstream_fast_reader_read_delta(&fast_reader), 10);
+    ASSERT_EQ(bitstream_fast_reader_read_delta(&fast_reader), 3);
+    ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader), 31);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+}
+
+/* Largest codes at all bit offsets. */
+TEST(unary_elias_limits)
+{
+    uint8_t buf[64];
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+    int offset;
+
+    for (offset = 0; offset < 8; offset++) {
+        bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+        bitstream_fast_writer_seek(&writer, offset);
+        bitstream_fast_writer_write_unary(&writer, 100);
+        bitstream_fast_writer_write_gamma(&writer, 0xffffffff);
+        bitstream_fast_writer_write_delta(&writer, 0xffffffff);
+        bitstream_fast_writer_write_delta(&writer, 0x80000000);
+        bitstream_fast_writer_write_gamma(&writer, 0x80000000);
+        bitstream_fast_writer_flush(&writer);
+        ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer),
+                  (uint64_t)(offset + 101 + 63 + 42 + 42 + 63));
+
+        bitstream_reader_init(&reader, &buf[0]);
+        bitstream_reader_seek(&reader, offset);
+        ASSERT_EQ(bitstream_reader_read_unary(&reader), 100);
+        ASSERT_EQ(bitstream_reader_read_gamma(&reader), 0xffffffff);
+        ASSERT_EQ(bitstream_reader_read_delta(&reader), 0xffffffff);
+        ASSERT_EQ(bitstream_reader_read_delta(&reader), 0x80000000);
+        ASSERT_EQ(bitstream_reader_read_gamma(&reader), 0x80000000);
+
+        bitstream_fast_reader_init(&fast_reader,
+                                   &buf[0],
+                                   bitstream_fast_writer_size_in_bytes(
+                                       &writer));
+        bitstream_fast_reader_seek(&fast_reader, offset);
+        ASSERT_EQ(bitstream_fast_reader_read_unary(&fast_reader), 100);
+        ASSERT_EQ(bitstream_fast_reader_read_gamma(&fast_reader), 0xffffffff);
+        ASSERT_EQ(bitstream_fast_reader_read_delta(&fast_reader), 0xffffffff);
+        ASSERT_EQ(bitstream_fast_reader_read_delta(&fast_reader), 0x80000000);
+        ASSERT_EQ(bitstream_fast_reader_read_gamma(&fast_reader), 0x80000000);
+        ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+    }
+}
+
+TEST(elias_arrays)
+{
+    static uint8_t buf[16384];
+    uint32_t gaps[1000];
+    uint32_t decoded[1000];
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_fast_reader_t reader;
+    uint32_t state;
+    int i;
+
+    state = 1;
+
+    for (i = 0; i < 1000; i++) {
+        state = (state * 1103515245u + 12345u);
+        gaps[i] = (((state >> 1) >> ((state >> 3) % 31)) + 1);
+    }
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_fast_writer_write_bit(&writer, 0);
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_gamma(&writer, gaps[i]);
+    }
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_delta(&writer, gaps[i]);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    bitstream_fast_reader_init(&reader,
+                               &buf[0],
+                               bitstream_fast_writer_size_in_bytes(&writer));
+    bitstream_fast_reader_seek(&reader, 1);
+    bitstream_fast_reader_read_gamma_array(&reader, &decoded[0], 1000);
+    ASSERT_MEMORY_EQ(&decoded[0], &gaps[0], sizeof(gaps));
+    bitstream_fast_reader_read_delta_array(&reader, &decoded[0], 1000);
+    ASSERT_MEMORY_EQ(&decoded[0], &gaps[0], sizeof(gaps));
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader),
+              bitstream_fast_writer_size_in_bits(&writer));
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+}
+
+TEST(elias_overflow)
+{
+    /* No one before the end of the stream. */
+    uint8_t zeros[] = { 0x00, 0x00, 0x00, 0x00 };
+    /* Delta code with a 33 bits value length. */
+    uint8_t buf[] = { 0x04, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    uint32_t values[1];
+    struct bitstream_fast_reader_t reader;
+
+    bitstream_fast_reader_init(&reader, &zeros[0], sizeof(zeros));
+    bitstream_fast_reader_read_gamma(&reader);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_fast_reader_read_gamma(&reader), 33);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_read_delta(&reader);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_read_delta_array(&reader, &values[0], 1);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+}
+
+TEST(varint)
+{
+    uint8_t buf[6];
+    uint8_t fast_buf[6];
+    uint8_t expected[] = { 0xaa, 0xc0, 0x20, 0x10, 0x20, 0x00 };
+    struct bitstream_writer_t writer;
+    struct bitstream_fast_writer_t fast_writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+
+    memset(&buf[0], 0, sizeof(buf));
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_writer_write_u64_bits(&writer, 0xa, 4);
+    bitstream_writer_write_varint(&writer, 300);
+    bitstream_writer_write_signed_varint(&writer, -1);
+    bitstream_writer_write_signed_varint(&writer, 1);
+    bitstream_writer_write_varint(&writer, 0);
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 44);
+    ASSERT_MEMORY_EQ(&buf[0], &expected[0], sizeof(expected));
+
+    bitstream_fast_writer_init(&fast_writer, &fast_buf[0], sizeof(fast_buf));
+    bitstream_fast_writer_write_u64_bits(&fast_writer, 0xa, 4);
+    bitstream_fast_writer_write_varint(&fast_writer, 300);
+    bitstream_fast_writer_write_signed_varint(&fast_writer, -1);
+    bitstream_fast_writer_write_signed_varint(&fast_writer, 1);
+    bitstream_fast_writer_write_varint(&fast_writer, 0);
+    bitstream_fast_writer_flush(&fast_writer);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&fast_writer), 44);
+    ASSERT_MEMORY_EQ(&fast_buf[0], &expected[0], sizeof(expected));
+
+    bitstream_reader_init(&reader, &buf[0]);
+    bitstream_reader_seek(&reader, 4);
+    ASSERT_EQ(bitstream_reader_read_varint(&reader), 300);
+    ASSERT_EQ(bitstream_reader_read_signed_varint(&reader), -1);
+    ASSERT_EQ(bitstream_reader_read_signed_varint(&reader), 1);
+    ASSERT_EQ(bitstream_reader_read_varint(&reader), 0);
+    ASSERT_EQ(bitstream_reader_tell(&reader), 44);
+
+    bitstream_fast_reader_init(&fast_reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_seek(&fast_reader, 4);
+    ASSERT_EQ(bitstream_fast_reader_read_varint(&fast_reader), 300);
+    ASSERT_EQ(bitstream_fast_reader_read_signed_varint(&fast_reader), -1);
+    ASSERT_EQ(bitstream_fast_reader_read_signed_varint(&fast_reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_varint(&fast_reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader), 44);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+}
+
+TEST(varint_limits)
+{
+    uint8_t buf[80];
+    uint8_t fast_buf[80];
+    uint8_t expected[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01
+    };
+    uint64_t values[] = {
+        0,
+        127,
+        128,
+        (1ull << 49) - 1,
+        1ull << 49,
+        (1ull << 56) - 1,
+        1ull << 56,
+        0xffffffffffffffffull
+    };
+    int64_t signed_values[] = {
+        -64,
+        64,
+        INT64_MIN,
+        INT64_MAX
+    };
+    struct bitstream_writer_t writer;
+    struct bitstream_fast_writer_t fast_writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+    int i;
+
+    memset(&buf[0], 0, sizeof(buf));
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_writer_write_varint(&writer, 0xffffffffffffffffull);
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 80);
+    ASSERT_MEMORY_EQ(&buf[0], &expected[0], sizeof(expected));
+
+    memset(&buf[0], 0, sizeof(buf));
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_fast_writer_init(&fast_writer, &fast_buf[0], sizeof(fast_buf));
+    bitstream_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_bit(&fast_writer, 1);
+
+    for (i = 0; i < 8; i++) {
+        bitstream_writer_write_varint(&writer, values[i]);
+        bitstream_fast_writer_write_varint(&fast_writer, values[i]);
+    }
+
+    for (i = 0; i < 4; i++) {
+        bitstream_writer_write_signed_varint(&writer, signed_values[i]);
+        bitstream_fast_writer_write_signed_varint(&fast_writer,
+                                                  signed_values[i]);
+    }
+
+    /* 46 bytes of unsigned and 23 bytes of signed varints. */
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 1 + 8 * (46 + 23));
+    bitstream_fast_writer_flush(&fast_writer);
+    ASSERT_MEMORY_EQ(&fast_buf[0], &buf[0], sizeof(buf));
+
+    bitstream_reader_init(&reader, &buf[0]);
+    bitstream_fast_reader_init(&fast_reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&fast_reader), 1);
+
+    for (i = 0; i < 8; i++) {
+        ASSERT_EQ(bitstream_reader_read_varint(&reader), values[i]);
+        ASSERT_EQ(bitstream_fast_reader_read_varint(&fast_reader), values[i]);
+    }
+
+    for (i = 0; i < 4; i++) {
+        ASSERT_EQ(bitstream_reader_read_signed_varint(&reader),
+                  signed_values[i]);
+        ASSERT_EQ(bitstream_fast_reader_read_signed_varint(&fast_reader),
+                  signed_values[i]);
+    }
+
+    ASSERT_EQ(bitstream_fast_reader_tell(&fast_reader),
+              bitstream_writer_size_in_bits(&writer));
+    ASSERT_EQ(bitstream_fast_reader_overflow(&fast_reader), 0);
+}
+
+TEST(varint_arrays)
+{
+    static uint8_t buf[32768];
+    uint64_t values[1000];
+    uint64_t decoded[1000];
+    int64_t signed_decoded[1000];
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_fast_reader_t reader;
+    uint64_t state;
+    int i;
+
+    state = 1;
+
+    for (i = 0; i < 1000; i++) {
+        state = (state * 6364136223846793005ull + 1442695040888963407ull);
+        values[i] = (state >> (state % 64));
+    }
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_fast_writer_write_bit(&writer, 0);
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_varint(&writer, values[i]);
+    }
+
+    for (i = 0; i < 1000; i++) {
+        bitstream_fast_writer_write_signed_varint(&writer,
+                                                  (int64_t)values[i]);
+    }
+
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    bitstream_fast_reader_init(&reader,
+                               &buf[0],
+                               bitstream_fast_writer_size_in_bytes(&writer));
+    bitstream_fast_reader_seek(&reader, 1);
+    bitstream_fast_reader_read_varint_array(&reader, &decoded[0], 1000);
+    ASSERT_MEMORY_EQ(&decoded[0], &values[0], sizeof(values));
+    bitstream_fast_reader_read_signed_varint_array(&reader,
+                                                   &signed_decoded[0],
+                                                   1000);
+    ASSERT_MEMORY_EQ(&signed_decoded[0], &values[0], sizeof(values));
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader),
+              bitstream_fast_writer_size_in_bits(&writer));
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+
+    bitstream_fast_reader_seek(&reader,
+                               1 - bitstream_fast_reader_tell(&reader));
+
+    for (i = 0; i < 1000; i++) {
+        ASSERT_EQ(bitstream_fast_reader_read_varint(&reader), values[i]);
+    }
+}
+
+TEST(varint_overflow)
+{
+    /* Eleven bytes varint. */
+    uint8_t buf[] = {
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00
+    };
+    /* Continued past the end of the stream. */
+    uint8_t truncated[] = { 0xff, 0xff };
+    uint64_t values[1];
+    struct bitstream_fast_reader_t reader;
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_read_varint(&reader);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_read_varint_array(&reader, &values[0], 1);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    bitstream_fast_reader_init(&reader, &truncated[0], sizeof(truncated));
+    bitstream_fast_reader_read_varint(&reader);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+}
+
+TEST(fast_reader_seek)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = { 0x12, 0x34, 0x56, 0x78, 0x91, 0x23, 0x45, 0x67, 0x89 };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    bitstream_fast_reader_seek(&reader, 16);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0x56);
+
+    bitstream_fast_reader_seek(&reader, -8);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0x56);
+
+    bitstream_fast_reader_seek(&reader, 1);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0xf1);
+
+    bitstream_fast_reader_seek(&reader, -8);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0xf1);
+}
+
+TEST(fast_reader_tell)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = { 0x12, 0x34, 0x56, 0x78, 0x91, 0x23, 0x45, 0x67, 0x89 };
+
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 0);
+
+    bitstream_fast_reader_seek(&reader, 16);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 16);
+
+    bitstream_fast_reader_seek(&reader, -8);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 8);
+
+    bitstream_fast_reader_seek(&reader, 1);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 9);
+
+    bitstream_fast_reader_read_u64_bits(&reader, 13);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 22);
+
+    bitstream_fast_reader_seek(&reader, -8);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 14);
+}
+
+TEST(fast_reader_overflow)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t buf[] = {
+        0x12, 0x34, 0x56, 0x78, 0x91, 0x23, 0x45, 0x67, 0x89, 0xff
+    };
+    uint8_t data[2];
+
+    bitstream_fast_reader_init(&reader, &buf[0], 9);
+
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 60),
+              0x123456789123456ll);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 12), 0x789);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+
+    /* Past the end, zeros are read. */
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 73);
+
+    /* The flag is sticky. */
+    bitstream_fast_reader_seek(&reader, -73);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0x12);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+
+    bitstream_fast_reader_init(&reader, &buf[0], 9);
+    bitstream_fast_reader_seek(&reader, 64);
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 1);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+    bitstream_fast_reader_seek(&reader, -8);
+    bitstream_fast_reader_read_bytes(&reader, &data[0], 2);
+    ASSERT_MEMORY_EQ(&data[0], "\x89\x00", 2);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+}
+
+TEST(fast_reader_writer_large_stream)
+{
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_fast_reader_t reader;
+    uint8_t *buf_p;
+    size_t size;
+
+    /* 5 GiB, only a few pages are touched. */
+    size = (5ull << 30);
+    buf_p = mmap(NULL,
+                 size,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                 -1,
+                 0);
+    ASSERT_NE(buf_p, MAP_FAILED);
+
+    bitstream_fast_writer_init(&writer, buf_p, size);
+    bitstream_fast_writer_seek(&writer, 8 * (int64_t)(size - 16) + 3);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer),
+              8 * (uint64_t)(size - 16) + 3);
+    bitstream_fast_writer_write_u64(&writer, 0x0123456789abcdefull);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x1f, 5);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bytes(&writer), size - 7);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    bitstream_fast_reader_init(&reader, buf_p, size);
+    bitstream_fast_reader_seek(&reader, 8 * (int64_t)(size - 16) + 3);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader),
+              8 * (uint64_t)(size - 16) + 3);
+    ASSERT_EQ(bitstream_fast_reader_read_u64(&reader), 0x0123456789abcdefull);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 5), 0x1f);
+    bitstream_fast_reader_seek(&reader, -69);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 12), 0x012);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+
+    munmap(buf_p, size);
+}
+
+struct stream_t {
+    const uint8_t *buf_p;
+    size_t size;
+    size_t offset;
+    size_t chunk_size;
+};
+
+static ssize_t stream_refill(void *arg_p, uint8_t *buf_p, size_t size)
+{
+    struct stream_t *stream_p;
+
+    stream_p = arg_p;
+
+    if (size > stream_p->chunk_size) {
+        size = stream_p->chunk_size;
+    }
+
+    if (size > stream_p->size - stream_p->offset) {
+        size = (stream_p->size - stream_p->offset);
+    }
+
+    memcpy(buf_p, &stream_p->buf_p[stream_p->offset], size);
+    stream_p->offset += size;
+
+    return ((ssize_t)size);
+}
+
+TEST(fast_reader_stream)
+{
+    struct bitstream_fast_reader_t stream_reader;
+    struct bitstream_fast_reader_t reader;
+    struct stream_t stream;
+    uint8_t buf[300];
+    uint8_t window[11];
+    uint8_t data[2][20];
+    size_t chunk_size;
+    int number_of_bits;
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(29 * i + 7);
+    }
+
+    for (chunk_size = 1; chunk_size < 12; chunk_size++) {
+        stream.buf_p = &buf[0];
+        stream.size = sizeof(buf);
+        stream.offset = 0;
+        stream.chunk_size = chunk_size;
+        bitstream_fast_reader_init_stream(&stream_reader,
+                                          &window[0],
+                                          sizeof(window),
+                                          stream_refill,
+                                          &stream);
+        bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+        number_of_bits = 1;
+
+        while (bitstream_fast_reader_tell(&reader) < 8 * 260) {
+            ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&stream_reader,
+                                                          number_of_bits),
+                      bitstream_fast_reader_read_u64_bits(&reader,
+                                                          number_of_bits));
+            bitstream_fast_reader_read_bytes(&stream_reader,
+                                             &data[0][0],
+                                             number_of_bits % 20);
+            bitstream_fast_reader_read_bytes(&reader,
+                                             &data[1][0],
+                                             number_of_bits % 20);
+            ASSERT_MEMORY_EQ(&data[0][0], &data[1][0], number_of_bits % 20);
+            ASSERT_EQ(bitstream_fast_reader_tell(&stream_reader),
+                      bitstream_fast_reader_tell(&reader));
+            number_of_bits = ((number_of_bits * 7) % 64) + 1;
+        }
+
+        /* Skip forward past the window. */
+        bitstream_fast_reader_seek(&stream_reader, 203);
+        bitstream_fast_reader_seek(&reader, 203);
+        ASSERT_EQ(bitstream_fast_reader_read_u8(&stream_reader),
+                  bitstream_fast_reader_read_u8(&reader));
+        ASSERT_EQ(bitstream_fast_reader_overflow(&stream_reader), 0);
+
+        /* End of stream. */
+        bitstream_fast_reader_seek(&stream_reader,
+                                   8 * sizeof(buf)
+                                   - bitstream_fast_reader_tell(&stream_reader)
+                                   - 3);
+        ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&stream_reader, 3),
+                  buf[sizeof(buf) - 1] & 0x7);
+        ASSERT_EQ(bitstream_fast_reader_overflow(&stream_reader), 0);
+        ASSERT_EQ(bitstream_fast_reader_read_bit(&stream_reader), 0);
+        ASSERT_EQ(bitstream_fast_reader_overflow(&stream_reader), 1);
+    }
+}
+
+TEST(fast_reader_stream_seek)
+{
+    struct bitstream_fast_reader_t stream_reader;
+    struct bitstream_fast_reader_t reader;
+    struct stream_t stream;
+    uint8_t buf[300];
+    uint8_t window[32];
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)i;
+    }
+
+    stream.buf_p = &buf[0];
+    stream.size = sizeof(buf);
+    stream.offset = 0;
+    stream.chunk_size = 16;
+    bitstream_fast_reader_init_stream(&stream_reader,
+                                      &window[0],
+                                      sizeof(window),
+                                      stream_refill,
+                                      &stream);
+
+    for (i = 0; i < 40; i++) {
+        ASSERT_EQ(bitstream_fast_reader_read_u8(&stream_reader), i);
+    }
+
+    /* Back to before the window. */
+    bitstream_fast_reader_seek(&stream_reader, -240);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&stream_reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_tell(&stream_reader), 8 * 40);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&stream_reader), 40);
+
+    /* Short seeks after peeks, which may leave the read position in
+       bytes already discarded from the window. */
+    stream.offset = 0;
+    bitstream_fast_reader_init_stream(&stream_reader,
+                                      &window[0],
+                                      8,
+                                      stream_refill,
+                                      &stream);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+
+    for (i = 0; i < 100; i++) {
+        ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&stream_reader,
+                                                      (i % 37) + 1),
+                  bitstream_fast_reader_read_u64_bits(&reader, (i % 37) + 1));
+        ASSERT_EQ(bitstream_fast_reader_peek_u64_bits(&stream_reader, 56),
+                  bitstream_fast_reader_peek_u64_bits(&reader, 56));
+        bitstream_fast_reader_seek(&stream_reader, i % 3);
+        bitstream_fast_reader_seek(&reader, i % 3);
+    }
+
+    ASSERT_EQ(bitstream_fast_reader_tell(&stream_reader),
+              bitstream_fast_reader_tell(&reader));
+    ASSERT_EQ(bitstream_fast_reader_overflow(&stream_reader), 0);
+}
+
+TEST(fast_reader_refill_fd)
+{
+    struct bitstream_fast_reader_t reader;
+    uint8_t window[16];
+    uint8_t buf[64];
+    int fds[2];
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)i;
+    }
+
+    ASSERT_EQ(pipe(fds), 0);
+    ASSERT_EQ(write(fds[1], &buf[0], sizeof(buf)), (ssize_t)sizeof(buf));
+    close(fds[1]);
+
+    bitstream_fast_reader_init_stream(&reader,
+                                      &window[0],
+                                      sizeof(window),
+                                      bitstream_fast_reader_refill_fd,
+                                      &fds[0]);
+
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 4), 0);
+
+    for (i = 0; i < 63; i++) {
+        ASSERT_EQ(bitstream_fast_reader_read_u8(&reader),
+                  (uint8_t)((i << 4) | ((i + 1) >> 4)));
+    }
+
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&reader, 4), 0xf);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 8 * sizeof(buf));
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+    close(fds[0]);
+}
+
+TEST(fast_reader_segments)
+{
+    struct bitstream_fast_reader_t segments_reader;
+    struct bitstream_fast_reader_t reader;
+    struct iovec segments[12];
+    uint8_t buf[300];
+    uint8_t data[2][20];
+    size_t sizes[12] = { 3, 0, 1, 40, 7, 8, 2, 9, 100, 1, 1, 128 };
+    size_t offset;
+    int number_of_bits;
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(29 * i + 7);
+    }
+
+    offset = 0;
+
+    for (i = 0; i < 12; i++) {
+        segments[i].iov_base = &buf[offset];
+        segments[i].iov_len = sizes[i];
+        offset += sizes[i];
+    }
+
+    ASSERT_EQ(offset, sizeof(buf));
+    bitstream_fast_reader_init_segments(&segments_reader, &segments[0], 12);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    number_of_bits = 1;
+
+    while (bitstream_fast_reader_tell(&reader) < 8 * 260) {
+        ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&segments_reader,
+                                                      number_of_bits),
+                  bitstream_fast_reader_read_u64_bits(&reader,
+                                                      number_of_bits));
+        bitstream_fast_reader_read_bytes(&segments_reader,
+                                         &data[0][0],
+                                         number_of_bits % 20);
+        bitstream_fast_reader_read_bytes(&reader,
+                                         &data[1][0],
+                                         number_of_bits % 20);
+        ASSERT_MEMORY_EQ(&data[0][0], &data[1][0], number_of_bits % 20);
+        ASSERT_EQ(bitstream_fast_reader_tell(&segments_reader),
+                  bitstream_fast_reader_tell(&reader));
+        number_of_bits = ((number_of_bits * 7) % 64) + 1;
+    }
+
+    /* Skip forward over segments. */
+    bitstream_fast_reader_init_segments(&segments_reader, &segments[0], 12);
+    bitstream_fast_reader_seek(&segments_reader, 8 * 165 + 5);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    bitstream_fast_reader_seek(&reader, 8 * 165 + 5);
+    ASSERT_EQ(bitstream_fast_reader_read_u64(&segments_reader),
+              bitstream_fast_reader_read_u64(&reader));
+
+    /* End of chain. */
+    bitstream_fast_reader_seek(&segments_reader,
+                               8 * sizeof(buf)
+                               - bitstream_fast_reader_tell(&segments_reader)
+                               - 11);
+    ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&segments_reader, 11),
+              ((buf[sizeof(buf) - 2] & 0x7) << 8) | buf[sizeof(buf) - 1]);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&segments_reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_read_bit(&segments_reader), 0);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&segments_reader), 1);
+}
+
+TEST(fast_reader_segments_seek)
+{
+    struct bitstream_fast_reader_t reader;
+    struct iovec segments[3];
+    uint8_t buf[51];
+    int i;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)i;
+    }
+
+    segments[0].iov_base = &buf[0];
+    segments[0].iov_len = 3;
+    segments[1].iov_base = &buf[3];
+    segments[1].iov_len = 40;
+    segments[2].iov_base = &buf[43];
+    segments[2].iov_len = 8;
+    bitstream_fast_reader_init_segments(&reader, &segments[0], 3);
+
+    for (i = 0; i < 45; i++) {
+        ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), i);
+    }
+
+    /* Back within the current segment. */
+    bitstream_fast_reader_seek(&reader, -8);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 44);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+
+    /* Back into a previous segment. */
+    bitstream_fast_reader_seek(&reader, -8 * 35);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 1);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 8 * 45);
+    ASSERT_EQ(bitstream_fast_reader_read_u8(&reader), 45);
+}
+
+TEST(fast_writer_segments)
+{
+    struct bitstream_fast_writer_t segments_writer;
+    struct bitstream_fast_writer_t writer;
+    struct iovec segments[8];
+    uint8_t header[32];
+    uint8_t buf[128];
+    uint8_t payload[40];
+    uint8_t data[128];
+    size_t offset;
+    int number_of_segments;
+    int i;
+
+    for (i = 0; i < (int)sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i + 1);
+    }
+
+    bitstream_fast_writer_init_segments(&segments_writer,
+                                        &header[0],
+                                        sizeof(header),
+                                        &segments[0],
+                                        8);
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+
+    /* Aligned payload first. */
+    bitstream_fast_writer_write_bytes_reference(&segments_writer,
+                                                &payload[0],
+                                                4);
+    bitstream_fast_writer_write_bytes(&writer, &payload[0], 4);
+
+    /* Header, then aligned payload. */
+    bitstream_fast_writer_write_u64_bits(&segments_writer, 0x5, 3);
+    bitstream_fast_writer_write_u64_bits(&segments_writer, 0x1a, 5);
+    bitstream_fast_writer_write_bytes_reference(&segments_writer,
+                                                &payload[0],
+                                                40);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x5, 3);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x1a, 5);
+    bitstream_fast_writer_write_bytes(&writer, &payload[0], 40);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&segments_writer),
+              bitstream_fast_writer_size_in_bits(&writer));
+
+    /* Unaligned payload is copied. */
+    bitstream_fast_writer_write_bit(&segments_writer, 1);
+    bitstream_fast_writer_write_bytes_reference(&segments_writer,
+                                                &payload[3],
+                                                10);
+    bitstream_fast_writer_write_bit(&writer, 1);
+    bitstream_fast_writer_write_bytes(&writer, &payload[3], 10);
+
+    /* Aligned again. */
+    bitstream_fast_writer_write_u64_bits(&segments_writer, 0x7f, 7);
+    bitstream_fast_writer_write_bytes_reference(&segments_writer,
+                                                &payload[7],
+                                                20);
+    bitstream_fast_writer_write_u64(&segments_writer, 0x0123456789abcdefull);
+    bitstream_fast_writer_write_u64_bits(&segments_writer, 0x3, 2);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x7f, 7);
+    bitstream_fast_writer_write_bytes(&writer, &payload[7], 20);
+    bitstream_fast_writer_write_u64(&writer, 0x0123456789abcdefull);
+    bitstream_fast_writer_write_u64_bits(&writer, 0x3, 2);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&segments_writer),
+              bitstream_fast_writer_size_in_bits(&writer));
+
+    number_of_segments = bitstream_fast_writer_finish_segments(&segments_writer);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(number_of_segments, 6);
+    ASSERT_EQ(segments[0].iov_base, &payload[0]);
+    ASSERT_EQ(segments[2].iov_base, &payload[0]);
+    ASSERT_EQ(segments[4].iov_base, &payload[7]);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&segments_writer), 0);
+
+    offset = 0;
+
+    for (i = 0; i < number_of_segments; i++) {
+        memcpy(&data[offset], segments[i].iov_base, segments[i].iov_len);
+        offset += segments[i].iov_len;
+    }
+
+    ASSERT_EQ(offset, bitstream_fast_writer_size_in_bytes(&writer));
+    ASSERT_MEMORY_EQ(&data[0], &buf[0], offset);
+}
+
+TEST(fast_writer_segments_seek)
+{
+    struct bitstream_fast_writer_t writer;
+    struct iovec segments[4];
+    uint8_t header[32];
+    uint8_t payload[100];
+    uint8_t expected[] = { 0x55, 0x77, 0x88 };
+
+    memset(&payload[0], 0, sizeof(payload));
+    bitstream_fast_writer_init_segments(&writer,
+                                        &header[0],
+                                        sizeof(header),
+                                        &segments[0],
+                                        4);
+    bitstream_fast_writer_write_u32(&writer, 0x11223344);
+    bitstream_fast_writer_write_bytes_reference(&writer,
+                                                &payload[0],
+                                                sizeof(payload));
+    bitstream_fast_writer_write_u8(&writer, 0x55);
+    bitstream_fast_writer_write_u8(&writer, 0x66);
+
+    /* Back to after the payload. */
+    bitstream_fast_writer_seek(&writer, -8);
+    bitstream_fast_writer_write_u8(&writer, 0x77);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    /* Into the payload. */
+    bitstream_fast_writer_seek(&writer, -24);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 1);
+    ASSERT_EQ(bitstream_fast_writer_size_in_bits(&writer), 8 * 106);
+    bitstream_fast_writer_write_u8(&writer, 0x88);
+
+    ASSERT_EQ(bitstream_fast_writer_finish_segments(&writer), 3);
+    ASSERT_EQ(segments[0].iov_len, 4);
+    ASSERT_MEMORY_EQ(segments[0].iov_base, "\x11\x22\x33\x44", 4);
+    ASSERT_EQ(segments[1].iov_base, &payload[0]);
+    ASSERT_EQ(segments[2].iov_len, sizeof(expected));
+    ASSERT_MEMORY_EQ(segments[2].iov_base, &expected[0], sizeof(expected));
+}
+
+static int lsb_get_bit(const uint8_t *buf_p, int bit_offset)
+{
+    return ((buf_p[bit_offset / 8] >> (bit_offset % 8)) & 1);
+}
+
+static void lsb_put_bits(uint8_t *buf_p,
+                         int bit_offset,
+                         uint64_t value,
+                         int number_of_bits)
+{
+    int i;
+
+    for (i = 0; i < number_of_bits; i++, bit_offset++) {
+        buf_p[bit_offset / 8] |= (((value >> i) & 1) << (bit_offset % 8));
+    }
+}
+
+TEST(lsb_writer_write)
+{
+    struct bitstream_lsb_writer_t writer;
+    uint8_t buf[16];
+
+    memset(&buf[0], 0xff, sizeof(buf));
+    bitstream_lsb_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_lsb_writer_write_bit(&writer, 1);
+    bitstream_lsb_writer_write_u64_bits(&writer, 1, 2);
+    ASSERT_EQ(bitstream_lsb_writer_size_in_bits(&writer), 3);
+    bitstream_lsb_writer_write_u16(&writer, 0x1234);
+    bitstream_lsb_writer_write_u8(&writer, 0xab);
+    bitstream_lsb_writer_write_u64(&writer, 0x0123456789abcdefull);
+    bitstream_lsb_writer_write_u64_bits(&writer, 0x1f, 5);
+    ASSERT_EQ(bitstream_lsb_writer_size_in_bits(&writer), 96);
+    ASSERT_EQ(bitstream_lsb_writer_size_in_bytes(&writer), 12);
+    bitstream_lsb_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0],
+                     "\xa3\x91\x58\x7d\x6f\x5e\x4d\x3c\x2b\x1a\x09\xf8",
+                     12);
+    ASSERT_EQ(bitstream_lsb_writer_overflow(&writer), 0);
+
+    /* Byte aligned values are little endian. */
+    bitstream_lsb_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_lsb_writer_write_u32(&writer, 0x12345678);
+    bitstream_lsb_writer_write_bytes(&writer, (const uint8_t *)"\xab\xcd", 2);
+    bitstream_lsb_writer_flush(&writer);
+    ASSERT_MEMORY_EQ(&buf[0], "\x78\x56\x34\x12\xab\xcd", 6);
+}
+
+TEST(lsb_writer_write_u64_bits_all_offsets)
+{
+    struct bitstream_lsb_writer_t writer;
+    uint8_t expected[128];
+    uint8_t buf[128];
+    uint64_t value;
+    int offset;
+    int position;
+    int number_of_bits;
+    int i;
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 64; number_of_bits++) {
+            memset(&expected[0], 0, sizeof(expected));
+            memset(&buf[0], 0, sizeof(buf));
+            bitstream_lsb_writer_init(&writer, &buf[0], sizeof(buf));
+            value = (0x5a & ((1 << offset) - 1));
+            bitstream_lsb_writer_write_u64_bits(&writer, value, offset);
+            lsb_put_bits(&expected[0], 0, value, offset);
+            position = offset;
+            value = 0x0123456789abcdefull;
+
+            for (i = 0; i < 14; i++) {
+                value = (value * 6364136223846793005ull + 1442695040888963407ull);
+
+                if (number_of_bits < 64) {
+                    value &= ((1ull << number_of_bits) - 1);
+                }
+
+                bitstream_lsb_writer_write_u64_bits(&writer,
+                                                    value,
+                                                    number_of_bits);
+                lsb_put_bits(&expected[0], position, value, number_of_bits);
+                position += number_of_bits;
+            }
+
+            ASSERT_EQ(bitstream_lsb_writer_size_in_bits(&writer), position);
+            bitstream_lsb_writer_flush(&writer);
+            ASSERT_MEMORY_EQ(&buf[0], &expected[0], sizeof(buf));
+        }
+    }
+}
+
+TEST(lsb_reader_read)
+{
+    struct bitstream_lsb_reader_t reader;
+    const uint8_t *buf_p;
+
+    buf_p = (const uint8_t *)"\xa3\x91\x58\x7d\x6f\x5e\x4d\x3c\x2b\x1a\x09\xf8";
+    bitstream_lsb_reader_init(&reader, buf_p, 12);
+    ASSERT_EQ(bitstream_lsb_reader_read_bit(&reader), 1);
+    ASSERT_EQ(bitstream_lsb_reader_read_u64_bits(&reader, 2), 1);
+    ASSERT_EQ(bitstream_lsb_reader_read_u16(&reader), 0x1234);
+    ASSERT_EQ(bitstream_lsb_reader_read_u8(&reader), 0xab);
+    ASSERT_EQ(bitstream_lsb_reader_read_u64(&reader), 0x0123456789abcdefull);
+    ASSERT_EQ(bitstream_lsb_reader_tell(&reader), 91);
+    ASSERT_EQ(bitstream_lsb_reader_read_u64_bits(&reader, 5), 0x1f);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+
+    bitstream_lsb_reader_seek_to(&reader, 0);
+    ASSERT_EQ(bitstream_lsb_reader_read_u32(&reader), 0x7d5891a3);
+    bitstream_lsb_reader_seek(&reader, 3);
+    ASSERT_EQ(bitstream_lsb_reader_read_u64_bits(&reader, 5), 0xd);
+}
+
+TEST(lsb_reader_read_u64_bits_all_offsets)
+{
+    struct bitstream_lsb_reader_t reader;
+    uint8_t buf[64];
+    uint64_t expected;
+    int i;
+    int offset;
+    int position;
+    int number_of_bits;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(37 * i + 11);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 64; number_of_bits++) {
+            bitstream_lsb_reader_init(&reader, &buf[0], sizeof(buf));
+            bitstream_lsb_reader_seek(&reader, offset);
+            position = offset;
+
+            while (position + number_of_bits <= 8 * (int)sizeof(buf)) {
+                expected = 0;
+
+                for (i = 0; i < number_of_bits; i++) {
+                    expected |= ((uint64_t)lsb_get_bit(&buf[0], position + i)
+                                 << i);
+                }
+
+                ASSERT_EQ(bitstream_lsb_reader_read_u64_bits(&reader,
+                                                             number_of_bits),
+                          expected);
+                position += number_of_bits;
+            }
+
+            ASSERT_EQ(bitstream_lsb_reader_tell(&reader), position);
+            ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+        }
+    }
+}
+
+TEST(lsb_reader_peek_skip)
+{
+    struct bitstream_lsb_reader_t reader;
+    uint8_t buf[64];
+    uint64_t value;
+    int i;
+    int offset;
+    int position;
+    int number_of_bits;
+    int skip;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(37 * i + 11);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (number_of_bits = 1; number_of_bits <= 56; number_of_bits++) {
+            bitstream_lsb_reader_init(&reader, &buf[0], sizeof(buf));
+            bitstream_lsb_reader_skip_bits(&reader, offset);
+            position = offset;
+
+            while (position + number_of_bits <= 8 * (int)sizeof(buf)) {
+                value = 0;
+
+                for (i = 0; i < number_of_bits; i++) {
+                    value |= ((uint64_t)lsb_get_bit(&buf[0], position + i)
+                              << i);
+                }
+
+                ASSERT_EQ(bitstream_lsb_reader_peek_u64_bits(&reader,
+                                                             number_of_bits),
+                          value);
+                skip = (1 + (int)(value % (uint64_t)number_of_bits));
+                bitstream_lsb_reader_skip_bits(&reader, skip);
+                position += skip;
+                ASSERT_EQ(bitstream_lsb_reader_tell(&reader), position);
+            }
+
+            ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+        }
+    }
+
+    bitstream_lsb_reader_init(&reader, &buf[0], 2);
+    bitstream_lsb_reader_skip_bits(&reader, 4);
+    ASSERT_EQ(bitstream_lsb_reader_peek_u64_bits(&reader, 16), 0x0300);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+    bitstream_lsb_reader_skip_bits(&reader, 12);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+    bitstream_lsb_reader_skip_bits(&reader, 1);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 1);
+}
+
+TEST(lsb_write_read_bytes)
+{
+    struct bitstream_lsb_writer_t writer;
+    struct bitstream_lsb_reader_t reader;
+    uint8_t data[23];
+    uint8_t buf[32];
+    uint8_t read[23];
+    int offset;
+    int i;
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (uint8_t)(101 * i + 7);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        memset(&buf[0], 0, sizeof(buf));
+        bitstream_lsb_writer_init(&writer, &buf[0], sizeof(buf));
+        bitstream_lsb_writer_write_u64_bits(&writer,
+                                            0x55 & ((1 << offset) - 1),
+                                            offset);
+        bitstream_lsb_writer_write_bytes(&writer, &data[0], sizeof(data));
+        bitstream_lsb_writer_write_bit(&writer, 1);
+        bitstream_lsb_writer_flush(&writer);
+        ASSERT_EQ(bitstream_lsb_writer_size_in_bits(&writer),
+                  offset + 8 * sizeof(data) + 1);
+
+        for (i = 0; i < 8 * (int)sizeof(data); i++) {
+            ASSERT_EQ(lsb_get_bit(&buf[0], offset + i),
+                      lsb_get_bit(&data[0], i));
+        }
+
+        bitstream_lsb_reader_init(&reader, &buf[0], sizeof(buf));
+        bitstream_lsb_reader_seek(&reader, offset);
+        bitstream_lsb_reader_read_bytes(&reader, &read[0], sizeof(read));
+        ASSERT_MEMORY_EQ(&read[0], &data[0], sizeof(data));
+        ASSERT_EQ(bitstream_lsb_reader_read_bit(&reader), 1);
+    }
+}
+
+TEST(lsb_overflow)
+{
+    struct bitstream_lsb_writer_t writer;
+    struct bitstream_lsb_reader_t reader;
+    uint8_t buf[10];
+    uint8_t data[3];
+
+    memset(&buf[0], 0, sizeof(buf));
+    bitstream_lsb_writer_init(&writer, &buf[0], 9);
+    bitstream_lsb_writer_write_u64_bits(&writer, 0x123456789abcdefull, 60);
+    bitstream_lsb_writer_write_u64_bits(&writer, 0x789, 12);
+    bitstream_lsb_writer_flush(&writer);
+    ASSERT_EQ(bitstream_lsb_writer_overflow(&writer), 0);
+    bitstream_lsb_writer_write_bit(&writer, 1);
+    bitstream_lsb_writer_flush(&writer);
+    ASSERT_EQ(bitstream_lsb_writer_overflow(&writer), 1);
+    ASSERT_EQ(buf[9], 0);
+
+    /* Seeking back and rewriting keeps the bits before the position. */
+    bitstream_lsb_writer_seek(&writer, -13);
+    ASSERT_EQ(bitstream_lsb_writer_size_in_bits(&writer), 60);
+    bitstream_lsb_writer_write_u64_bits(&writer, 0xa, 4);
+    bitstream_lsb_writer_flush(&writer);
+    ASSERT_EQ(buf[7], 0xa1);
+
+    bitstream_lsb_reader_init(&reader, &buf[0], 9);
+    ASSERT_EQ(bitstream_lsb_reader_read_u64_bits(&reader, 60),
+              0x123456789abcdefull);
+    ASSERT_EQ(bitstream_lsb_reader_read_u64_bits(&reader, 12), 0x78a);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+
+    /* Past the end, zeros are read. */
+    ASSERT_EQ(bitstream_lsb_reader_read_bit(&reader), 0);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 1);
+    ASSERT_EQ(bitstream_lsb_reader_tell(&reader), 73);
+
+    bitstream_lsb_reader_init(&reader, &buf[0], 9);
+    bitstream_lsb_reader_seek(&reader, 64);
+    bitstream_lsb_reader_read_bytes(&reader, &data[0], 1);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 0);
+    bitstream_lsb_reader_seek(&reader, -8);
+    bitstream_lsb_reader_read_bytes(&reader, &data[0], 3);
+    ASSERT_MEMORY_EQ(&data[0], "\x78\x00\x00", 3);
+    ASSERT_EQ(bitstream_lsb_reader_overflow(&reader), 1);
+}
+
+TEST(plan_decode)
+{
+    struct bitstream_fast_reader_t plan_reader;
+    struct bitstream_fast_reader_t reader;
+    struct bitstream_plan_t plan;
+    uint8_t buf[256];
+    int widths[40];
+    uint64_t values[40];
+    int offset;
+    int i;
+    int j;
+
+    for (i = 0; i < (int)sizeof(buf); i++) {
+        buf[i] = (uint8_t)(37 * i + 11);
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (i = 0; i < 5; i++) {
+            for (j = 0; j < 40; j++) {
+                widths[j] = (((7 * i + 3 * j + offset) % (i == 4 ? 64 : 9 + 4 * i))
+                             + 1);
+            }
+
+            ASSERT_EQ(bitstream_plan_init(&plan, &widths[0], NULL, 40), 0);
+            bitstream_fast_reader_init(&plan_reader, &buf[0], sizeof(buf));
+            bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+            bitstream_fast_reader_seek(&plan_reader, offset);
+            bitstream_fast_reader_seek(&reader, offset);
+            bitstream_plan_decode(&plan, &plan_reader, &values[0]);
+
+            for (j = 0; j < 40; j++) {
+                ASSERT_EQ(values[j],
+                          bitstream_fast_reader_read_u64_bits(&reader,
+                                                              widths[j]));
+            }
+
+            ASSERT_EQ(bitstream_fast_reader_tell(&plan_reader),
+                      bitstream_fast_reader_tell(&reader));
+        }
+    }
+}
+
+TEST(plan_decode_offsets)
+{
+    struct bitstream_fast_reader_t reader;
+    struct bitstream_plan_t plan;
+    uint8_t buf[] = "\x12\x34\x56\x78\x9a\xbc\xde\xf0\x12\x34\x56\x78\x9a\xbc\xde";
+    int widths[] = { 4, 4, 12, 3, 1, 9, 16, 33 };
+    int offsets[] = { 0, 8, 12, 30, 33, 40, 51, 80 };
+    uint64_t values[8];
+
+    ASSERT_EQ(bitstream_plan_init(&plan, &widths[0], &offsets[0], 8), 0);
+    ASSERT_EQ(bitstream_plan_size_in_bits(&plan), 113);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf) - 1);
+    bitstream_plan_decode(&plan, &reader, &values[0]);
+    ASSERT_EQ(values[0], 0x1);
+    ASSERT_EQ(values[1], 0x3);
+    ASSERT_EQ(values[2], 0x456);
+    ASSERT_EQ(values[3], 0x1);
+    ASSERT_EQ(values[4], 0x0);
+    ASSERT_EQ(values[5], 0x179);
+    ASSERT_EQ(values[6], 0xf780);
+    ASSERT_EQ(values[7], 0xacf13579ull);
+    ASSERT_EQ(bitstream_fast_reader_tell(&reader), 113);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+}
+
+TEST(plan_encode)
+{
+    struct bitstream_fast_writer_t plan_writer;
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_fast_reader_t reader;
+    struct bitstream_plan_t plan;
+    uint8_t plan_buf[256];
+    uint8_t buf[256];
+    int widths[40];
+    int offsets[40];
+    uint64_t values[40];
+    uint64_t decoded[40];
+    int offset;
+    int i;
+    int j;
+    int k;
+
+    for (offset = 0; offset < 8; offset++) {
+        for (i = 0; i < 5; i++) {
+            k = 0;
+
+            for (j = 0; j < 40; j++) {
+                widths[j] = (((7 * i + 3 * j + offset) % (i == 4 ? 64 : 9 + 4 * i))
+                             + 1);
+                k += ((5 * j + i) % 7 == 0 ? (j % 11) : 0);
+                offsets[j] = k;
+                k += widths[j];
+                values[j] = (0x9e3779b97f4a7c15ull * (uint64_t)(j + 1 + i));
+            }
+
+            ASSERT_EQ(bitstream_plan_init(&plan, &widths[0], &offsets[0], 40),
+                      0);
+            memset(&plan_buf[0], 0xff, sizeof(plan_buf));
+            memset(&buf[0], 0xff, sizeof(buf));
+            bitstream_fast_writer_init(&plan_writer,
+                                       &plan_buf[0],
+                                       sizeof(plan_buf));
+            bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+            bitstream_fast_writer_write_u64_bits(&plan_writer, 0, offset);
+            bitstream_fast_writer_write_u64_bits(&writer, 0, offset);
+            bitstream_plan_encode(&plan, &plan_writer, &values[0]);
+            k = 0;
+
+            for (j = 0; j < 40; j++) {
+                bitstream_fast_writer_write_u64_bits(&writer,
+                                                     0,
+                                                     offsets[j] - k);
+                bitstream_fast_writer_write_u64_bits(
+                    &writer,
+                    values[j] & (((2ull << (widths[j] - 1)) - 1)),
+                    widths[j]);
+                k = (offsets[j] + widths[j]);
+            }
+
+            ASSERT_EQ(bitstream_fast_writer_size_in_bits(&plan_writer),
+                      bitstream_fast_writer_size_in_bits(&writer));
+            bitstream_fast_writer_flush(&plan_writer);
+            bitstream_fast_writer_flush(&writer);
+            ASSERT_MEMORY_EQ(&plan_buf[0],
+                             &buf[0],
+                             bitstream_fast_writer_size_in_bytes(&writer));
+
+            bitstream_fast_reader_init(&reader, &plan_buf[0], sizeof(plan_buf));
+            bitstream_fast_reader_seek(&reader, offset);
+            bitstream_plan_decode(&plan, &reader, &decoded[0]);
+
+            for (j = 0; j < 40; j++) {
+                ASSERT_EQ(decoded[j],
+                          values[j] & (((2ull << (widths[j] - 1)) - 1)));
+            }
+        }
+    }
+}
+
+TEST(plan_init_errors)
+{
+    struct bitstream_plan_t plan;
+    int widths[BITSTREAM_PLAN_MAX_FIELDS + 1];
+    int offsets[] = { 0, 4, 3 };
+    int i;
+
+    for (i = 0; i < BITSTREAM_PLAN_MAX_FIELDS + 1; i++) {
+        widths[i] = 1;
+    }
+
+    ASSERT_EQ(bitstream_plan_init(&plan,
+                                  &widths[0],
+                                  NULL,
+                                  BITSTREAM_PLAN_MAX_FIELDS + 1),
+              -EINVAL);
+    ASSERT_EQ(bitstream_plan_init(&plan,
+                                  &widths[0],
+                                  NULL,
+                                  BITSTREAM_PLAN_MAX_FIELDS),
+              0);
+    ASSERT_EQ(bitstream_plan_init(&plan, &widths[0], &offsets[0], 3),
+              -EINVAL);
+    widths[3] = 0;
+    ASSERT_EQ(bitstream_plan_init(&plan, &widths[0], NULL, 5), -EINVAL);
+    widths[3] = 65;
+    ASSERT_EQ(bitstream_plan_init(&plan, &widths[0], NULL, 5), -EINVAL);
+}
+
+TEST(can_codec_classic)
+{
+    static const struct bitstream_can_signal_t signals[] = {
+        { 0, 4, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+        { 4, 12, BITSTREAM_CAN_INTEL, 1, 1.0, 0.0 },
+        { 23, 16, BITSTREAM_CAN_MOTOROLA, 0, 1.0, 0.0 },
+        { 33, 6, BITSTREAM_CAN_MOTOROLA, 1, 1.0, 0.0 },
+        { 48, 16, BITSTREAM_CAN_INTEL, 1, 1.0, 0.0 }
+    };
+    static const struct bitstream_can_signal_t short_signals[] = {
+        { 0, 8, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+        { 15, 12, BITSTREAM_CAN_MOTOROLA, 0, 1.0, 0.0 },
+        { 28, 12, BITSTREAM_CAN_INTEL, 1, 1.0, 0.0 }
+    };
+    static const uint64_t values[] = {
+        0x9, 0xffffffffffffff9cull, 0xbeef, 0xfffffffffffffffdull,
+        0xffffffffffffabcdull
+    };
+    static const uint64_t short_values[] = {
+        0x12, 0xabc, 0xfffffffffffff876ull
+    };
+    struct bitstream_can_codec_t codec;
+    uint8_t frame[8];
+    uint64_t unpacked[5];
+
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signals[0], 5, 8), 0);
+    memset(&frame[0], 0xff, sizeof(frame));
+    bitstream_can_codec_pack_raw(&codec, &frame[0], &values[0]);
+    ASSERT_MEMORY_EQ(&frame[0], "\xc9\xf9\xbe\xef\x03\xd0\xcd\xab", 8);
+    bitstream_can_codec_unpack_raw(&codec, &frame[0], &unpacked[0]);
+    ASSERT_MEMORY_EQ(&unpacked[0], &values[0], sizeof(values));
+
+    /* Shorter frames are not written or read past their end. */
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &short_signals[0], 3, 5), 0);
+    memset(&frame[0], 0xff, sizeof(frame));
+    bitstream_can_codec_pack_raw(&codec, &frame[0], &short_values[0]);
+    ASSERT_MEMORY_EQ(&frame[0], "\x12\xab\xc0\x60\x87\xff\xff\xff", 8);
+    bitstream_can_codec_unpack_raw(&codec, &frame[0], &unpacked[0]);
+    ASSERT_MEMORY_EQ(&unpacked[0], &short_values[0], sizeof(short_values));
+}
+
+TEST(can_codec_fd)
+{
+    static const struct bitstream_can_signal_t signals[] = {
+        { 163, 64, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+        { 244, 64, BITSTREAM_CAN_MOTOROLA, 1, 1.0, 0.0 },
+        { 504, 8, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0 },
+        { 503, 8, BITSTREAM_CAN_MOTOROLA, 0, 1.0, 0.0 },
+        { 325, 13, BITSTREAM_CAN_MOTOROLA, 0, 1.0, 0.0 },
+        { 401, 30, BITSTREAM_CAN_INTEL, 1, 1.0, 0.0 }
+    };
+    static const uint64_t values[] = {
+        0x0123456789abcdefull, 0xfedcba9876543210ull, 0xa5, 0x3c, 0x1abc,
+        0xffffffffffffcfc7ull
+    };
+    struct bitstream_can_codec_t codec;
+    uint8_t expected[64];
+    uint8_t frame[64];
+    uint64_t unpacked[6];
+
+    memset(&expected[0], 0, sizeof(expected));
+    memcpy(&expected[20], "\x78\x6f\x5e\x4d\x3c\x2b\x1a\x09", 8);
+    memcpy(&expected[30], "\x1f\xdb\x97\x53\x0e\xca\x86\x42", 8);
+    memcpy(&expected[40], "\x35\x78", 2);
+    memcpy(&expected[50], "\x8e\x9f\xff\x7f", 4);
+    memcpy(&expected[62], "\x3c\xa5", 2);
+
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signals[0], 6, 64), 0);
+    memset(&frame[0], 0xff, sizeof(frame));
+    bitstream_can_codec_pack_raw(&codec, &frame[0], &values[0]);
+    ASSERT_MEMORY_EQ(&frame[0], &expected[0], sizeof(expected));
+    bitstream_can_codec_unpack_raw(&codec, &frame[0], &unpacked[0]);
+    ASSERT_MEMORY_EQ(&unpacked[0], &values[0], sizeof(values));
+}
+
+TEST(can_codec_physical)
+{
+    static const struct bitstream_can_signal_t signals[] = {
+        { 7, 16, BITSTREAM_CAN_MOTOROLA, 0, 0.25, 0.0 },
+        { 16, 8, BITSTREAM_CAN_INTEL, 1, 1.0, -40.0 },
+        { 24, 12, BITSTREAM_CAN_INTEL, 1, 0.1, 0.0 }
+    };
+    static const double values[] = { 1500.25, -168.0, -12.3 };
+    struct bitstream_can_codec_t codec;
+    uint8_t frame[8];
+    double unpacked[3];
+
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signals[0], 3, 8), 0);
+    bitstream_can_codec_pack(&codec, &frame[0], &values[0]);
+    ASSERT_MEMORY_EQ(&frame[0], "\x17\x71\x80\x85\x0f\x00\x00\x00", 8);
+    bitstream_can_codec_unpack(&codec, &frame[0], &unpacked[0]);
+    ASSERT_EQ(unpacked[0], 1500.25);
+    ASSERT_EQ(unpacked[1], -168.0);
+    ASSERT(unpacked[2] > -12.31);
+    ASSERT(unpacked[2] < -12.29);
+}
+
+TEST(can_codec_init_errors)
+{
+    struct bitstream_can_signal_t signal = {
+        0, 8, BITSTREAM_CAN_INTEL, 0, 1.0, 0.0
+    };
+    struct bitstream_can_codec_t codec;
+
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 0), -EINVAL);
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 65), -EINVAL);
+    ASSERT_EQ(bitstream_can_codec_init(&codec,
+                                       &signal,
+                                       BITSTREAM_CAN_MAX_SIGNALS + 1,
+                                       8),
+              -EINVAL);
+
+    /* Intel signal ending past the frame. */
+    signal.start = 57;
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 8), -EINVAL);
+
+    /* A Motorola signal starting in the most significant bit of the
+       last byte fits. */
+    signal.byte_order = BITSTREAM_CAN_MOTOROLA;
+    signal.start = 63;
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 8), 0);
+    signal.start = 60;
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 8), -EINVAL);
+
+    signal.start = 7;
+    signal.length = 65;
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 8), -EINVAL);
+    signal.length = 8;
+    signal.scale = 0.0;
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 8), -EINVAL);
+    signal.scale = 1.0;
+    signal.byte_order = 2;
+    ASSERT_EQ(bitstream_can_codec_init(&codec, &signal, 1, 8), -EINVAL);
+}
+
+TEST(huffman_lengths)
+{
+    uint32_t frequencies[] = { 45, 13, 12, 16, 9, 5, 0 };
+    uint32_t fibonacci[20];
+    uint8_t lengths[20];
+    uint32_t kraft;
+    int i;
+
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0], &frequencies[0], 7, 15),
+              0);
+    ASSERT_EQ(lengths[0], 1);
+    ASSERT_EQ(lengths[1], 3);
+    ASSERT_EQ(lengths[2], 3);
+    ASSERT_EQ(lengths[3], 3);
+    ASSERT_EQ(lengths[4], 4);
+    ASSERT_EQ(lengths[5], 4);
+    ASSERT_EQ(lengths[6], 0);
+
+    /* A single used symbol gets a one bit code. */
+    frequencies[0] = 0;
+    frequencies[1] = 0;
+    frequencies[2] = 0;
+    frequencies[3] = 3;
+    frequencies[4] = 0;
+    frequencies[5] = 0;
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0], &frequencies[0], 7, 15),
+              0);
+    ASSERT_EQ(lengths[3], 1);
+    ASSERT_EQ(lengths[0], 0);
+
+    /* Fibonacci frequencies gives a code of length 19 unless
+       limited. */
+    fibonacci[0] = 1;
+    fibonacci[1] = 1;
+
+    for (i = 2; i < 20; i++) {
+        fibonacci[i] = (fibonacci[i - 1] + fibonacci[i - 2]);
+    }
+
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0], &fibonacci[0], 20, 7),
+              0);
+    kraft = 0;
+
+    for (i = 0; i < 20; i++) {
+        ASSERT_GT(lengths[i], 0);
+        ASSERT_LE(lengths[i], 7);
+        kraft += (1u << (7 - lengths[i]));
+    }
+
+    ASSERT_EQ(kraft, 1u << 7);
+    ASSERT_EQ(lengths[19], 1);
+
+    /* Errors. */
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0], &fibonacci[0], 20, 4),
+              -EINVAL);
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0], &fibonacci[0], 20, 16),
+              -EINVAL);
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0],
+                                        &fibonacci[0],
+                                        BITSTREAM_HUFFMAN_MAX_SYMBOLS + 1,
+                                        15),
+              -EINVAL);
+}
+
+TEST(huffman_init)
+{
+    static struct bitstream_huffman_t huffman;
+    uint8_t lengths[] = { 2, 1, 3, 3 };
+
+    ASSERT_EQ(bitstream_huffman_init(&huffman, &lengths[0], 4), 0);
+    ASSERT_EQ(huffman.codes[0], 2);
+    ASSERT_EQ(huffman.codes[1], 0);
+    ASSERT_EQ(huffman.codes[2], 6);
+    ASSERT_EQ(huffman.codes[3], 7);
+
+    /* Oversubscribed. */
+    lengths[0] = 1;
+    ASSERT_EQ(bitstream_huffman_init(&huffman, &lengths[0], 4), -EINVAL);
+
+    /* Too long. */
+    lengths[0] = 16;
+    ASSERT_EQ(bitstream_huffman_init(&huffman, &lengths[0], 4), -EINVAL);
+}
+
+TEST(huffman_encode_decode)
+{
+    static struct bitstream_huffman_t huffman;
+    static uint32_t frequencies[BITSTREAM_HUFFMAN_MAX_SYMBOLS];
+    static uint16_t symbols[4096];
+    static uint16_t decoded[4096];
+    static uint8_t buf[8192];
+    uint8_t lengths[BITSTREAM_HUFFMAN_MAX_SYMBOLS];
+    struct bitstream_fast_writer_t writer;
+    struct bitstream_fast_reader_t reader;
+    uint32_t state;
+    int max_length;
+    int i;
+
+    /* Skewed frequencies giving both short codes and codes longer than
+       the root table. */
+    for (i = 0; i < BITSTREAM_HUFFMAN_MAX_SYMBOLS; i++) {
+        frequencies[i] = (1u << (i % 17)) + (uint32_t)i;
+    }
+
+    ASSERT_EQ(bitstream_huffman_lengths(&lengths[0],
+                                        &frequencies[0],
+                                        BITSTREAM_HUFFMAN_MAX_SYMBOLS,
+                                        15),
+              0);
+    ASSERT_EQ(bitstream_huffman_init(&huffman,
+                                     &lengths[0],
+                                     BITSTREAM_HUFFMAN_MAX_SYMBOLS),
+              0);
+    max_length = 0;
+
+    for (i = 0; i < BITSTREAM_HUFFMAN_MAX_SYMBOLS; i++) {
+        if (lengths[i] > max_length) {
+            max_length = lengths[i];
+        }
+    }
+
+    ASSERT_GT(max_length, BITSTREAM_HUFFMAN_ROOT_BITS);
+    state = 1;
+
+    for (i = 0; i < 4096; i++) {
+        state = (state * 1103515245u + 12345u);
+        symbols[i] = (uint16_t)((state >> 16) % BITSTREAM_HUFFMAN_MAX_SYMBOLS);
+    }
+
+    bitstream_fast_writer_init(&writer, &buf[0], sizeof(buf));
+    bitstream_huffman_encode(&huffman, &writer, &symbols[0], 4096);
+    bitstream_huffman_write_symbol(&huffman, &writer, 7);
+    bitstream_fast_writer_flush(&writer);
+    ASSERT_EQ(bitstream_fast_writer_overflow(&writer), 0);
+
+    bitstream_fast_reader_init(&reader,
+                               &buf[0],
+                               bitstream_fast_writer_size_in_bytes(&writer));
+    ASSERT_EQ(bitstream_huffman_decode(&huffman, &reader, &decoded[0], 4096),
+              0);
+    ASSERT_MEMORY_EQ(&decoded[0], &symbols[0], sizeof(symbols));
+    ASSERT_EQ(bitstream_huffman_read_symbol(&huffman, &reader), 7);
+    ASSERT_EQ(bitstream_fast_reader_overflow(&reader), 0);
+}
+
+TEST(huffman_invalid_code)
+{
+    static struct bitstream_huffman_t huffman;
+    static struct bitstream_huffman_t long_huffman;
+    uint8_t lengths[] = { 1, 0 };
+    uint8_t long_lengths[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+    uint8_t buf[] = { 0x7f, 0xff, 0xff };
+    uint16_t symbols[2];
+    struct bitstream_fast_reader_t reader;
+
+    ASSERT_EQ(bitstream_huffman_init(&huffman, &lengths[0], 2), 0);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_huffman_read_symbol(&huffman, &reader), 0);
+    ASSERT_EQ(bitstream_huffman_read_symbol(&huffman, &reader), -EPROTO);
+    ASSERT_EQ(bitstream_huffman_decode(&huffman, &reader, &symbols[0], 2),
+              -EPROTO);
+
+    /* The unused all ones code in a subtable. */
+    ASSERT_EQ(bitstream_huffman_init(&long_huffman, &long_lengths[0], 12), 0);
+    bitstream_fast_reader_init(&reader, &buf[0], sizeof(buf));
+    ASSERT_EQ(bitstream_huffman_read_symbol(&long_huffman, &reader), 0);
+    ASSERT_EQ(bitstream_huffman_read_symbol(&long_huffman, &reader), -EPROTO);
+}
+
+TEST(index_lookup)
+{
+    struct bitstream_writer_t writer;
+    struct bitstream_reader_t reader;
+    struct bitstream_fast_reader_t fast_reader;
+    struct bitstream_index_t index;
+    struct bitstream_index_t decoded_index;
+    uint8_t buf[2048];
+    uint8_t encoded[256];
+    uint64_t offsets[20];
+    uint64_t decoded_offsets[20];
+    uint64_t bit_offset;
+    int record;
+    int first;
+    int i;
+
+    /* Records of 3 bits length and 0 to 6 bytes. */
+    ASSERT_EQ(bitstream_index_init(&index, 7, &offsets[0], 20), 0);
+    bitstream_writer_init(&writer, &buf[0]);
+    bitstream_writer_write_bit(&writer, 1);
+
+    for (record = 0; record < 100; record++) {
+        ASSERT_EQ(bitstream_index_add(&index,
+                                      bitstream_writer_size_in_bits(&writer)),
+                  0);
+        bitstream_writer_write_u64_bits(&writer, record % 7, 3);
+
+        for (i = 0; i < record % 7; i++) {
+            bitstream_writer_write_u8(&writer, (uint8_t)record);
+        }
+    }
+
+    ASSERT_EQ(index.number_of_entries, 15);
+    ASSERT_EQ(bitstream_index_encoded_size(&index), 17 + 8 * 15);
+    ASSERT_EQ(bitstream_index_encode(&index, &encoded[0], sizeof(encoded)),
+              17 + 8 * 15);
+    ASSERT_EQ(bitstream_index_init(&decoded_index,
+                                   1,
+                                   &decoded_offsets[0],
+                                   20),
+              0);
+    ASSERT_EQ(bitstream_index_decode(&decoded_index,
+                                     &encoded[0],
+                                     17 + 8 * 15),
+              0);
+    ASSERT_EQ(decoded_index.interval, 7);
+    ASSERT_EQ(decoded_index.number_of_records, 100);
+    ASSERT_MEMORY_EQ(&decoded_offsets[0], &offsets[0], 8 * 15);
+
+    for (record = 0; record < 100; record++) {
+        first = bitstream_index_lookup(&decoded_index, record, &bit_offset);
+        ASSERT_EQ(first, record - record % 7);
+        bitstream_reader_init(&reader, &buf[0]);
+        bitstream_reader_seek_to(&reader, (int)bit_offset);
+        bitstream_fast_reader_init(&fast_reader, &buf[0], sizeof(buf));
+        bitstream_fast_reader_read_u8(&fast_reader);
+        bitstream_fast_reader_seek_to(&fast_reader, bit_offset);
+
+        for (i = first; i < record; i++) {
+            bitstream_reader_seek(
+                &reader,
+                8 * (int)bitstream_reader_read_u64_bits(&reader, 3));
+            bitstream_fast_reader_seek(
+                &fast_reader,
+                8 * (int64_t)bitstream_fast_reader_read_u64_bits(&fast_reader,
+                                                                 3));
+        }
+
+        ASSERT_EQ(bitstream_reader_read_u64_bits(&reader, 3), record % 7);
+        ASSERT_EQ(bitstream_fast_reader_read_u64_bits(&fast_reader, 3),
+                  record % 7);
+
+        if (record % 7 != 0) {
+            ASSERT_EQ(bitstream_reader_read_u8(&reader), record);
+            ASSERT_EQ(bitstream_fast_reader_read_u8(&fast_reader), record);
+        }
+    }
+}
+
+TEST(index_errors)
+{
+    struct bitstream_index_t index;
+    uint8_t encoded[64];
+    uint64_t offsets[3];
+    uint64_t bit_offset;
+
+    ASSERT_EQ(bitstream_index_init(&index, 0, &offsets[0], 2), -EINVAL);
+    ASSERT_EQ(bitstream_index_init(&index, -1, &offsets[0], 2), -EINVAL);
+    ASSERT_EQ(bitstream_index_init(&index, 2, &offsets[0], 2), 0);
+    ASSERT_EQ(bitstream_index_lookup(&index, 0, &bit_offset), -EINVAL);
+    ASSERT_EQ(bitstream_index_add(&index, 0), 0);
+    ASSERT_EQ(bitstream_index_add(&index, 10), 0);
+    ASSERT_EQ(bitstream_index_add(&index, 20), 0);
+    ASSERT_EQ(bitstream_index_add(&index, 30), 0);
+    ASSERT_EQ(bitstream_index_add(&index, 40), -ENOSPC);
+    ASSERT_EQ(bitstream_index_lookup(&index, 3, &bit_offset), 2);
+    ASSERT_EQ(bit_offset, 20);
+    ASSERT_EQ(bitstream_index_lookup(&index, 4, &bit_offset), -EINVAL);
+    ASSERT_EQ(bitstream_index_lookup(&index, -1, &bit_offset), -EINVAL);
+
+    /* Encoding. */
+    ASSERT_EQ(bitstream_index_encode(&index, &encoded[0], 32), -ENOSPC);
+    ASSERT_EQ(bitstream_index_encode(&index, &encoded[0], 33), 33);
+    ASSERT_MEMORY_EQ(&encoded[0],
+                     "\x01\x00\x00\x00\x02\x00\x00\x00\x00\x00\x00\x00\x04"
+                     "\x00\x00\x00\x02\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+                     "\x00\x00\x00\x00\x00\x00\x14",
+                     33);
+
+    /* Decoding. */
+    ASSERT_EQ(bitstream_index_decode(&index, &encoded[0], 32), -EPROTO);
+    ASSERT_EQ(bitstream_index_decode(&index, &encoded[0], 16), -EPROTO);
+    encoded[0] = 2;
+    ASSERT_EQ(bitstream_index_decode(&index, &encoded[0], 33), -EPROTO);
+    encoded[0] = 1;
+    encoded[16] = 3;
+    ASSERT_EQ(bitstream_index_decode(&index, &encoded[0], 33), -EPROTO);
+    encoded[16] = 2;
+    ASSERT_EQ(bitstream_index_init(&index, 2, &offsets[0], 1), 0);
+    ASSERT_EQ(bitstream_index_decode(&index, &encoded[0], 33), -ENOSPC);
+    ASSERT_EQ(bitstream_index_init(&index, 2, &offsets[0], 3), 0);
+    ASSERT_EQ(bitstream_index_decode(&index, &encoded[0], 33), 0);
+    ASSERT_EQ(index.number_of_records, 4);
+    ASSERT_EQ(offsets[1], 20);
+}
+
+TEST(cpp_read_write)
+{
+    struct bitstream_writer_t writer;
+    uint8_t expected[32];
+    uint8_t buf[32];
+    uint64_t values[8];
+    int fast;
+
+    bitstream_writer_init(&writer, &expected[0]);
+    bitstream_writer_write_u64_bits(&writer, 1, 1);
+    bitstream_writer_write_u64_bits(&writer, 5, 3);
+    bitstream_writer_write_u8(&writer, 0xab);
+    bitstream_writer_write_u64_bits(&writer, 0x123, 12);
+    bitstream_writer_write_u16(&writer, 0x4567);
+    bitstream_writer_write_u32(&writer, 0x89abcdef);
+    bitstream_writer_write_u64(&writer, 0x0123456789abcdefull);
+    bitstream_writer_write_u64_bits(&writer, 0x55, 7);
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 143);
+
+    for (fast = 0; fast < 2; fast++) {
+        memset(&buf[0], 0xff, sizeof(buf));
+        ASSERT_EQ(cpp_write(&buf[0], sizeof(buf), fast), 143);
+        ASSERT_MEMORY_EQ(&buf[0], &expected[0], 18);
+
+        cpp_read(&buf[0], sizeof(buf), fast, &values[0]);
+        ASSERT_EQ(values[0], 1);
+        ASSERT_EQ(values[1], 5);
+        ASSERT_EQ(values[2], 0xab);
+        ASSERT_EQ(values[3], 0x123);
+        ASSERT_EQ(values[4], 0x4567);
+        ASSERT_EQ(values[5], 0x89abcdef);
+        ASSERT_EQ(values[6], 0x0123456789abcdefull);
+        ASSERT_EQ(values[7], 0x55);
+    }
+}
+
+TEST(cpp_layout)
+{
+    static const int widths[9] = { 1, 3, 12, 7, 20, 5, 64, 13, 33 };
+    static const uint64_t values[9] = {
+        1, 6, 0xabc, 0x7f, 0xfffff, 0x15, 0xfedcba9876543210ull, 0x1234,
+        0x1fedcba98ull
+    };
+    struct bitstream_writer_t writer;
+    uint8_t expected[32];
+    uint8_t buf[32];
+    uint64_t decoded[9];
+    uint64_t dirty[9];
+    int fast;
+    int i;
+
+    bitstream_writer_init(&writer, &expected[0]);
+
+    for (i = 0; i < 9; i++) {
+        bitstream_writer_write_u64_bits(&writer, values[i], widths[i]);
+        dirty[i] = (values[i] | (widths[i] < 64 ? ~0ull << widths[i] : 0));
+    }
+
+    ASSERT_EQ(bitstream_writer_size_in_bits(&writer), 158);
+
+    for (fast = 0; fast < 2; fast++) {
+        /* Bits above each field width are ignored. */
+        memset(&buf[0], 0xff, sizeof(buf));
+        ASSERT_EQ(cpp_layout_encode(&buf[0], sizeof(buf), fast, &dirty[0]),
+                  158);
+        ASSERT_MEMORY_EQ(&buf[0], &expected[0], 20);
+
+        cpp_layout_decode(&buf[0], sizeof(buf), fast, &decoded[0]);
+        ASSERT_MEMORY_EQ(&decoded[0], &values[0], sizeof(values));
+    }
+}